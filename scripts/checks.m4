@@ -273,6 +273,19 @@ AC_DEFUN([TORRENT_WITH_TINYXML2], [
   ])
 ])
 
+AC_DEFUN([TORRENT_WITH_XMLRPC_STREAM], [
+  AC_MSG_CHECKING(for streaming XMLRPC)
+
+  AC_ARG_WITH(xmlrpc-stream,
+    AS_HELP_STRING([--with-xmlrpc-stream],[enable XMLRPC support via the built-in streaming parser]),
+  [
+    AC_MSG_RESULT(yes)
+    AC_DEFINE(HAVE_XMLRPC_STREAM, 1, Support for XMLRPC via the built-in streaming parser.)
+  ],[
+    AC_MSG_RESULT(ignored)
+  ])
+])
+
 AC_DEFUN([TORRENT_WITH_LUA], [
   AC_ARG_WITH(lua,
     AS_HELP_STRING([--with-lua],[enable LUA support]),
@@ -293,6 +306,36 @@ AC_DEFUN([TORRENT_WITH_LUA], [
   ])
 ])
 
+AC_DEFUN([TORRENT_WITH_RPC_COMPRESSION], [
+  AC_ARG_WITH(zlib,
+    AS_HELP_STRING([--without-zlib],[disable gzip compression of RPC responses]),
+    [], [with_zlib=check])
+
+  if test "$with_zlib" != "no"; then
+    PKG_CHECK_MODULES([ZLIB], [zlib], [
+      AC_DEFINE(HAVE_ZLIB, 1, Support gzip compression of RPC responses.)
+    ], [
+      if test "$with_zlib" = "yes"; then
+        AC_MSG_ERROR([zlib requested but not found])
+      fi
+    ])
+  fi
+
+  AC_ARG_WITH(zstd,
+    AS_HELP_STRING([--without-zstd],[disable zstd compression of RPC responses]),
+    [], [with_zstd=check])
+
+  if test "$with_zstd" != "no"; then
+    PKG_CHECK_MODULES([ZSTD], [libzstd], [
+      AC_DEFINE(HAVE_ZSTD, 1, Support zstd compression of RPC responses.)
+    ], [
+      if test "$with_zstd" = "yes"; then
+        AC_MSG_ERROR([zstd requested but not found])
+      fi
+    ])
+  fi
+])
+
 AC_DEFUN([TORRENT_WITH_INOTIFY], [
   AC_LANG_PUSH(C++)
 
@@ -1,5 +1,6 @@
 #include "config.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cstdio>
 #include <functional>
@@ -188,13 +189,7 @@ retrieve_d_priority_str(core::Download* download) {
 
 torrent::Object
 retrieve_d_ratio(core::Download* download) {
-  if (download->is_hash_checking())
-    return int64_t();
-
-  int64_t bytesDone = download->download()->bytes_done();
-  int64_t upTotal   = download->info()->up_rate()->total();
-
-  return bytesDone > 0 ? (1000 * upTotal) / bytesDone : 0;
+  return download->ratio();
 }
 
 torrent::Object
@@ -209,30 +204,41 @@ apply_d_custom(core::Download* download, const torrent::Object::list_type& args)
   if (++itr == args.end())
     throw torrent::bencode_error("Missing value argument.");
 
-  download->bencode()->get_key("rtorrent").
-                       insert_preserve_copy("custom", torrent::Object::create_map()).first->second.
-                       insert_key(key, itr->as_string());
+  // Integers are kept as integers, anything else must be a string.
+  if (itr->is_value())
+    control->core()->download_list()->set_custom(download, key, *itr);
+  else
+    control->core()->download_list()->set_custom(download, key, itr->as_string());
+
   return torrent::Object();
 }
 
+// Returns NULL if the attribute isn't set.
+static const torrent::Object*
+find_d_custom(core::Download* download, const std::string& key) {
+  core::CustomAttributes::key_type id;
+
+  if (!core::CustomAttributes::find_key(key, &id))
+    return NULL;
+
+  return download->custom().find(id);
+}
+
 torrent::Object
 retrieve_d_custom(core::Download* download, const std::string& key) {
-  try {
-    return download->bencode()->get_key("rtorrent").get_key("custom").get_key_string(key);
+  const torrent::Object* value = find_d_custom(download, key);
 
-  } catch (torrent::bencode_error& e) {
-    return std::string();
-  }
+  return value != NULL ? *value : std::string();
 }
 
 torrent::Object
 retrieve_d_custom_throw(core::Download* download, const std::string& key) {
-  try {
-    return download->bencode()->get_key("rtorrent").get_key("custom").get_key_string(key);
+  const torrent::Object* value = find_d_custom(download, key);
 
-  } catch (torrent::bencode_error& e) {
+  if (value == NULL)
     throw torrent::input_error("No such custom value.");
-  }
+
+  return *value;
 }
 
 torrent::Object
@@ -246,12 +252,29 @@ retrieve_d_custom_if_z(core::Download* download, const torrent::Object::list_typ
   if (itr == args.end())
     throw torrent::bencode_error("d.custom.if_z: Missing default argument.");
 
-  try {
-    const std::string& val = download->bencode()->get_key("rtorrent").get_key("custom").get_key_string(key);
-    return val.empty() ? itr->as_string() : val;
-  } catch (torrent::bencode_error& e) {
+  const torrent::Object* value = find_d_custom(download, key);
+
+  if (value == NULL || (value->is_string() && value->as_string().empty()))
     return itr->as_string();
-  }
+
+  return *value;
+}
+
+torrent::Object
+retrieve_custom_index() {
+  std::vector<std::string> keys;
+
+  for (auto key : control->core()->download_list()->custom_index().keys())
+    keys.push_back(core::CustomAttributes::key_name(key));
+
+  std::sort(keys.begin(), keys.end());
+
+  torrent::Object result = torrent::Object::create_list();
+
+  for (auto& key : keys)
+    result.as_list().push_back(key);
+
+  return result;
 }
 
 torrent::Object
@@ -339,8 +362,10 @@ f_multicall(core::Download* download, const torrent::Object::list_type& args) {
   // We ignore the first arg for now, but it will be used for
   // selecting what files to include.
 
-  // Add some pre-parsing of the commands, so we don't spend time
-  // parsing and searching command map for every single call.
+  // Parse the commands and search the command map once, rather than
+  // for every single call.
+  std::vector<rpc::CommandPlan> plans = rpc::parse_command_plans(++args.begin(), args.end());
+
   torrent::Object             resultRaw = torrent::Object::create_list();
   torrent::Object::list_type& result = resultRaw.as_list();
   std::vector<rak::regex>     regex_list;
@@ -362,10 +387,10 @@ f_multicall(core::Download* download, const torrent::Object::list_type& args) {
 
     torrent::Object::list_type& row = result.insert(result.end(), torrent::Object::create_list())->as_list();
 
-    for (torrent::Object::list_const_iterator cItr = ++args.begin(); cItr != args.end(); cItr++) {
-      const std::string& cmd = cItr->as_string();
-      row.push_back(rpc::parse_command(rpc::make_target(file.get()), cmd.c_str(), cmd.c_str() + cmd.size()).first);
-    }
+    row.reserve(plans.size());
+
+    for (const auto& plan : plans)
+      row.push_back(plan.call(rpc::make_target(file.get())));
   }
 
   return resultRaw;
@@ -379,8 +404,10 @@ t_multicall(core::Download* download, const torrent::Object::list_type& args) {
   // We ignore the first arg for now, but it will be used for
   // selecting what files to include.
 
-  // Add some pre-parsing of the commands, so we don't spend time
-  // parsing and searching command map for every single call.
+  // Parse the commands and search the command map once, rather than
+  // for every single call.
+  std::vector<rpc::CommandPlan> plans = rpc::parse_command_plans(++args.begin(), args.end());
+
   torrent::Object             result_raw = torrent::Object::create_list();
   torrent::Object::list_type& result     = result_raw.as_list();
 
@@ -391,11 +418,10 @@ t_multicall(core::Download* download, const torrent::Object::list_type& args) {
     if (!tracker.is_valid())
       continue;
 
-    for (torrent::Object::list_const_iterator cItr = ++args.begin(); cItr != args.end(); cItr++) {
-      const std::string& cmd = cItr->as_string();
+    row.reserve(plans.size());
 
-      row.push_back(rpc::parse_command(rpc::make_target(&tracker), cmd.c_str(), cmd.c_str() + cmd.size()).first);
-    }
+    for (const auto& plan : plans)
+      row.push_back(plan.call(rpc::make_target(&tracker)));
   }
 
   return result_raw;
@@ -409,19 +435,20 @@ p_multicall(core::Download* download, const torrent::Object::list_type& args) {
   // We ignore the first arg for now, but it will be used for
   // selecting what files to include.
 
-  // Add some pre-parsing of the commands, so we don't spend time
-  // parsing and searching command map for every single call.
+  // Parse the commands and search the command map once, rather than
+  // for every single call.
+  std::vector<rpc::CommandPlan> plans = rpc::parse_command_plans(++args.begin(), args.end());
+
   torrent::Object             resultRaw = torrent::Object::create_list();
   torrent::Object::list_type& result = resultRaw.as_list();
 
   for (const auto& connection : *download->connection_list()) {
     torrent::Object::list_type& row = result.insert(result.end(), torrent::Object::create_list())->as_list();
 
-    for (torrent::Object::list_const_iterator cItr = ++args.begin(); cItr != args.end(); cItr++) {
-      const std::string& cmd = cItr->as_string();
+    row.reserve(plans.size());
 
-      row.push_back(rpc::parse_command(rpc::make_target(connection), cmd.c_str(), cmd.c_str() + cmd.size()).first);
-    }
+    for (const auto& plan : plans)
+      row.push_back(plan.call(rpc::make_target(connection)));
   }
 
   return resultRaw;
@@ -510,6 +537,8 @@ download_get_value_or_zero(core::Download* download, const char* first_key, cons
 
 torrent::Object
 download_set_variable(core::Download* download, const torrent::Object& rawArgs, const char* first_key, const char* second_key = NULL) {
+  download->set_changed();
+
   if (second_key == NULL)
     return download->bencode()->get_key(first_key) = torrent::object_create_normal(rawArgs);
 
@@ -519,6 +548,8 @@ download_set_variable(core::Download* download, const torrent::Object& rawArgs,
 torrent::Object
 download_set_variable_value(core::Download* download, const torrent::Object::value_type& args,
                             const char* first_key, const char* second_key = NULL) {
+  download->set_changed();
+
   if (second_key == NULL)
     return download->bencode()->get_key(first_key) = args;
 
@@ -532,8 +563,10 @@ download_set_variable_value_ifz(core::Download* download, const torrent::Object:
     download->bencode()->get_key(first_key) :
     download->bencode()->get_key(first_key).get_key(second_key);
 
-  if (object.as_value() == 0)
+  if (object.as_value() == 0) {
     object = args;
+    download->set_changed();
+  }
 
   return object;
 }
@@ -541,6 +574,8 @@ download_set_variable_value_ifz(core::Download* download, const torrent::Object:
 torrent::Object
 download_set_variable_string(core::Download* download, const torrent::Object::string_type& args,
                              const char* first_key, const char* second_key = NULL) {
+  download->set_changed();
+
   if (second_key == NULL)
     return download->bencode()->get_key(first_key) = args;
 
@@ -554,6 +589,7 @@ download_set_variable_string(core::Download* download, const torrent::Object::st
 torrent::Object
 d_list_push_back_string(core::Download* download, const std::string& arg, const char* first_key, const char* second_key) {
   download_get_variable(download, first_key, second_key).as_list().push_back(arg);
+  download->set_changed();
   return torrent::Object();
 }
 
@@ -561,8 +597,10 @@ torrent::Object
 d_list_push_back_unique_string(core::Download* download, const std::string& arg, const char* first_key, const char* second_key) {
   torrent::Object::list_type& list = download_get_variable(download, first_key, second_key).as_list();
 
-  if (std::none_of(list.begin(), list.end(), [arg](const torrent::Object& obj) { return torrent::object_equal(obj, arg); }))
+  if (std::none_of(list.begin(), list.end(), [arg](const torrent::Object& obj) { return torrent::object_equal(obj, arg); })) {
     list.push_back(arg);
+    download->set_changed();
+  }
 
   return torrent::Object();
 }
@@ -581,6 +619,7 @@ d_list_remove(core::Download* download, const torrent::Object& rawArgs, const ch
   torrent::Object::list_type& list = download_get_variable(download, first_key, second_key).as_list();
 
   list.erase(std::remove_if(list.begin(), list.end(), [args](const torrent::Object& obj) { return torrent::object_equal(obj, args); }), list.end());
+  download->set_changed();
 
   return torrent::Object();
 }
@@ -600,19 +639,19 @@ d_list_remove(core::Download* download, const torrent::Object& rawArgs, const ch
 #define CMD2_BIND_DATA std::bind(&core::Download::data, std::placeholders::_1)
 
 #define CMD2_DL_VAR_VALUE(key, first_key, second_key)                   \
-  CMD2_DL(key, std::bind(&download_get_variable, std::placeholders::_1, first_key, second_key)); \
+  CMD2_DL_PURE(key, std::bind(&download_get_variable, std::placeholders::_1, first_key, second_key)); \
   CMD2_DL_VALUE_P(key ".set", std::bind(&download_set_variable_value, \
                                              std::placeholders::_1, std::placeholders::_2, \
                                              first_key, second_key));
 
 #define CMD2_DL_VAR_VALUE_PUBLIC(key, first_key, second_key)            \
-  CMD2_DL(key, std::bind(&download_get_variable, std::placeholders::_1, first_key, second_key)); \
+  CMD2_DL_PURE(key, std::bind(&download_get_variable, std::placeholders::_1, first_key, second_key)); \
   CMD2_DL_VALUE(key ".set", std::bind(&download_set_variable_value, \
                                            std::placeholders::_1, std::placeholders::_2, \
                                            first_key, second_key));
 
 #define CMD2_DL_TIMESTAMP(key, first_key, second_key)                   \
-  CMD2_DL(key, std::bind(&download_get_variable, std::placeholders::_1, first_key, second_key)); \
+  CMD2_DL_PURE(key, std::bind(&download_get_variable, std::placeholders::_1, first_key, second_key)); \
   CMD2_DL_VALUE_P(key ".set", std::bind(&download_set_variable_value,   \
                                         std::placeholders::_1, std::placeholders::_2, \
                                         first_key, second_key));        \
@@ -625,13 +664,13 @@ d_list_remove(core::Download* download, const torrent::Object& rawArgs, const ch
       return download_get_value_or_zero(download, first_key, second_key).as_value() > value; });
 
 #define CMD2_DL_VAR_STRING(key, first_key, second_key)                   \
-  CMD2_DL(key, std::bind(&download_get_variable, std::placeholders::_1, first_key, second_key)); \
+  CMD2_DL_PURE(key, std::bind(&download_get_variable, std::placeholders::_1, first_key, second_key)); \
   CMD2_DL_STRING_P(key ".set", std::bind(&download_set_variable_string, \
                                               std::placeholders::_1, std::placeholders::_2, \
                                               first_key, second_key));
 
 #define CMD2_DL_VAR_STRING_PUBLIC(key, first_key, second_key)                   \
-  CMD2_DL(key, std::bind(&download_get_variable, std::placeholders::_1, first_key, second_key)); \
+  CMD2_DL_PURE(key, std::bind(&download_get_variable, std::placeholders::_1, first_key, second_key)); \
   CMD2_DL_STRING(key ".set", std::bind(&download_set_variable_string, \
                                             std::placeholders::_1, std::placeholders::_2, \
                                             first_key, second_key));
@@ -649,8 +688,8 @@ initialize_command_download() {
   CMD2_DL("d.base_path",     std::bind(&retrieve_d_base_path, std::placeholders::_1));
   CMD2_DL("d.base_filename", std::bind(&retrieve_d_base_filename, std::placeholders::_1));
 
-  CMD2_DL("d.name",          CMD2_ON_INFO(name));
-  CMD2_DL("d.creation_date", CMD2_ON_INFO(creation_date));
+  CMD2_DL_PURE("d.name",          CMD2_ON_INFO(name));
+  CMD2_DL_PURE("d.creation_date", CMD2_ON_INFO(creation_date));
   CMD2_DL("d.load_date",     CMD2_ON_INFO(load_date));
 
   //
@@ -658,9 +697,9 @@ initialize_command_download() {
   //
 
   CMD2_DL         ("d.up.rate",       std::bind(&torrent::Rate::rate,  CMD2_ON_INFO(up_rate)));
-  CMD2_DL         ("d.up.total",      std::bind(&torrent::Rate::total, CMD2_ON_INFO(up_rate)));
+  CMD2_DL_PURE    ("d.up.total",      std::bind(&torrent::Rate::total, CMD2_ON_INFO(up_rate)));
   CMD2_DL         ("d.down.rate",     std::bind(&torrent::Rate::rate,  CMD2_ON_INFO(down_rate)));
-  CMD2_DL         ("d.down.total",    std::bind(&torrent::Rate::total, CMD2_ON_INFO(down_rate)));
+  CMD2_DL_PURE    ("d.down.total",    std::bind(&torrent::Rate::total, CMD2_ON_INFO(down_rate)));
   CMD2_DL         ("d.skip.rate",     std::bind(&torrent::Rate::rate,  CMD2_ON_INFO(skip_rate)));
   CMD2_DL         ("d.skip.total",    std::bind(&torrent::Rate::total, CMD2_ON_INFO(skip_rate)));
 
@@ -681,10 +720,10 @@ initialize_command_download() {
   // Control functinos:
   //
 
-  CMD2_DL         ("d.is_open",               CMD2_ON_INFO(is_open));
-  CMD2_DL         ("d.is_active",             CMD2_ON_INFO(is_active));
+  CMD2_DL_PURE    ("d.is_open",               CMD2_ON_INFO(is_open));
+  CMD2_DL_PURE    ("d.is_active",             CMD2_ON_INFO(is_active));
   CMD2_DL         ("d.is_hash_checked",       std::bind(&torrent::Download::is_hash_checked, CMD2_BIND_DL));
-  CMD2_DL         ("d.is_hash_checking",      std::bind(&torrent::Download::is_hash_checking, CMD2_BIND_DL));
+  CMD2_DL_PURE    ("d.is_hash_checking",      std::bind(&torrent::Download::is_hash_checking, CMD2_BIND_DL));
   CMD2_DL         ("d.is_multi_file",         std::bind(&torrent::FileList::is_multi_file, CMD2_BIND_FL));
   CMD2_DL         ("d.is_private",            CMD2_ON_INFO(is_private));
   CMD2_DL         ("d.is_pex_active",         CMD2_ON_INFO(is_pex_active));
@@ -711,13 +750,16 @@ initialize_command_download() {
   // Custom settings:
   //
 
-  CMD2_DL_STRING("d.custom",       std::bind(&retrieve_d_custom, std::placeholders::_1, std::placeholders::_2));
+  CMD2_DL_STRING_PURE("d.custom",  std::bind(&retrieve_d_custom, std::placeholders::_1, std::placeholders::_2));
   CMD2_DL_STRING("d.custom_throw", std::bind(&retrieve_d_custom_throw, std::placeholders::_1, std::placeholders::_2));
   CMD2_DL_LIST  ("d.custom.set",   std::bind(&apply_d_custom, std::placeholders::_1, std::placeholders::_2));
   CMD2_DL_LIST  ("d.custom.if_z",  std::bind(&retrieve_d_custom_if_z, std::placeholders::_1, std::placeholders::_2));
   CMD2_DL_LIST  ("d.custom.keys",  std::bind(&retrieve_d_custom_map, std::placeholders::_1, true, std::placeholders::_2));
   CMD2_DL_LIST  ("d.custom.items", std::bind(&retrieve_d_custom_map, std::placeholders::_1, false, std::placeholders::_2));
 
+  CMD2_ANY         ("custom.index",        std::bind(&retrieve_custom_index));
+  CMD2_ANY_STRING_V("custom.index.insert", std::bind(&core::DownloadList::insert_custom_index, control->core()->download_list(), std::placeholders::_2));
+
   CMD2_DL_VAR_STRING_PUBLIC("d.custom1", "rtorrent", "custom1");
   CMD2_DL_VAR_STRING_PUBLIC("d.custom2", "rtorrent", "custom2");
   CMD2_DL_VAR_STRING_PUBLIC("d.custom3", "rtorrent", "custom3");
@@ -788,7 +830,7 @@ initialize_command_download() {
 
   // This command really needs to be improved, so we have proper
   // logging support.
-  CMD2_DL         ("d.message",     std::bind(&core::Download::message, std::placeholders::_1));
+  CMD2_DL_PURE    ("d.message",     std::bind(&core::Download::message, std::placeholders::_1));
   CMD2_DL_STRING_V("d.message.set", std::bind(&core::Download::set_message, std::placeholders::_1, std::placeholders::_2));
 
   CMD2_DL         ("d.max_file_size",       CMD2_ON_FL(max_file_size));
@@ -806,7 +848,7 @@ initialize_command_download() {
   CMD2_DL_VALUE_V ("d.downloads_max.set",     std::bind(&torrent::Download::set_downloads_max, CMD2_BIND_DL, std::placeholders::_2));
   CMD2_DL         ("d.downloads_min",         std::bind(&torrent::Download::downloads_min, CMD2_BIND_DL));
   CMD2_DL_VALUE_V ("d.downloads_min.set",     std::bind(&torrent::Download::set_downloads_min, CMD2_BIND_DL, std::placeholders::_2));
-  CMD2_DL         ("d.peers_connected",     std::bind(&torrent::ConnectionList::size, CMD2_BIND_CL));
+  CMD2_DL_PURE    ("d.peers_connected",     std::bind(&torrent::ConnectionList::size, CMD2_BIND_CL));
   CMD2_DL         ("d.peers_not_connected", std::bind(&torrent::PeerList::available_list_size, CMD2_BIND_PL));
 
   CMD2_DL         ("d.peers_complete",      CMD2_ON_DL(peers_complete));
@@ -821,13 +863,13 @@ initialize_command_download() {
   CMD2_DL         ("d.throttle_name",     std::bind(&download_get_variable, std::placeholders::_1, "rtorrent", "throttle_name"));
   CMD2_DL_STRING_V("d.throttle_name.set", std::bind(&core::Download::set_throttle_name, std::placeholders::_1, std::placeholders::_2));
 
-  CMD2_DL         ("d.bytes_done",     CMD2_ON_DL(bytes_done));
-  CMD2_DL         ("d.ratio",          std::bind(&retrieve_d_ratio, std::placeholders::_1));
+  CMD2_DL_PURE    ("d.bytes_done",     CMD2_ON_DL(bytes_done));
+  CMD2_DL_PURE    ("d.ratio",          std::bind(&retrieve_d_ratio, std::placeholders::_1));
   CMD2_DL         ("d.chunks_hashed",  CMD2_ON_DL(chunks_hashed));
   CMD2_DL         ("d.free_diskspace", CMD2_ON_FL(free_diskspace));
 
   CMD2_DL         ("d.size_files",     CMD2_ON_FL(size_files));
-  CMD2_DL         ("d.size_bytes",     CMD2_ON_FL(size_bytes));
+  CMD2_DL_PURE    ("d.size_bytes",     CMD2_ON_FL(size_bytes));
   CMD2_DL         ("d.size_chunks",    CMD2_ON_FL(size_chunks));
   CMD2_DL         ("d.chunk_size",     CMD2_ON_FL(chunk_size));
   CMD2_DL         ("d.size_pex",       CMD2_ON_DL(size_pex));
@@ -835,9 +877,9 @@ initialize_command_download() {
 
   CMD2_DL         ("d.chunks_seen",      std::bind(&d_chunks_seen, std::placeholders::_1));
 
-  CMD2_DL         ("d.completed_bytes",  CMD2_ON_FL(completed_bytes));
+  CMD2_DL_PURE    ("d.completed_bytes",  CMD2_ON_FL(completed_bytes));
   CMD2_DL         ("d.completed_chunks", CMD2_ON_FL(completed_chunks));
-  CMD2_DL         ("d.left_bytes",       CMD2_ON_FL(left_bytes));
+  CMD2_DL_PURE    ("d.left_bytes",       CMD2_ON_FL(left_bytes));
 
   CMD2_DL         ("d.wanted_chunks",    CMD2_ON_DATA(wanted_chunks));
 
@@ -862,7 +904,7 @@ initialize_command_download() {
   CMD2_DL         ("d.directory_base",     CMD2_ON_FL(root_dir));
   CMD2_DL_STRING_V("d.directory_base.set", std::bind(&core::Download::set_root_directory, std::placeholders::_1, std::placeholders::_2));
 
-  CMD2_DL         ("d.priority",     std::bind(&core::Download::priority, std::placeholders::_1));
+  CMD2_DL_PURE    ("d.priority",     std::bind(&core::Download::priority, std::placeholders::_1));
   CMD2_DL         ("d.priority_str", std::bind(&retrieve_d_priority_str, std::placeholders::_1));
   CMD2_DL_VALUE_V ("d.priority.set", std::bind(&core::Download::set_priority, std::placeholders::_1, std::placeholders::_2));
 
@@ -100,7 +100,7 @@ system_method_generate_command2(torrent::Object* object, torrent::Object::list_c
 
 // }
 
-// This is only used by tinyxml2, xmlrpc-c intercepts the call internally
+// This is only used by tinyxml2 and stream, xmlrpc-c intercepts the call internally
 torrent::Object
 system_listMethods() {
   torrent::Object resultRaw = torrent::Object::create_list();
@@ -405,8 +405,8 @@ cmd_catch(rpc::target_type target, const torrent::Object& args) {
 void
 initialize_command_dynamic() {
   // clang-format off
-#ifdef HAVE_XMLRPC_TINYXML2
-  CMD2_ANY         ("system.listMethods", std::bind(&system_listMethods)); // only used by tinyxml2
+#if defined(HAVE_XMLRPC_TINYXML2) || defined(HAVE_XMLRPC_STREAM)
+  CMD2_ANY         ("system.listMethods", std::bind(&system_listMethods)); // only used by tinyxml2 and stream
 #endif
 
   // Keep these for future use when we deprecate more commands.
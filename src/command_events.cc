@@ -2,6 +2,8 @@
 
 #include <functional>
 #include <cstdio>
+#include <random>
+#include <unordered_set>
 #include <rak/error_number.h>
 #include <rak/file_stat.h>
 #include <rak/path.h>
@@ -17,6 +19,7 @@
 #include "core/download.h"
 #include "core/download_list.h"
 #include "core/manager.h"
+#include "core/page_sort.h"
 #include "core/view_manager.h"
 #include "rpc/command_scheduler.h"
 #include "rpc/parse.h"
@@ -232,20 +235,22 @@ d_multicall(const torrent::Object::list_type& args) {
   if (view_itr == viewManager->end())
     throw torrent::input_error("Could not find view.");
 
-  // Add some pre-parsing of the commands, so we don't spend time
-  // parsing and searching command map for every single call.
-  std::vector<core::Download*> dlist((*view_itr)->begin_visible(), (*view_itr)->end_visible());
+  // Parse the commands and search the command map once, rather than
+  // for every single call.
+  std::vector<rpc::CommandPlan> plans = rpc::parse_command_plans(++args.begin(), args.end());
+  std::vector<core::Download*>  dlist((*view_itr)->begin_visible(), (*view_itr)->end_visible());
 
   torrent::Object             resultRaw = torrent::Object::create_list();
   torrent::Object::list_type& result = resultRaw.as_list();
 
+  result.reserve(dlist.size());
+
   for (auto download : dlist) {
     torrent::Object::list_type& row = result.insert(result.end(), torrent::Object::create_list())->as_list();
+    row.reserve(plans.size());
 
-    for (torrent::Object::list_const_iterator cItr = ++args.begin(); cItr != args.end(); cItr++) {
-      auto& cmd = cItr->as_string();
-      row.push_back(rpc::parse_command(rpc::make_target(download), cmd.c_str(), cmd.c_str() + cmd.size()).first);
-    }
+    for (const auto& plan : plans)
+      row.push_back(plan.call(rpc::make_target(download)));
   }
 
   return resultRaw;
@@ -268,22 +273,218 @@ d_multicall_filtered(const torrent::Object::list_type& args) {
   core::View::base_type dlist;
   (*view_itr)->filter_by(*++arg, dlist);
 
+  // Parse the provided commands once, skipping to the first command
+  std::vector<rpc::CommandPlan> plans = rpc::parse_command_plans(++arg, args.end());
+
   // Generate result by iterating over all items
   torrent::Object             resultRaw = torrent::Object::create_list();
   torrent::Object::list_type& result = resultRaw.as_list();
-  ++arg;  // skip to first command
+
+  result.reserve(dlist.size());
 
   for (const auto& item : dlist) {
     // Add empty row to result
     torrent::Object::list_type& row = result.insert(result.end(), torrent::Object::create_list())->as_list();
+    row.reserve(plans.size());
 
     // Call the provided commands and assemble their results
-    for (torrent::Object::list_const_iterator command = arg; command != args.end(); command++) {
-      auto& cmdstr = command->as_string();
-      row.push_back(rpc::parse_command(rpc::make_target(item), cmdstr.c_str(), cmdstr.c_str() + cmdstr.size()).first);
+    for (const auto& plan : plans)
+      row.push_back(plan.call(rpc::make_target(item)));
+  }
+
+  return resultRaw;
+}
+
+// Change sequences restart with the client, so sequences given to
+// pollers include a random per-process epoch.
+static const int      multicall_epoch_shift   = 40;
+static const uint64_t multicall_sequence_mask = (uint64_t(1) << multicall_epoch_shift) - 1;
+
+static uint64_t
+multicall_epoch() {
+  static const uint64_t epoch = std::random_device{}() % ((1 << 22) - 1) + 1;
+
+  return epoch;
+}
+
+// Returns the rows of downloads in the view that changed or became
+// visible after the given sequence, and the hashes of those that left
+// the view, either erased or filtered out. Include 'd.hash=' in the
+// commands to identify the rows.
+//
+// If 'full' is set, the rows are all the downloads in the view and the
+// client should drop any it had before. That happens when the sequence
+// is zero, from another run of the client, newer than the current one,
+// older than the view or the view's log no longer covers it.
+//
+// The returned sequence carries the epoch in the bits above the change
+// sequence, clients should treat it as opaque.
+torrent::Object
+d_multicall_changed(const torrent::Object::list_type& args) {
+  if (args.size() < 2)
+    throw torrent::input_error("d.multicall.changed requires at least 2 arguments.");
+
+  torrent::Object::list_const_iterator arg = args.begin();
+
+  core::ViewManager* viewManager = control->view_manager();
+  core::ViewManager::iterator view_itr = viewManager->find(arg->as_string().empty() ? "default" : arg->as_string());
+
+  if (view_itr == viewManager->end())
+    throw torrent::input_error("Could not find view '" + arg->as_string() + "'.");
+
+  core::View* view = *view_itr;
+
+  int64_t since = rpc::convert_to_value(*++arg);
+
+  if (since < 0)
+    throw torrent::input_error("Invalid sequence.");
+
+  std::vector<rpc::CommandPlan> plans = rpc::parse_command_plans(++arg, args.end());
+
+  core::DownloadList*      download_list = control->core()->download_list();
+  uint64_t                 sequence      = download_list->update_changes();
+  std::vector<std::string> removed;
+
+  uint64_t since_epoch    = (uint64_t)since >> multicall_epoch_shift;
+  uint64_t since_sequence = (uint64_t)since & multicall_sequence_mask;
+
+  bool full = since_sequence == 0 || since_epoch != multicall_epoch() || since_sequence > sequence ||
+              !view->left_since(since_sequence, &removed);
+
+  if (full)
+    removed.clear();
+
+  torrent::Object             resultRaw = torrent::Object::create_map();
+  torrent::Object::map_type&  result    = resultRaw.as_map();
+  torrent::Object::list_type& rows      = (result["changed"] = torrent::Object::create_list()).as_list();
+
+  // Downloads that left and came back are only returned as rows, and
+  // those that left more than once are listed once.
+  std::unordered_set<std::string> returned;
+
+  for (core::View::const_iterator itr = view->begin_visible(), last = view->end_visible(); itr != last; itr++) {
+    if (!full) {
+      bool entered = view->visible_sequence(*itr) > since_sequence;
+
+      if ((*itr)->change_sequence() <= since_sequence && !entered)
+        continue;
+
+      if (entered) {
+        const torrent::HashString& hash = (*itr)->info()->hash();
+        returned.insert(rak::transform_hex(hash.begin(), hash.end()));
+      }
+    }
+
+    torrent::Object::list_type& row = rows.insert(rows.end(), torrent::Object::create_list())->as_list();
+    row.reserve(plans.size());
+
+    for (const auto& plan : plans)
+      row.push_back(plan.call(rpc::make_target(*itr)));
+  }
+
+  torrent::Object::list_type& removed_list = (result["removed"] = torrent::Object::create_list()).as_list();
+
+  for (auto& hash : removed)
+    if (returned.insert(hash).second)
+      removed_list.push_back(std::move(hash));
+
+  result["sequence"] = (int64_t)(multicall_epoch() << multicall_epoch_shift | (sequence & multicall_sequence_mask));
+  result["full"]     = (int64_t)full;
+
+  return resultRaw;
+}
+
+// Sorts the view by the given keys and returns the rows for a window
+// of it, along with the total number of downloads in the view:
+//
+// d.multicall.paged = <view>, <order>, <sort key(s)>, <offset>, <limit>, <cmd>...
+//
+// The order string has a character for each sort key, as in 'compare',
+// with 'a' or '+' for ascending and 'd' or '-' for descending order.
+// Downloads with equal keys are kept in view order.
+//
+// Each sort key is evaluated once per download, then only the rows up
+// to the end of the window are ordered.
+torrent::Object
+d_multicall_paged(const torrent::Object::list_type& args) {
+  if (args.size() < 5)
+    throw torrent::input_error("d.multicall.paged requires at least 5 arguments.");
+
+  torrent::Object::list_const_iterator arg = args.begin();
+
+  core::ViewManager* viewManager = control->view_manager();
+  core::ViewManager::iterator view_itr = viewManager->find(arg->as_string().empty() ? "default" : arg->as_string());
+
+  if (view_itr == viewManager->end())
+    throw torrent::input_error("Could not find view '" + arg->as_string() + "'.");
+
+  const std::string& order = (++arg)->as_string();
+
+  std::vector<rpc::CommandPlan> sort_plans;
+  ++arg;
+
+  if (arg->is_list())
+    sort_plans = rpc::parse_command_plans(arg->as_list().begin(), arg->as_list().end());
+  else
+    sort_plans = rpc::parse_command_plans(arg, std::next(arg));
+
+  std::vector<bool> descending;
+
+  for (size_t i = 0; i < sort_plans.size(); i++) {
+    char c = i < order.size() ? order[i] : 'a';
+
+    if (c != 'a' && c != 'A' && c != '+' && c != 'd' && c != 'D' && c != '-')
+      throw torrent::input_error(std::string("Bad order '") + c + "' in " + order);
+
+    descending.push_back(c == 'd' || c == 'D' || c == '-');
+  }
+
+  int64_t offset = rpc::convert_to_value(*++arg);
+  int64_t limit  = rpc::convert_to_value(*++arg);
+
+  if (offset < 0 || limit < 0)
+    throw torrent::input_error("Invalid offset or limit.");
+
+  std::vector<rpc::CommandPlan> plans = rpc::parse_command_plans(++arg, args.end());
+  std::vector<core::Download*>  dlist((*view_itr)->begin_visible(), (*view_itr)->end_visible());
+
+  size_t key_count = sort_plans.size();
+
+  // Keys are stored flat, 'key_count' entries for each download in
+  // view order.
+  std::vector<torrent::Object> keys;
+  keys.reserve(dlist.size() * key_count);
+
+  for (size_t index = 0; index != dlist.size(); index++) {
+    for (size_t k = 0; k != key_count; k++) {
+      keys.push_back(sort_plans[k].call(rpc::make_target(dlist[index])));
+
+      if (!keys.back().is_value() && !keys.back().is_string())
+        throw torrent::input_error("Sort key must be a value or a string.");
+
+      if (index != 0 && keys.back().type() != keys[k].type())
+        throw torrent::input_error("Type mismatch in sort key.");
     }
   }
 
+  std::vector<uint32_t> indices = core::page_sort(keys, descending, dlist.size(), offset, limit);
+
+  torrent::Object             resultRaw = torrent::Object::create_map();
+  torrent::Object::map_type&  result    = resultRaw.as_map();
+  torrent::Object::list_type& rows      = (result["rows"] = torrent::Object::create_list()).as_list();
+
+  rows.reserve(indices.size());
+
+  for (auto index : indices) {
+    torrent::Object::list_type& row = rows.insert(rows.end(), torrent::Object::create_list())->as_list();
+    row.reserve(plans.size());
+
+    for (const auto& plan : plans)
+      row.push_back(plan.call(rpc::make_target(dlist[index])));
+  }
+
+  result["total"] = (int64_t)dlist.size();
+
   return resultRaw;
 }
 
@@ -344,6 +545,8 @@ initialize_command_events() {
   CMD2_ANY_LIST    ("download_list",       std::bind(&apply_download_list, std::placeholders::_2));
   CMD2_ANY_LIST    ("d.multicall2",        std::bind(&d_multicall, std::placeholders::_2));
   CMD2_ANY_LIST    ("d.multicall.filtered", std::bind(&d_multicall_filtered, std::placeholders::_2));
+  CMD2_ANY_LIST    ("d.multicall.changed",  std::bind(&d_multicall_changed, std::placeholders::_2));
+  CMD2_ANY_LIST    ("d.multicall.paged",    std::bind(&d_multicall_paged, std::placeholders::_2));
 
   CMD2_ANY_LIST    ("directory.watch.added", std::bind(&directory_watch_added, std::placeholders::_2));
 }
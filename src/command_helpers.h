@@ -19,6 +19,10 @@ void initialize_commands();
   rpc::commands.insert_slot<rpc::command_base_is_type<rpc::function>::type>(key, slot, &rpc::function,   \
                             rpc::CommandMap::flag_dont_delete, NULL, NULL);
 
+#define CMD2_A_FUNCTION_PURE(key, function, slot, parm, doc)            \
+  rpc::commands.insert_slot<rpc::command_base_is_type<rpc::function>::type>(key, slot, &rpc::function, \
+                            rpc::CommandMap::flag_dont_delete | rpc::CommandMap::flag_public_rpc | rpc::CommandMap::flag_pure, NULL, NULL);
+
 #define CMD2_ANY(key, slot)          CMD2_A_FUNCTION(key, command_base_call<rpc::target_type>, slot, "i:", "")
 
 #define CMD2_ANY_P(key, slot)        CMD2_A_FUNCTION_PRIVATE(key, command_base_call<rpc::target_type>, slot, "i:", "")
@@ -43,6 +47,9 @@ void initialize_commands();
 #define CMD2_DL_STRING_V(key, slot)  CMD2_A_FUNCTION(key, command_base_call_string<core::Download*>, object_convert_void(slot), "i:", "")
 #define CMD2_DL_LIST(key, slot)      CMD2_A_FUNCTION(key, command_base_call_list<core::Download*>, slot, "i:", "")
 
+#define CMD2_DL_PURE(key, slot)        CMD2_A_FUNCTION_PURE(key, command_base_call<core::Download*>, slot, "i:", "")
+#define CMD2_DL_STRING_PURE(key, slot) CMD2_A_FUNCTION_PURE(key, command_base_call_string<core::Download*>, slot, "i:", "")
+
 #define CMD2_DL_VALUE_P(key, slot)   CMD2_A_FUNCTION_PRIVATE(key, command_base_call_value<core::Download*>, slot, "i:", "")
 #define CMD2_DL_STRING_P(key, slot)  CMD2_A_FUNCTION_PRIVATE(key, command_base_call_string<core::Download*>, slot, "i:", "")
 
@@ -23,6 +23,7 @@
 #include "core/download.h"
 #include "core/manager.h"
 #include "rpc/scgi.h"
+#include "rpc/subscription_manager.h"
 #include "ui/root.h"
 #include "rpc/parse.h"
 #include "rpc/parse_commands.h"
@@ -77,18 +78,46 @@ initialize_rpc_handlers() {
 }
 
 torrent::Object
-apply_scgi(const std::string& arg, int type) {
-  if (scgi_thread::scgi() != nullptr)
+apply_scgi_counter(rpc::SCgi* scgi, uint64_t (*counter)(const rpc::SCgi*)) {
+  if (scgi == nullptr)
+    return int64_t();
+
+  return (int64_t)counter(scgi);
+}
+
+// The timeout argument is only used by the RPC listener, which holds
+// the request while the subscription has nothing queued.
+torrent::Object
+apply_subscription_poll(const torrent::Object::list_type& args) {
+  if (args.empty() || args.size() > 2)
+    throw torrent::input_error("invalid number of arguments");
+
+  return rpc::subscriptions.poll(rpc::convert_to_value(args.front()));
+}
+
+torrent::Object
+apply_scgi(const std::string& arg, int type, rpc::SCgi::Protocol protocol) {
+  if (protocol == rpc::SCgi::SCGI && scgi_thread::scgi() != nullptr)
     throw torrent::input_error("SCGI already enabled.");
 
-  initialize_rpc_handlers();
+  if (protocol == rpc::SCgi::HTTP && scgi_thread::http() != nullptr)
+    throw torrent::input_error("HTTP RPC already enabled.");
+
+  if (!rpc::rpc.is_handlers_initialized())
+    initialize_rpc_handlers();
 
   rpc::SCgi* scgi = new rpc::SCgi;
 
+  scgi->set_protocol(protocol);
+  scgi->set_keep_alive(rpc::call_command_value("network.scgi.keep_alive"));
+  scgi->set_compress_min_size(rpc::call_command_value("network.scgi.compress_min_size"));
+
   rak::address_info* ai = NULL;
   torrent::sa_unique_ptr sa;
 
   try {
+    scgi->set_max_tasks(rpc::call_command_value("network.scgi.max_connections"));
+
     int port, err;
     char dummy;
     char address[1024];
@@ -141,7 +170,11 @@ apply_scgi(const std::string& arg, int type) {
     throw torrent::input_error(e.what());
   }
 
-  scgi_thread::set_scgi(scgi);
+  if (protocol == rpc::SCgi::HTTP)
+    scgi_thread::set_http(scgi);
+  else
+    scgi_thread::set_scgi(scgi);
+
   return torrent::Object();
 }
 
@@ -243,16 +276,44 @@ initialize_command_network() {
   CMD2_ANY         ("network.max_open_sockets",      [cm](auto, auto)                  { return cm->max_size(); });
   CMD2_ANY_VALUE_V ("network.max_open_sockets.set",  [cm](auto, auto& value)           { return cm->set_max_size(value); });
 
-  CMD2_ANY_STRING  ("network.scgi.open_port",        std::bind(&apply_scgi, std::placeholders::_2, 1));
-  CMD2_ANY_STRING  ("network.scgi.open_local",       std::bind(&apply_scgi, std::placeholders::_2, 2));
+  CMD2_ANY_STRING  ("network.scgi.open_port",        std::bind(&apply_scgi, std::placeholders::_2, 1, rpc::SCgi::SCGI));
+  CMD2_ANY_STRING  ("network.scgi.open_local",       std::bind(&apply_scgi, std::placeholders::_2, 2, rpc::SCgi::SCGI));
   CMD2_VAR_BOOL    ("network.scgi.dont_route",       false);
+  CMD2_VAR_BOOL    ("network.scgi.keep_alive",       false);
+  CMD2_VAR_VALUE   ("network.scgi.max_connections",  rpc::SCgi::default_max_tasks);
+  CMD2_VAR_VALUE   ("network.scgi.threads",          1);
+  CMD2_VAR_VALUE   ("network.scgi.compress_min_size", rpc::SCgi::default_compress_min_size);
+
+  CMD2_ANY         ("network.scgi.connections.accepted",  [](auto, auto) { return apply_scgi_counter(scgi_thread::scgi(), [](const rpc::SCgi* scgi) { return scgi->accepted(); }); });
+  CMD2_ANY         ("network.scgi.connections.rejected",  [](auto, auto) { return apply_scgi_counter(scgi_thread::scgi(), [](const rpc::SCgi* scgi) { return scgi->rejected(); }); });
+  CMD2_ANY         ("network.scgi.connections.errors",    [](auto, auto) { return apply_scgi_counter(scgi_thread::scgi(), [](const rpc::SCgi* scgi) { return scgi->errors(); }); });
+  CMD2_ANY         ("network.scgi.connections.in_flight", [](auto, auto) { return apply_scgi_counter(scgi_thread::scgi(), [](const rpc::SCgi* scgi) { return (uint64_t)scgi->in_flight(); }); });
 
   CMD2_ANY_STRING  ("network.xmlrpc.dialect.set",    [](const auto&, const auto& arg) { return apply_xmlrpc_dialect(arg); })
   CMD2_ANY         ("network.xmlrpc.size_limit",     [](const auto&, const auto&)     { return rpc::rpc.size_limit(); });
   CMD2_ANY_VALUE_V ("network.xmlrpc.size_limit.set", [](const auto&, const auto& arg) { return rpc::rpc.set_size_limit(arg); });
 
+  CMD2_ANY         ("system.rpc.stats",              [](const auto&, const auto&) { return rpc::rpc.stats()->methods_to_object(); });
+  CMD2_ANY         ("system.rpc.stats.requests",     [](const auto&, const auto&) { return rpc::rpc.stats()->requests_to_object(); });
+  CMD2_ANY_V       ("system.rpc.stats.reset",        [](const auto&, const auto&) { rpc::rpc.stats()->reset(); });
+
+  CMD2_ANY_LIST    ("system.subscribe",              [](const auto&, const auto& args) { return (int64_t)rpc::subscriptions.subscribe(args); });
+  CMD2_ANY_VALUE_V ("system.unsubscribe",            [](const auto&, const auto& arg)  { return rpc::subscriptions.unsubscribe(arg); });
+  CMD2_ANY_LIST    ("system.subscription.poll",      [](const auto&, const auto& args) { return apply_subscription_poll(args); });
+
   CMD2_VAR_BOOL    ("network.rpc.use_xmlrpc",        true);
   CMD2_VAR_BOOL    ("network.rpc.use_jsonrpc",       true);
+  CMD2_VAR_BOOL    ("network.rpc.use_bencode",       true);
+  CMD2_ANY         ("network.rpc.use_snapshot",      [](const auto&, const auto&)     { return rpc::rpc.is_snapshot_enabled(); });
+  CMD2_ANY_VALUE_V ("network.rpc.use_snapshot.set",  [](const auto&, const auto& arg) { return rpc::rpc.set_snapshot_enabled(arg); });
+
+  CMD2_ANY_STRING  ("network.rpc.http.open_port",    std::bind(&apply_scgi, std::placeholders::_2, 1, rpc::SCgi::HTTP));
+  CMD2_ANY_STRING  ("network.rpc.http.open_local",   std::bind(&apply_scgi, std::placeholders::_2, 2, rpc::SCgi::HTTP));
+
+  CMD2_ANY         ("network.rpc.http.connections.accepted",  [](auto, auto) { return apply_scgi_counter(scgi_thread::http(), [](const rpc::SCgi* http) { return http->accepted(); }); });
+  CMD2_ANY         ("network.rpc.http.connections.rejected",  [](auto, auto) { return apply_scgi_counter(scgi_thread::http(), [](const rpc::SCgi* http) { return http->rejected(); }); });
+  CMD2_ANY         ("network.rpc.http.connections.errors",    [](auto, auto) { return apply_scgi_counter(scgi_thread::http(), [](const rpc::SCgi* http) { return http->errors(); }); });
+  CMD2_ANY         ("network.rpc.http.connections.in_flight", [](auto, auto) { return apply_scgi_counter(scgi_thread::http(), [](const rpc::SCgi* http) { return (uint64_t)http->in_flight(); }); });
 
   CMD2_ANY         ("network.block.ipv4",            [nw_config](auto, auto)        { return nw_config->is_block_ipv4(); });
   CMD2_ANY_VALUE_V ("network.block.ipv4.set",        [nw_config](auto, auto& value) { return nw_config->set_block_ipv4(value); });
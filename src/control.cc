@@ -46,6 +46,11 @@ Control::Control()
 
   m_task_shutdown.slot() = std::bind(&Control::handle_shutdown, this);
 
+  m_task_rpc_snapshot.slot() = [this] {
+      rpc::rpc.publish_snapshot(m_core->download_list());
+      torrent::this_thread::scheduler()->wait_for_ceil_seconds(&m_task_rpc_snapshot, 1s);
+    };
+
   m_commandScheduler->set_slot_error_message([this](const std::string& msg) { m_core->push_log_std(msg); });
 }
 
@@ -59,6 +64,10 @@ Control::~Control() {
 void
 Control::initialize() {
   session_thread::thread()->start_thread();
+
+  // Listeners opened by the config file have already posted their
+  // activation, which builds the task pools from the workers.
+  scgi_thread::start_workers(rpc::call_command_value("network.scgi.threads"));
   scgi_thread::thread()->start_thread();
 
   display::Canvas::initialize();
@@ -73,6 +82,8 @@ Control::initialize() {
 
   m_ui->init(this);
 
+  torrent::this_thread::scheduler()->wait_for_ceil_seconds(&m_task_rpc_snapshot, 1s);
+
   if(!display::Canvas::daemon())
     m_inputStdin->insert(torrent::this_thread::poll());
 }
@@ -82,6 +93,7 @@ Control::cleanup() {
   rpc::rpc.cleanup();
 
   torrent::this_thread::scheduler()->erase(&m_task_shutdown);
+  torrent::this_thread::scheduler()->erase(&m_task_rpc_snapshot);
 
   if(!display::Canvas::daemon())
     m_inputStdin->remove(torrent::this_thread::poll());
@@ -89,6 +101,8 @@ Control::cleanup() {
   if (scgi_thread::thread()->is_active())
     scgi_thread::thread()->stop_thread_wait();
 
+  scgi_thread::stop_workers();
+
   // Wait for all session files to be written.
   session_thread::manager()->flush_all_pending_builds();
   session_thread::thread()->stop_thread_wait();
@@ -131,6 +145,8 @@ Control::handle_shutdown() {
   if (scgi_thread::thread()->is_active())
     scgi_thread::thread()->stop_thread_wait();
 
+  scgi_thread::stop_workers();
+
   if (!m_shutdownQuick) {
     torrent::runtime::network_manager()->listen_close();
 
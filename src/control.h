@@ -101,6 +101,7 @@ private:
   std::string         m_workingDirectory;
 
   torrent::utils::SchedulerEntry m_task_shutdown;
+  torrent::utils::SchedulerEntry m_task_rpc_snapshot;
 
   std::atomic<bool>   m_shutdownReceived{};
   std::atomic<bool>   m_shutdownQuick{};
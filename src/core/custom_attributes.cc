@@ -0,0 +1,177 @@
+#include "config.h"
+
+#include "core/custom_attributes.h"
+
+#include <algorithm>
+#include <torrent/exceptions.h>
+
+namespace core {
+
+static std::unordered_map<std::string, CustomAttributes::key_type> custom_keys;
+static std::vector<std::string>                                     custom_key_names;
+
+CustomAttributes::key_type
+CustomAttributes::key(const std::string& name) {
+  auto result = custom_keys.emplace(name, custom_key_names.size());
+
+  if (result.second)
+    custom_key_names.push_back(name);
+
+  return result.first->second;
+}
+
+bool
+CustomAttributes::find_key(const std::string& name, key_type* key) {
+  auto itr = custom_keys.find(name);
+
+  if (itr == custom_keys.end())
+    return false;
+
+  *key = itr->second;
+  return true;
+}
+
+const std::string&
+CustomAttributes::key_name(key_type key) {
+  if (key >= custom_key_names.size())
+    throw torrent::internal_error("CustomAttributes::key_name(...) invalid key.");
+
+  return custom_key_names[key];
+}
+
+static bool
+custom_key_less(const std::pair<CustomAttributes::key_type, torrent::Object>& entry, CustomAttributes::key_type key) {
+  return entry.first < key;
+}
+
+const torrent::Object*
+CustomAttributes::find(key_type key) const {
+  auto itr = std::lower_bound(m_values.begin(), m_values.end(), key, &custom_key_less);
+
+  return itr != m_values.end() && itr->first == key ? &itr->second : NULL;
+}
+
+void
+CustomAttributes::set(key_type key, const torrent::Object& value) {
+  if (!is_valid_value(value))
+    throw torrent::internal_error("CustomAttributes::set(...) value is not a string or integer.");
+
+  auto itr = std::lower_bound(m_values.begin(), m_values.end(), key, &custom_key_less);
+
+  if (itr != m_values.end() && itr->first == key)
+    itr->second = value;
+  else
+    m_values.emplace(itr, key, value);
+}
+
+void
+CustomAttributes::load(const torrent::Object& map) {
+  m_values.clear();
+
+  if (!map.is_map())
+    return;
+
+  for (const auto& entry : map.as_map())
+    if (is_valid_value(entry.second))
+      set(key(entry.first), entry.second);
+}
+
+std::vector<CustomIndex::key_type>
+CustomIndex::keys() const {
+  std::vector<key_type> result;
+
+  for (const auto& index : m_indexes)
+    result.push_back(index.first);
+
+  return result;
+}
+
+const CustomIndex::download_set*
+CustomIndex::find(key_type key, const torrent::Object& value) const {
+  static const download_set empty_set;
+
+  auto index = m_indexes.find(key);
+
+  if (index == m_indexes.end())
+    return NULL;
+
+  if (value.is_string()) {
+    auto itr = index->second.strings.find(value.as_string());
+    return itr != index->second.strings.end() ? &itr->second : &empty_set;
+  }
+
+  if (value.is_value()) {
+    auto itr = index->second.values.find(value.as_value());
+    return itr != index->second.values.end() ? &itr->second : &empty_set;
+  }
+
+  return &empty_set;
+}
+
+void
+CustomIndex::insert(Download* download, const CustomAttributes& custom) {
+  if (m_indexes.empty())
+    return;
+
+  custom.for_each([&](key_type key, const torrent::Object&) { insert(download, custom, key); });
+}
+
+void
+CustomIndex::insert(Download* download, const CustomAttributes& custom, key_type key) {
+  auto index = m_indexes.find(key);
+
+  if (index == m_indexes.end())
+    return;
+
+  const torrent::Object* value = custom.find(key);
+
+  if (value == NULL)
+    return;
+
+  if (value->is_string())
+    index->second.strings[value->as_string()].insert(download);
+  else
+    index->second.values[value->as_value()].insert(download);
+}
+
+void
+CustomIndex::erase(Download* download, const CustomAttributes& custom) {
+  if (m_indexes.empty())
+    return;
+
+  custom.for_each([&](key_type key, const torrent::Object&) { erase(download, custom, key); });
+}
+
+template <typename Map, typename Key>
+static void
+custom_index_erase(Map& map, const Key& key, Download* download) {
+  auto itr = map.find(key);
+
+  if (itr == map.end())
+    return;
+
+  itr->second.erase(download);
+
+  if (itr->second.empty())
+    map.erase(itr);
+}
+
+void
+CustomIndex::erase(Download* download, const CustomAttributes& custom, key_type key) {
+  auto index = m_indexes.find(key);
+
+  if (index == m_indexes.end())
+    return;
+
+  const torrent::Object* value = custom.find(key);
+
+  if (value == NULL)
+    return;
+
+  if (value->is_string())
+    custom_index_erase(index->second.strings, value->as_string(), download);
+  else
+    custom_index_erase(index->second.values, value->as_value(), download);
+}
+
+}
@@ -0,0 +1,100 @@
+// Typed custom attributes of a download, as set by 'd.custom.set'.
+//
+// Keys are interned once and shared by all downloads, while the values
+// are either strings or integers. Every attribute is also kept in the
+// download's "rtorrent/custom" map, which is what the session files
+// save, and the attributes are loaded back from it when the download
+// is inserted into DownloadList.
+//
+// CustomIndex keeps the downloads by value for the keys added with
+// 'custom.index.insert', so that filters comparing a custom attribute
+// with 'equal' are answered without calling the filter on each
+// download.
+
+#ifndef RTORRENT_CORE_CUSTOM_ATTRIBUTES_H
+#define RTORRENT_CORE_CUSTOM_ATTRIBUTES_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include <torrent/object.h>
+
+namespace core {
+
+class Download;
+
+class CustomAttributes {
+public:
+  typedef uint32_t key_type;
+
+  // Interns the key if it hasn't been seen before.
+  static key_type           key(const std::string& name);
+
+  // Doesn't intern, so it may be called from the threads testing pure
+  // view filters.
+  static bool               find_key(const std::string& name, key_type* key);
+
+  static const std::string& key_name(key_type key);
+
+  static bool               is_valid_value(const torrent::Object& value) { return value.is_string() || value.is_value(); }
+
+  bool                      empty() const { return m_values.empty(); }
+
+  // Returns NULL if the attribute isn't set.
+  const torrent::Object*    find(key_type key) const;
+
+  void                      set(key_type key, const torrent::Object& value);
+
+  // Replaces the attributes with the string and integer values of a
+  // "rtorrent/custom" map, other types are skipped.
+  void                      load(const torrent::Object& map);
+
+  template <typename Func>
+  void                      for_each(Func func) const {
+    for (const auto& entry : m_values)
+      func(entry.first, entry.second);
+  }
+
+private:
+  // Sorted by key, downloads only have a handful of attributes.
+  std::vector<std::pair<key_type, torrent::Object>> m_values;
+};
+
+class CustomIndex {
+public:
+  typedef CustomAttributes::key_type key_type;
+  typedef std::unordered_set<Download*> download_set;
+
+  bool                      is_indexed(key_type key) const { return m_indexes.find(key) != m_indexes.end(); }
+
+  std::vector<key_type>     keys() const;
+
+  // Only adds the key, the caller then inserts the downloads.
+  void                      insert_key(key_type key) { m_indexes[key]; }
+
+  // Returns NULL if 'key' isn't indexed, else the downloads where the
+  // attribute has the same type and value.
+  const download_set*       find(key_type key, const torrent::Object& value) const;
+
+  // The download's current attributes are passed along, erase before
+  // they change and insert again after.
+  void                      insert(Download* download, const CustomAttributes& custom);
+  void                      insert(Download* download, const CustomAttributes& custom, key_type key);
+  void                      erase(Download* download, const CustomAttributes& custom);
+  void                      erase(Download* download, const CustomAttributes& custom, key_type key);
+
+private:
+  struct index_type {
+    std::unordered_map<std::string, download_set> strings;
+    std::unordered_map<int64_t, download_set>     values;
+  };
+
+  std::unordered_map<key_type, index_type> m_indexes;
+};
+
+}
+
+#endif
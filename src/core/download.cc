@@ -63,6 +63,38 @@ Download::set_priority(uint32_t p) {
     torrent::download_set_priority(m_download, p * p);
 
   bencode()->get_key("rtorrent").insert_key("priority", (int64_t)p);
+  m_changed = true;
+}
+
+void
+Download::load_custom() {
+  torrent::Object* root = bencode();
+
+  if (!root->has_key_map("rtorrent") || !root->get_key("rtorrent").has_key_map("custom")) {
+    m_custom.load(torrent::Object());
+    return;
+  }
+
+  m_custom.load(root->get_key("rtorrent").get_key("custom"));
+}
+
+void
+Download::set_custom(CustomAttributes::key_type key, const torrent::Object& value) {
+  bencode()->get_key("rtorrent").
+             insert_preserve_copy("custom", torrent::Object::create_map()).first->second.
+             insert_key(CustomAttributes::key_name(key), value);
+
+  m_custom.set(key, value);
+  m_changed = true;
+}
+
+void
+Download::set_message(const std::string& msg) {
+  if (m_message == msg)
+    return;
+
+  m_message = msg;
+  m_changed = true;
 }
 
 uint32_t
@@ -73,9 +105,58 @@ Download::connection_list_size() const {
 void
 Download::receive_tracker_msg(std::string msg) {
   if (msg.empty())
-    m_message = "";
+    set_message("");
   else
-    m_message = "Tracker: [" + msg + "]";
+    set_message("Tracker: [" + msg + "]");
+}
+
+bool
+Download::change_state::operator == (const change_state& rhs) const {
+  return
+    flags == rhs.flags && completed_chunks == rhs.completed_chunks && connections == rhs.connections &&
+    up_total == rhs.up_total && down_total == rhs.down_total && up_rate == rhs.up_rate && down_rate == rhs.down_rate;
+}
+
+// Gives the download a new change sequence if it was explicitly marked
+// as changed or any of the values shown in a typical download list
+// differ from the last update.
+bool
+Download::update_changed(uint64_t sequence) {
+  change_state state;
+
+  state.flags =
+    (is_open()          << 0) |
+    (is_active()        << 1) |
+    (is_done()          << 2) |
+    (is_hash_checking() << 3) |
+    (is_hash_checked()  << 4) |
+    (m_hashFailed       << 5);
+
+  state.completed_chunks = m_download.file_list()->completed_chunks();
+  state.connections      = m_download.connection_list()->size();
+  state.up_total         = m_download.info()->up_rate()->total();
+  state.down_total       = m_download.info()->down_rate()->total();
+  state.up_rate          = m_download.info()->up_rate()->rate();
+  state.down_rate        = m_download.info()->down_rate()->rate();
+
+  if (!m_changed && state == m_changeState)
+    return false;
+
+  m_changed        = false;
+  m_changeSequence = sequence;
+  m_changeState    = state;
+  return true;
+}
+
+int64_t
+Download::ratio() const {
+  if (is_hash_checking())
+    return 0;
+
+  int64_t bytesDone = m_download.bytes_done();
+  int64_t upTotal   = info()->up_rate()->total();
+
+  return bytesDone > 0 ? (1000 * upTotal) / bytesDone : 0;
 }
 
 float
@@ -112,6 +193,7 @@ Download::set_throttle_name(const std::string& throttleName) {
   m_download.set_download_throttle(throttles.second);
 
   m_download.bencode()->get_key("rtorrent").insert_key("throttle_name", throttleName);
+  m_changed = true;
 }
 
 void
@@ -143,6 +225,7 @@ Download::set_root_directory(const std::string& path) {
   file_list->set_root_dir(rak::path_expand(path));
 
   bencode()->get_key("rtorrent").insert_key("directory", path);
+  m_changed = true;
 }
 
 }
@@ -9,6 +9,7 @@
 #include <torrent/peer/connection_list.h>
 #include <torrent/tracker/wrappers.h>
 
+#include "core/custom_attributes.h"
 #include "globals.h"
 
 namespace core {
@@ -68,7 +69,7 @@ public:
   uint32_t            connection_list_size() const;
 
   const std::string&  message() const                          { return m_message; }
-  void                set_message(const std::string& msg)      { m_message = msg; }
+  void                set_message(const std::string& msg);
 
   void                enable_udp_trackers(bool state);
 
@@ -86,10 +87,32 @@ public:
 
   float               distributed_copies() const;
 
+  // Uploaded per thousand bytes done, zero while hash checking. Used
+  // by 'd.ratio'.
+  int64_t             ratio() const;
+
+  // Typed copy of the "rtorrent/custom" map, loaded when the download
+  // is inserted. Use DownloadList::set_custom() so the custom indexes
+  // are updated.
+  const CustomAttributes& custom() const                       { return m_custom; }
+
+  void                load_custom();
+  void                set_custom(CustomAttributes::key_type key, const torrent::Object& value);
+
   // HACK: Choke group setting.
   unsigned int        group() const { return m_group; }
   void                set_group(unsigned int g) { m_group = g; }
 
+  // Change tracking for pollers, see DownloadList::update_changes().
+  //
+  // Commands that modify the download's persistent variables call
+  // 'set_changed', while transfer progress and state are compared
+  // against the values seen on the last update.
+  uint64_t            change_sequence() const                  { return m_changeSequence; }
+
+  void                set_changed()                            { m_changed = true; }
+  bool                update_changed(uint64_t sequence);
+
 private:
   Download(const Download&);
   void operator () (const Download&);
@@ -104,6 +127,24 @@ private:
   std::string         m_message;
   uint32_t            m_resumeFlags{~uint32_t{}};
   unsigned int        m_group{};
+
+  CustomAttributes    m_custom;
+
+  struct change_state {
+    bool operator == (const change_state& rhs) const;
+
+    int      flags{};
+    uint32_t completed_chunks{};
+    uint32_t connections{};
+    uint64_t up_total{};
+    uint64_t down_total{};
+    uint64_t up_rate{};
+    uint64_t down_rate{};
+  };
+
+  bool                m_changed{true};
+  uint64_t            m_changeSequence{};
+  change_state        m_changeState;
 };
 
 inline bool
@@ -3,6 +3,7 @@
 #include <algorithm>
 #include <fstream>
 #include <iostream>
+#include <iterator>
 #include <rak/string_manip.h>
 #include <torrent/data/file.h>
 #include <torrent/utils/resume.h>
@@ -15,6 +16,7 @@
 #include <torrent/utils/log.h>
 
 #include "rpc/parse_commands.h"
+#include "rpc/subscription_manager.h"
 
 #include "control.h"
 #include "globals.h"
@@ -28,11 +30,24 @@
 #include "session/session_manager.h"
 #include "ui/root.h"
 
-#define DL_TRIGGER_EVENT(download, event_name) \
-  rpc::commands.call_catch(event_name, rpc::make_target(download), torrent::Object(), "Event '" event_name "' failed: ");
+// Subscribers are queued the event first, the handlers may erase the
+// download.
+#define DL_TRIGGER_EVENT(download, event_name)                                                                              \
+  do {                                                                                                                      \
+    rpc::subscriptions.push(event_name, download);                                                                          \
+    rpc::commands.call_catch(event_name, rpc::make_target(download), torrent::Object(), "Event '" event_name "' failed: "); \
+  } while (0)
 
 namespace core {
 
+// Called on every state change of a download, bound once rather than
+// looked up on each call.
+static rpc::CommandHandle cmd_d_complete(&rpc::commands, "d.complete");
+static rpc::CommandHandle cmd_d_hashing(&rpc::commands, "d.hashing");
+static rpc::CommandHandle cmd_d_state(&rpc::commands, "d.state");
+static rpc::CommandHandle cmd_d_state_counter(&rpc::commands, "d.state_counter");
+static rpc::CommandHandle cmd_d_state_counter_set(&rpc::commands, "d.state_counter.set");
+
 inline void
 DownloadList::check_contains([[maybe_unused]] Download* d) {
 #ifdef USE_EXTRA_DEBUG
@@ -50,6 +65,8 @@ DownloadList::clear() {
 
     try {
       close(download);
+      m_hashIndex.erase(download->info()->hash(), std::prev(end()));
+      m_customIndex.erase(download, download->custom());
       base_type::pop_back();
 
       torrent::download_remove(*download->download());
@@ -77,7 +94,7 @@ DownloadList::session_save() {
 
 DownloadList::iterator
 DownloadList::find(const torrent::HashString& hash) {
-  return std::find_if(begin(), end(), [hash](Download* d) { return hash == d->info()->hash(); });
+  return m_hashIndex.find(hash, end());
 }
 
 DownloadList::iterator
@@ -87,7 +104,7 @@ DownloadList::find_hex(const char* hash) {
   for (torrent::HashString::iterator itr = key.begin(), last = key.end(); itr != last; itr++, hash += 2)
     *itr = (rak::hexchar_to_value(*hash) << 4) + rak::hexchar_to_value(*(hash + 1));
 
-  return std::find_if(begin(), end(), [key](Download* d) { return key == d->info()->hash(); });
+  return find(key);
 }
 
 Download*
@@ -157,6 +174,13 @@ DownloadList::iterator
 DownloadList::insert(Download* download) {
   iterator itr = base_type::insert(end(), download);
 
+  m_hashIndex.insert(download->info()->hash(), itr);
+
+  // The session's attributes are in the bencode by now, and the views
+  // below may filter on them.
+  download->load_custom();
+  m_customIndex.insert(download, download->custom());
+
   lt_log_print_info(torrent::LOG_TORRENT_INFO, download->info(), "download_list", "Inserting download.");
 
   try {
@@ -183,7 +207,9 @@ DownloadList::insert(Download* download) {
 
 void
 DownloadList::erase_ptr(Download* download) {
-  erase(std::find(begin(), end(), download));
+  iterator itr = find(download->info()->hash());
+
+  erase(itr != end() && *itr == download ? itr : end());
 }
 
 DownloadList::iterator
@@ -204,12 +230,56 @@ DownloadList::erase(iterator itr) {
   for (auto v : *control->view_manager())
     v->erase(*itr);
 
+  m_hashIndex.erase((*itr)->info()->hash(), itr);
+  m_customIndex.erase(*itr, (*itr)->custom());
+
   torrent::download_remove(*(*itr)->download());
   delete *itr;
 
   return base_type::erase(itr);
 }
 
+void
+DownloadList::set_custom(Download* download, const std::string& key, const torrent::Object& value) {
+  CustomAttributes::key_type id = CustomAttributes::key(key);
+
+  // Downloads are indexed once inserted.
+  iterator itr     = find(download->info()->hash());
+  bool     indexed = itr != end() && *itr == download;
+
+  if (indexed)
+    m_customIndex.erase(download, download->custom(), id);
+
+  download->set_custom(id, value);
+
+  if (indexed)
+    m_customIndex.insert(download, download->custom(), id);
+}
+
+void
+DownloadList::insert_custom_index(const std::string& key) {
+  CustomAttributes::key_type id = CustomAttributes::key(key);
+
+  if (m_customIndex.is_indexed(id))
+    return;
+
+  m_customIndex.insert_key(id);
+
+  for (auto download : *this)
+    m_customIndex.insert(download, download->custom(), id);
+}
+
+uint64_t
+DownloadList::update_changes() {
+  uint64_t sequence = m_changeSequence + 1;
+
+  for (auto download : *this)
+    if (download->update_changed(sequence))
+      m_changeSequence = sequence;
+
+  return m_changeSequence;
+}
+
 bool
 DownloadList::open(Download* download) {
   try {
@@ -305,7 +375,7 @@ DownloadList::close_throw(Download* download) {
 
   download->download()->close();
 
-  if (!download->is_hash_failed() && rpc::call_command_value("d.hashing", rpc::make_target(download)) != Download::variable_hashing_stopped)
+  if (!download->is_hash_failed() && rpc::call_command_value(cmd_d_hashing, rpc::make_target(download)) != Download::variable_hashing_stopped)
     throw torrent::internal_error("DownloadList::close_throw(...) called but we're going into a hashing loop.");
 
   DL_TRIGGER_EVENT(download, "event.download.hash_removed");
@@ -341,7 +411,7 @@ DownloadList::resume(Download* download, int flags) {
       if (download->is_hash_failed())
         return;
 
-      if (rpc::call_command_value("d.hashing", rpc::make_target(download)) == Download::variable_hashing_stopped)
+      if (rpc::call_command_value(cmd_d_hashing, rpc::make_target(download)) == Download::variable_hashing_stopped)
         rpc::call_command("d.hashing.set", Download::variable_hashing_initial, rpc::make_target(download));
 
       DL_TRIGGER_EVENT(download, "event.download.hash_queued");
@@ -354,7 +424,7 @@ DownloadList::resume(Download* download, int flags) {
     auto cached_seconds = torrent::this_thread::cached_seconds().count();
 
     rpc::call_command("d.state_changed.set", cached_seconds, rpc::make_target(download));
-    rpc::call_command("d.state_counter.set", rpc::call_command_value("d.state_counter", rpc::make_target(download)) + 1, rpc::make_target(download));
+    rpc::call_command(cmd_d_state_counter_set, rpc::call_command_value(cmd_d_state_counter, rpc::make_target(download)) + 1, rpc::make_target(download));
 
     if (download->is_done()) {
       torrent::Object conn_current = rpc::call_command("d.connection_seed", torrent::Object(), rpc::make_target(download));
@@ -423,7 +493,7 @@ DownloadList::pause(Download* download, int flags) {
 
     // Always clear hashing on pause. When a hashing request is added,
     // it should have cleared the hash resume data.
-    if (rpc::call_command_value("d.hashing", rpc::make_target(download)) != Download::variable_hashing_stopped) {
+    if (rpc::call_command_value(cmd_d_hashing, rpc::make_target(download)) != Download::variable_hashing_stopped) {
       download->download()->hash_stop();
       rpc::call_command_set_value("d.hashing.set", Download::variable_hashing_stopped, rpc::make_target(download));
 
@@ -444,7 +514,7 @@ DownloadList::pause(Download* download, int flags) {
     auto cached_seconds = torrent::this_thread::cached_seconds().count();
 
     rpc::call_command("d.state_changed.set", cached_seconds, rpc::make_target(download));
-    rpc::call_command("d.state_counter.set", rpc::call_command_value("d.state_counter", rpc::make_target(download)), rpc::make_target(download));
+    rpc::call_command(cmd_d_state_counter_set, rpc::call_command_value(cmd_d_state_counter, rpc::make_target(download)), rpc::make_target(download));
 
     // If initial seeding is complete, don't try it again when restarting.
     if (download->is_done() &&
@@ -467,7 +537,7 @@ DownloadList::check_hash(Download* download) {
   lt_log_print_info(torrent::LOG_TORRENT_INFO, download->info(), "download_list", "Checking hash.");
 
   try {
-    if (rpc::call_command_value("d.hashing", rpc::make_target(download)) != Download::variable_hashing_stopped)
+    if (rpc::call_command_value(cmd_d_hashing, rpc::make_target(download)) != Download::variable_hashing_stopped)
       return;
 
     hash_queue(download, Download::variable_hashing_rehash);
@@ -502,7 +572,7 @@ DownloadList::hash_done(Download* download) {
   // confirm all the data, avoiding large BW usage on f.ex. the
   // ReiserFS bug with >4GB files.
 
-  int64_t hashing = rpc::call_command_value("d.hashing", rpc::make_target(download));
+  int64_t hashing = rpc::call_command_value(cmd_d_hashing, rpc::make_target(download));
   rpc::call_command_set_value("d.hashing.set", Download::variable_hashing_stopped, rpc::make_target(download));
 
   if (download->is_done() && download->download()->info()->is_meta_download())
@@ -515,7 +585,7 @@ DownloadList::hash_done(Download* download) {
 
     // If the download was previously completed but the files were
     // f.ex deleted, then we clear the state and complete.
-    if (rpc::call_command_value("d.complete", rpc::make_target(download)) && !download->is_done()) {
+    if (rpc::call_command_value(cmd_d_complete, rpc::make_target(download)) && !download->is_done()) {
       rpc::call_command("d.state.set", (int64_t)0, rpc::make_target(download));
       download->set_message("Download registered as completed, but hash check returned unfinished chunks.");
     }
@@ -525,7 +595,7 @@ DownloadList::hash_done(Download* download) {
     rpc::call_command("d.complete.set", (int64_t)download->is_done(), rpc::make_target(download));
     torrent::resume_save_progress(*download->download(), download->download()->bencode()->get_key("libtorrent_resume"));
 
-    if (rpc::call_command_value("d.state", rpc::make_target(download)) == 1)
+    if (rpc::call_command_value(cmd_d_state, rpc::make_target(download)) == 1)
       resume(download, download->resume_flags());
 
     break;
@@ -559,7 +629,7 @@ DownloadList::hash_queue(Download* download, int type) {
 
   lt_log_print_info(torrent::LOG_TORRENT_INFO, download->info(), "download_list", "Hash queue.");
 
-  if (rpc::call_command_value("d.hashing", rpc::make_target(download)) != Download::variable_hashing_stopped)
+  if (rpc::call_command_value(cmd_d_hashing, rpc::make_target(download)) != Download::variable_hashing_stopped)
     throw torrent::internal_error("DownloadList::hash_queue(...) hashing already queued.");
 
   // HACK
@@ -665,7 +735,7 @@ DownloadList::confirm_finished(Download* download) {
   // being hashed.
   download->set_resume_flags(~uint32_t());
 
-  if (!download->is_active() && rpc::call_command_value("d.state", rpc::make_target(download)) == 1)
+  if (!download->is_active() && rpc::call_command_value(cmd_d_state, rpc::make_target(download)) == 1)
     resume(download,
            torrent::Download::start_no_create |
            torrent::Download::start_skip_tracker |
@@ -1,12 +1,18 @@
 #ifndef RTORRENT_CORE_DOWNLOAD_LIST_H
 #define RTORRENT_CORE_DOWNLOAD_LIST_H
 
+#include <cstdint>
 #include <iosfwd>
 #include <list>
 #include <string>
+#include <utility>
+#include <vector>
+#include <torrent/hash_string.h>
+
+#include "core/custom_attributes.h"
+#include "core/hash_index.h"
 
 namespace torrent {
-  class HashString;
   class Object;
 }
 
@@ -45,6 +51,7 @@ public:
 
   void                session_save();
 
+  // Hash lookups use an index kept in sync by insert and erase.
   iterator            find(const torrent::HashString& hash);
 
   iterator            find_hex(const char* hash);
@@ -77,6 +84,27 @@ public:
 
   void                check_hash(Download* d);
 
+  // Sets a custom attribute of the download and keeps the custom
+  // indexes in sync, see CustomAttributes.
+  void                set_custom(Download* d, const std::string& key, const torrent::Object& value);
+
+  const CustomIndex&  custom_index() const { return m_customIndex; }
+
+  // Indexes the attribute for all downloads, and those inserted later.
+  void                insert_custom_index(const std::string& key);
+
+  // Changes are numbered by a sequence that increases on each update,
+  // and every download keeps the sequence of its last change. Pollers
+  // pass the last sequence they have seen to get only what changed.
+  uint64_t            change_sequence() const { return m_changeSequence; }
+
+  // Checks all downloads for changes and returns the current sequence.
+  uint64_t            update_changes();
+
+  // Numbers a change that isn't to a download's own state, such as a
+  // view's membership, see View::visible_sequence().
+  uint64_t            next_change_sequence() { return ++m_changeSequence; }
+
   enum {
     D_SLOTS_INSERT,
     D_SLOTS_ERASE,
@@ -129,6 +157,12 @@ private:
   void                confirm_finished(Download* d);
 
   void                process_meta_download(Download* d);
+
+  HashIndex<iterator>                          m_hashIndex;
+
+  CustomIndex                                  m_customIndex;
+
+  uint64_t                                     m_changeSequence{};
 };
 
 }
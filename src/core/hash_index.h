@@ -0,0 +1,61 @@
+#ifndef RTORRENT_CORE_HASH_INDEX_H
+#define RTORRENT_CORE_HASH_INDEX_H
+
+#include <cstring>
+#include <unordered_map>
+#include <torrent/hash_string.h>
+
+namespace core {
+
+// Maps info hashes to iterators of a list, which stay valid until
+// the element is erased.
+template <typename Iterator>
+class HashIndex {
+public:
+  size_t              size() const  { return m_map.size(); }
+  bool                empty() const { return m_map.empty(); }
+
+  void                insert(const torrent::HashString& hash, Iterator itr) { m_map[hash] = itr; }
+
+  // Only removes the entry if it points to 'itr', so erasing an element
+  // whose hash is also used by a newer one keeps the latter indexed.
+  void                erase(const torrent::HashString& hash, Iterator itr);
+
+  Iterator            find(const torrent::HashString& hash, Iterator end) const;
+
+  void                clear() { m_map.clear(); }
+
+private:
+  // Info hashes are uniformly distributed, so the first bytes are
+  // good enough as the hash.
+  struct hash_string_hash {
+    size_t operator()(const torrent::HashString& hash) const {
+      size_t result;
+      std::memcpy(&result, hash.data(), sizeof(result));
+      return result;
+    }
+  };
+
+  std::unordered_map<torrent::HashString, Iterator, hash_string_hash> m_map;
+};
+
+template <typename Iterator>
+inline void
+HashIndex<Iterator>::erase(const torrent::HashString& hash, Iterator itr) {
+  auto entry = m_map.find(hash);
+
+  if (entry != m_map.end() && entry->second == itr)
+    m_map.erase(entry);
+}
+
+template <typename Iterator>
+inline Iterator
+HashIndex<Iterator>::find(const torrent::HashString& hash, Iterator end) const {
+  auto entry = m_map.find(hash);
+
+  return entry != m_map.end() ? entry->second : end;
+}
+
+}
+
+#endif
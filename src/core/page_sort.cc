@@ -0,0 +1,49 @@
+#include "config.h"
+
+#include "core/page_sort.h"
+
+#include <algorithm>
+
+namespace core {
+
+std::vector<uint32_t>
+page_sort(const std::vector<torrent::Object>& keys, const std::vector<bool>& descending, size_t size, uint64_t offset, uint64_t limit) {
+  size_t key_count = descending.size();
+  size_t first     = std::min<uint64_t>(offset, size);
+  size_t last      = first + std::min<uint64_t>(limit, size - first);
+
+  std::vector<uint32_t> indices(size);
+
+  for (uint32_t index = 0; index != size; index++)
+    indices[index] = index;
+
+  auto compare = [&keys, &descending, key_count](uint32_t lhs, uint32_t rhs) {
+      for (size_t k = 0; k != key_count; k++) {
+        const torrent::Object& key1 = keys[lhs * key_count + k];
+        const torrent::Object& key2 = keys[rhs * key_count + k];
+
+        int result;
+
+        if (key1.is_value())
+          result = key1.as_value() < key2.as_value() ? -1 : key1.as_value() != key2.as_value();
+        else
+          result = key1.as_string().compare(key2.as_string());
+
+        if (result != 0)
+          return descending[k] ? result > 0 : result < 0;
+      }
+
+      return lhs < rhs;
+    };
+
+  if (first != last) {
+    if (first != 0)
+      std::nth_element(indices.begin(), indices.begin() + first, indices.end(), compare);
+
+    std::partial_sort(indices.begin() + first, indices.begin() + last, indices.end(), compare);
+  }
+
+  return std::vector<uint32_t>(indices.begin() + first, indices.begin() + last);
+}
+
+}
@@ -0,0 +1,25 @@
+// Sorting of a page of downloads for 'd.multicall.paged'.
+
+#ifndef RTORRENT_CORE_PAGE_SORT_H
+#define RTORRENT_CORE_PAGE_SORT_H
+
+#include <cstdint>
+#include <vector>
+#include <torrent/object.h>
+
+namespace core {
+
+// The sort keys of 'size' downloads are stored flat in 'keys',
+// 'descending.size()' entries for each download in view order. Keys
+// in the same column must all be values or all be strings.
+//
+// Returns the indices of the downloads in positions [offset, offset +
+// limit) of the sorted order, clamped to 'size'. Downloads with equal
+// keys keep their view order.
+std::vector<uint32_t> page_sort(const std::vector<torrent::Object>& keys,
+                                const std::vector<bool>& descending,
+                                size_t size, uint64_t offset, uint64_t limit);
+
+}
+
+#endif
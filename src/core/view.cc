@@ -1,9 +1,16 @@
 #include "config.h"
 
 #include <algorithm>
+#include <exception>
 #include <functional>
+#include <iterator>
+#include <numeric>
+#include <system_error>
+#include <thread>
+#include <rak/string_manip.h>
 #include <torrent/download.h>
 #include <torrent/exceptions.h>
+#include <torrent/hash_string.h>
 
 #include "control.h"
 #include "download.h"
@@ -11,13 +18,14 @@
 #include "manager.h"
 #include "rpc/object_storage.h"
 #include "rpc/parse_commands.h"
+#include "rpc/subscription_manager.h"
 #include "view.h"
 
 namespace core {
 
 // Also add focus thingie here?
 struct view_downloads_compare {
-  view_downloads_compare(const torrent::Object& cmd) :
+  view_downloads_compare(const ViewExpression& cmd) :
       m_command(cmd) {}
 
   bool operator()(Download* d1, Download* d2) const {
@@ -25,20 +33,7 @@ struct view_downloads_compare {
       if (m_command.is_empty())
         return false;
 
-      if (!m_command.is_dict_key())
-        return rpc::parse_command_single(rpc::make_target_pair(d1, d2), m_command.as_string()).as_value();
-
-      // torrent::Object tmp_command = m_command;
-
-      // uint32_t flags = tmp_command.flags() & torrent::Object::mask_function;
-      // tmp_command.unset_flags(torrent::Object::mask_function);
-      // tmp_command.set_flags((flags >> 1) & torrent::Object::mask_function);
-
-      // rpc::parse_command_execute(rpc::make_target_pair(d1, d2), &tmp_command);
-      // return rpc::commands.call_command(tmp_command.as_dict_key().c_str(), tmp_command.as_dict_obj(),
-      //                                   rpc::make_target_pair(d1, d2)).as_value();
-
-      return rpc::commands.call_command(m_command.as_dict_key().c_str(), m_command.as_dict_obj(), rpc::make_target_pair(d1, d2)).as_value();
+      return m_command.call(rpc::make_target_pair(d1, d2)).as_value();
 
     } catch (torrent::input_error& e) {
       control->core()->push_log(e.what());
@@ -47,40 +42,80 @@ struct view_downloads_compare {
     }
   }
 
-  const torrent::Object& m_command;
+  const ViewExpression& m_command;
 };
 
-struct view_downloads_filter {
-  view_downloads_filter(const torrent::Object& cmd, const torrent::Object& cmd2) :
-      m_command(cmd), m_command2(cmd2) {}
+static bool
+view_downloads_key_less(const ViewExpression& cmd, const ViewExpression::sort_key* k1, Download* d1, const ViewExpression::sort_key* k2, Download* d2) {
+  try {
+    return cmd.sort_keys_less(k1, k2, rpc::make_target_pair(d1, d2));
 
-  bool operator()(Download* d1) const {
-    return this->evalCmd(m_command, d1) && this->evalCmd(m_command2, d1);
+  } catch (torrent::input_error& e) {
+    control->core()->push_log(e.what());
+
+    return false;
   }
+}
 
-  bool evalCmd(const torrent::Object& cmd, Download* d1) const {
-    if (cmd.is_empty())
-      return true;
+// Compares downloads by index into a flat array of their sort keys,
+// with 'stride' keys per download.
+struct view_downloads_key_compare {
+  view_downloads_key_compare(const ViewExpression& cmd, const View::base_type& downloads, const std::vector<ViewExpression::sort_key>& keys, size_t stride) :
+      m_command(cmd), m_downloads(downloads), m_keys(keys), m_stride(stride) {}
 
-    try {
-      torrent::Object result;
+  bool operator()(size_t i1, size_t i2) const {
+    return view_downloads_key_less(m_command, &m_keys[i1 * m_stride], m_downloads[i1], &m_keys[i2 * m_stride], m_downloads[i2]);
+  }
 
-      if (cmd.is_dict_key()) {
-        // torrent::Object tmp_command = cmd;
+  const ViewExpression&                       m_command;
+  const View::base_type&                      m_downloads;
+  const std::vector<ViewExpression::sort_key>& m_keys;
+  size_t                                      m_stride;
+};
 
-        // uint32_t flags = tmp_command.flags() & torrent::Object::mask_function;
-        // tmp_command.unset_flags(torrent::Object::mask_function);
-        // tmp_command.set_flags((flags >> 1) & torrent::Object::mask_function);
+// The downloads matching a filter on an indexed custom attribute, or
+// NULL if the filter has to be called.
+static const CustomIndex::download_set*
+view_custom_set(const ViewExpression& cmd) {
+  if (!cmd.is_custom_equal())
+    return NULL;
 
-        // rpc::parse_command_execute(rpc::make_target(d1), &tmp_command);
-        // result = rpc::commands.call_command(tmp_command.as_dict_key().c_str(), tmp_command.as_dict_obj(),
-        //                                     rpc::make_target(d1));
+  return control->core()->download_list()->custom_index().find(cmd.custom_key(), cmd.custom_value());
+}
 
-        result = rpc::commands.call_command(cmd.as_dict_key().c_str(), cmd.as_dict_obj(), rpc::make_target(d1));
+// The sets are only used if the other expression is pure, as anything
+// else may call 'd.custom.set' during the pass, changing or freeing
+// the set.
+struct view_downloads_filter {
+  view_downloads_filter(const ViewExpression& cmd, const ViewExpression& cmd2) :
+      m_command(cmd),
+      m_command2(cmd2),
+      m_set(cmd2.is_pure() ? view_custom_set(cmd) : NULL),
+      m_set2(cmd.is_pure() ? view_custom_set(cmd2) : NULL) {}
 
-      } else {
-        result = rpc::parse_command_single(rpc::make_target(d1), cmd.as_string());
-      }
+  bool operator()(Download* d1) const {
+    return test(d1, NULL);
+  }
+
+  // Errors are added to 'errors' instead of the log if not NULL, as
+  // the log must only be used from the main thread.
+  bool test(Download* d1, std::vector<std::string>* errors) const {
+    return this->evalCmd(m_command, m_set, d1, errors) && this->evalCmd(m_command2, m_set2, d1, errors);
+  }
+
+  bool is_pure() const {
+    return m_command.is_pure() && m_command2.is_pure();
+  }
+
+  bool evalCmd(const ViewExpression& cmd, const CustomIndex::download_set* set, Download* d1, std::vector<std::string>* errors) const {
+    if (cmd.is_empty())
+      return true;
+
+    if (set != NULL)
+      return set->find(d1) != set->end();
+
+    try {
+      torrent::Object result = cmd.call(rpc::make_target(d1));
 
       switch (result.type()) {
         //      case torrent::Object::TYPE_RAW_BENCODE: return !result.as_raw_bencode().empty();
@@ -96,21 +131,80 @@ struct view_downloads_filter {
         return false;
       }
 
-      // The default filter action is to return true, to not filter
-      // the download out.
-      return true;
-
     } catch (torrent::input_error& e) {
-      control->core()->push_log(e.what());
+      if (errors != NULL)
+        errors->push_back(e.what());
+      else
+        control->core()->push_log(e.what());
 
       return false;
     }
   }
 
-  const torrent::Object& m_command;
-  const torrent::Object& m_command2;
+  const ViewExpression&            m_command;
+  const ViewExpression&            m_command2;
+  const CustomIndex::download_set* m_set;
+  const CustomIndex::download_set* m_set2;
 };
 
+// Filters with pure expressions are tested on several threads once
+// there are at least two chunks of this many downloads.
+static const size_t view_parallel_chunk = 2048;
+
+static bool
+view_is_parallel(const view_downloads_filter& matches, size_t size) {
+  return matches.is_pure() && size >= 2 * view_parallel_chunk && std::thread::hardware_concurrency() > 1;
+}
+
+// Tests the downloads in contiguous chunks, one per thread with the
+// calling thread taking the first chunk, and waits for all of them.
+// Errors are logged afterwards in the order of the downloads.
+static std::vector<char>
+view_filter_parallel(const view_downloads_filter& matches, const View::base_type& downloads) {
+  size_t threads = std::min<size_t>(std::thread::hardware_concurrency(), downloads.size() / view_parallel_chunk);
+
+  std::vector<char>                     results(downloads.size());
+  std::vector<std::vector<std::string>> errors(std::max<size_t>(threads, 1));
+  std::vector<std::exception_ptr>       failures(errors.size());
+
+  auto test_chunk = [&](size_t chunk) {
+      size_t first = downloads.size() * chunk / errors.size();
+      size_t last  = downloads.size() * (chunk + 1) / errors.size();
+
+      try {
+        for (size_t i = first; i != last; i++)
+          results[i] = matches.test(downloads[i], &errors[chunk]);
+
+      } catch (...) {
+        failures[chunk] = std::current_exception();
+      }
+    };
+
+  std::vector<std::thread> workers;
+
+  for (size_t chunk = 1; chunk < errors.size(); chunk++) {
+    try {
+      workers.emplace_back(test_chunk, chunk);
+    } catch (std::system_error& e) {
+      test_chunk(chunk);
+    }
+  }
+
+  test_chunk(0);
+
+  std::for_each(workers.begin(), workers.end(), std::mem_fn(&std::thread::join));
+
+  for (size_t chunk = 0; chunk != errors.size(); chunk++) {
+    for (const auto& error : errors[chunk])
+      control->core()->push_log(error.c_str());
+
+    if (failures[chunk])
+      std::rethrow_exception(failures[chunk]);
+  }
+
+  return results;
+}
+
 void
 View::emit_changed() {
   torrent::this_thread::scheduler()->update_wait_for(&m_delay_changed, 0ms);
@@ -141,58 +235,79 @@ View::initialize(const std::string& name) {
   m_name = name;
 
   // Urgh, wrong. No filtering being done.
-  for (const auto& d : *control->core()->download_list())
+  for (const auto& d : *control->core()->download_list()) {
     push_back(d);
+    m_index[d] = base_type::size() - 1;
+  }
+
+  m_size        = base_type::size();
+  m_focus       = 0;
+  m_index_valid = m_size;
 
-  m_size  = base_type::size();
-  m_focus = 0;
+  // Pollers with an older sequence didn't see this view.
+  m_left_trimmed = control->core()->download_list()->change_sequence();
 
   m_delay_changed.slot() = [this]() { emit_changed_now(); };
 }
 
 void
 View::erase(Download* download) {
-  iterator itr = std::find(base_type::begin(), base_type::end(), download);
+  iterator itr = find_internal(download);
 
-  if (itr >= end_visible()) {
-    erase_internal(itr);
+  if (itr == end_filtered())
+    throw torrent::internal_error("View::erase(...) could not find download.");
 
-  } else {
-    erase_internal(itr);
+  bool visible = itr < end_visible();
+
+  if (visible)
+    changed_visible(download, false, control->core()->download_list()->next_change_sequence());
+
+  m_index.erase(download);
+  m_visible_sequence.erase(download);
+  erase_internal(itr);
+
+  if (visible) {
+    rpc::subscriptions.push("view.event_removed", download, m_name);
     rpc::call_object_nothrow(m_event_removed, rpc::make_target(download));
   }
 }
 
 void
 View::set_visible(Download* download) {
-  iterator itr = std::find(begin_filtered(), end_filtered(), download);
+  iterator itr = find_internal(download);
 
-  if (itr == end_filtered())
+  if (itr < end_visible() || itr == end_filtered())
     return;
 
   // Don't optimize erase since we want to keep the order of the
   // non-visible elements.
-  base_type::erase(itr);
+  erase_internal(itr);
   insert_visible(download);
+  changed_visible(download, true, control->core()->download_list()->next_change_sequence());
 
+  m_filter_full = true;
+
+  rpc::subscriptions.push("view.event_added", download, m_name);
   rpc::call_object_nothrow(m_event_added, rpc::make_target(download));
 }
 
 void
 View::set_not_visible(Download* download) {
-  iterator itr = std::find(begin_visible(), end_visible(), download);
+  iterator itr = find_internal(download);
 
-  if (itr == end_visible())
+  if (itr >= end_visible())
     return;
 
-  m_size--;
-  m_focus -= (m_focus > position(itr));
+  m_filter_full = true;
 
   // Don't optimize erase since we want to keep the order of the
   // non-visible elements.
-  base_type::erase(itr);
+  erase_internal(itr);
   base_type::push_back(download);
+  m_index[download] = base_type::size() - 1;
+  changed_visible(download, false, control->core()->download_list()->next_change_sequence());
 
+  rpc::subscriptions.push("view.event_removed", download, m_name);
   rpc::call_object_nothrow(m_event_removed, rpc::make_target(download));
 }
 
@@ -243,10 +358,32 @@ void
 View::sort() {
   Download* curFocus = focus() != end_visible() ? *focus() : NULL;
 
-  // Don't go randomly switching around equivalent elements.
-  std::stable_sort(begin(), end_visible(), view_downloads_compare(m_sortCurrent));
+  size_t    stride   = m_sortCurrent.sort_key_size();
 
-  m_focus = position(std::find(begin(), end_visible(), curFocus));
+  if (stride == 0) {
+    // Don't go randomly switching around equivalent elements.
+    std::stable_sort(begin(), end_visible(), view_downloads_compare(m_sortCurrent));
+
+  } else {
+    // Evaluate the sort keys once per download, then sort the indices
+    // with the same stable sort so the order doesn't change.
+    base_type                             downloads(begin(), end_visible());
+    std::vector<ViewExpression::sort_key> keys(downloads.size() * stride);
+    std::vector<size_t>                   order(downloads.size());
+
+    for (size_t i = 0; i != downloads.size(); i++)
+      m_sortCurrent.sort_keys(rpc::make_target(downloads[i]), &keys[i * stride]);
+
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), view_downloads_key_compare(m_sortCurrent, downloads, keys, stride));
+
+    std::transform(order.begin(), order.end(), begin(), [&downloads](size_t i) { return downloads[i]; });
+  }
+
+  invalidate_index(0);
+  m_sorted = true;
+
+  m_focus = curFocus != NULL ? position(find_internal(curFocus)) : m_size;
   emit_changed();
 }
 
@@ -256,9 +393,57 @@ View::filter() {
   if (m_name == "started" || m_name == "stopped")
     return;
 
+  view_downloads_filter matches(m_filter, m_temp_filter);
+
+  bool     tracked = m_filter.is_tracked() && m_temp_filter.is_tracked();
+  bool     full    = !tracked || m_filter_full;
+  uint64_t since   = m_filter_sequence;
+
+  if (tracked)
+    m_filter_sequence = control->core()->download_list()->update_changes();
+
+  m_filter_full = false;
+
+  // Large views with pure filters test the downloads that need it up
+  // front on several threads, the partitions below then only look up
+  // the results.
+  bool                                parallel = false;
+  std::unordered_map<Download*, bool> tested;
+
+  if (view_is_parallel(matches, base_type::size())) {
+    base_type pending;
+    std::copy_if(begin(), end_filtered(), std::back_inserter(pending), [&](Download* d) { return full || d->change_sequence() > since; });
+
+    parallel = view_is_parallel(matches, pending.size());
+
+    if (parallel) {
+      std::vector<char> results = view_filter_parallel(matches, pending);
+
+      tested.reserve(pending.size());
+
+      for (size_t i = 0; i != pending.size(); i++)
+        tested[pending[i]] = results[i];
+    }
+  }
+
+  // Downloads that haven't changed keep their visibility, which gives
+  // the same partitions as testing them again. The index isn't
+  // touched until the partitions are done, so it has the positions
+  // from before them.
+  update_index();
+
+  size_type old_size = m_size;
+
+  auto predicate = [&](Download* d) {
+      if (!full && d->change_sequence() <= since)
+        return m_index[d] < old_size;
+
+      return parallel ? tested[d] : matches(d);
+    };
+
   // Parition the list in two steps so we know which elements changed.
-  iterator  splitVisible  = std::stable_partition(begin_visible(), end_visible(), view_downloads_filter(m_filter, m_temp_filter));
-  iterator  splitFiltered = std::stable_partition(begin_filtered(), end_filtered(), view_downloads_filter(m_filter, m_temp_filter));
+  iterator  splitVisible  = std::stable_partition(begin_visible(), end_visible(), predicate);
+  iterator  splitFiltered = std::stable_partition(begin_filtered(), end_filtered(), predicate);
 
   base_type changed(splitVisible, splitFiltered);
   iterator  splitChanged = changed.begin() + std::distance(splitVisible, end_visible());
@@ -266,6 +451,19 @@ View::filter() {
   m_size = std::distance(begin(), std::copy(splitChanged, changed.end(), splitVisible));
   std::copy(changed.begin(), splitChanged, begin_filtered());
 
+  invalidate_index(0);
+
+  // Newly visible downloads are appended after the sorted ones.
+  if (splitChanged != changed.end())
+    m_sorted = false;
+
+  if (!changed.empty()) {
+    uint64_t sequence = control->core()->download_list()->next_change_sequence();
+
+    std::for_each(changed.begin(), splitChanged, [this, sequence](Download* d) { changed_visible(d, false, sequence); });
+    std::for_each(splitChanged, changed.end(), [this, sequence](Download* d) { changed_visible(d, true, sequence); });
+  }
+
   // Fix this...
   m_focus = std::min(m_focus, m_size);
 
@@ -279,6 +477,11 @@ View::filter() {
   // done by using a base_type* member variable, and making sure we
   // set the elements to NULL as we trigger commands on them. Or
   // perhaps always clear them, thus not throwing anything.
+  if (!rpc::subscriptions.empty()) {
+    std::for_each(changed.begin(), splitChanged, [this](Download* d) { rpc::subscriptions.push("view.event_removed", d, m_name); });
+    std::for_each(splitChanged, changed.end(), [this](Download* d) { rpc::subscriptions.push("view.event_added", d, m_name); });
+  }
+
   if (!m_event_removed.is_empty())
     std::for_each(changed.begin(), splitChanged, std::bind(&rpc::call_object_d_nothrow, m_event_removed, std::placeholders::_1));
 
@@ -291,7 +494,19 @@ View::filter() {
 void
 View::filter_by(const torrent::Object& condition, View::base_type& result) {
   // std::copy_if(begin_visible(), end_visible(), result.begin(), view_downloads_filter(condition));
-  view_downloads_filter matches = view_downloads_filter(condition, m_temp_filter);
+  ViewExpression        expression(condition);
+  view_downloads_filter matches = view_downloads_filter(expression, m_temp_filter);
+
+  if (view_is_parallel(matches, size_visible())) {
+    base_type         downloads(begin_visible(), end_visible());
+    std::vector<char> results = view_filter_parallel(matches, downloads);
+
+    for (size_t i = 0; i != downloads.size(); i++)
+      if (results[i])
+        result.push_back(downloads[i]);
+
+    return;
+  }
 
   for (iterator itr = begin_visible(); itr != end_visible(); ++itr)
     if (matches(*itr))
@@ -300,16 +515,20 @@ View::filter_by(const torrent::Object& condition, View::base_type& result) {
 
 void
 View::filter_download(core::Download* download) {
-  iterator itr = std::find(base_type::begin(), base_type::end(), download);
-
-  if (itr == base_type::end())
+  if (m_index.find(download) == m_index.end())
     throw torrent::internal_error("View::filter_download(...) could not find download.");
 
-  if (view_downloads_filter(m_filter, m_temp_filter)(download)) {
-    if (itr >= end_visible()) {
+  bool     matches = view_downloads_filter(m_filter, m_temp_filter)(download);
+  iterator itr     = find_internal(download);
+  bool     visible = itr < end_visible();
+
+  if (matches) {
+    if (!visible) {
       erase_internal(itr);
       insert_visible(download);
+      changed_visible(download, true, control->core()->download_list()->next_change_sequence());
 
+      rpc::subscriptions.push("view.event_added", download, m_name);
       rpc::call_object_nothrow(m_event_added, rpc::make_target(download));
 
     } else {
@@ -322,18 +541,60 @@ View::filter_download(core::Download* download) {
     }
 
   } else {
-    if (itr >= end_visible())
+    if (!visible)
       return;
 
     erase_internal(itr);
     base_type::push_back(download);
+    m_index[download] = base_type::size() - 1;
+    changed_visible(download, false, control->core()->download_list()->next_change_sequence());
 
+    rpc::subscriptions.push("view.event_removed", download, m_name);
     rpc::call_object_nothrow(m_event_removed, rpc::make_target(download));
   }
 
   emit_changed();
 }
 
+uint64_t
+View::visible_sequence(Download* download) const {
+  auto itr = m_visible_sequence.find(download);
+
+  return itr != m_visible_sequence.end() ? itr->second : 0;
+}
+
+bool
+View::left_since(uint64_t sequence, std::vector<std::string>* hashes) const {
+  if (sequence < m_left_trimmed)
+    return false;
+
+  auto itr = std::upper_bound(m_left.begin(), m_left.end(), sequence, [](uint64_t seq, const auto& entry) {
+      return seq < entry.first;
+    });
+
+  for (; itr != m_left.end(); itr++)
+    hashes->push_back(itr->second);
+
+  return true;
+}
+
+void
+View::changed_visible(Download* d, bool visible, uint64_t sequence) {
+  m_visible_sequence[d] = sequence;
+
+  if (visible)
+    return;
+
+  const torrent::HashString& hash = d->info()->hash();
+
+  m_left.emplace_back(sequence, rak::transform_hex(hash.begin(), hash.end()));
+
+  if (m_left.size() > left_log_size) {
+    m_left_trimmed = m_left.front().first;
+    m_left.pop_front();
+  }
+}
+
 void
 View::set_filter_on_event(const std::string& event) {
   control->object_storage()->set_str_multi_key(event, "!view." + m_name, "view.filter_download=" + m_name);
@@ -344,14 +605,59 @@ View::clear_filter_on() {
   control->object_storage()->rlookup_clear("!view." + m_name);
 }
 
+// Compares the expressions as given, including the dict key syntax.
+static bool
+view_object_equal(const torrent::Object& obj1, const torrent::Object& obj2) {
+  if (obj1.type() != obj2.type())
+    return false;
+
+  if (obj1.is_dict_key())
+    return obj1.as_dict_key() == obj2.as_dict_key() && view_object_equal(obj1.as_dict_obj(), obj2.as_dict_obj());
+
+  if (obj1.is_list())
+    return std::equal(obj1.as_list().begin(), obj1.as_list().end(), obj2.as_list().begin(), obj2.as_list().end(), &view_object_equal);
+
+  return torrent::object_equal(obj1, obj2);
+}
+
+// Finds the first visible download that 'd' sorts before. The visible
+// downloads are only known to be sorted by 'sort_new' right after a
+// sort with the same 'sort_current', in which case a binary search
+// finds the same position as the linear one.
+//
+// Downloads whose sort keys changed since the sort are still where
+// the sort left them, as they would be for the linear search.
 inline void
 View::insert_visible(Download* d) {
-  auto itr = std::find_if(begin_visible(), end_visible(), [this, d](auto d2) { return view_downloads_compare(m_sortNew)(d, d2); });
+  iterator itr;
+  size_t   stride = m_sortNew.sort_key_size();
+
+  if (!m_sorted || !view_object_equal(m_sortNew.object(), m_sortCurrent.object())) {
+    view_downloads_compare compare(m_sortNew);
+
+    itr      = std::find_if(begin_visible(), end_visible(), [&compare, d](Download* d2) { return compare(d, d2); });
+    m_sorted = false;
+
+  } else if (stride == 0) {
+    view_downloads_compare compare(m_sortNew);
+
+    itr = std::partition_point(begin_visible(), end_visible(), [&compare, d](Download* d2) { return !compare(d, d2); });
+
+  } else {
+    std::vector<ViewExpression::sort_key> keys(2 * stride);
+    m_sortNew.sort_keys(rpc::make_target(d), &keys[0]);
+
+    itr = std::partition_point(begin_visible(), end_visible(), [this, &keys, stride, d](Download* d2) {
+        m_sortNew.sort_keys(rpc::make_target(d2), &keys[stride]);
+        return !view_downloads_key_less(m_sortNew, &keys[0], d, &keys[stride], d2);
+      });
+  }
 
   m_size++;
   m_focus += (m_focus >= position(itr));
 
-  base_type::insert(itr, d);
+  invalidate_index(position(itr));
+  m_index[d] = position(base_type::insert(itr, d));
 }
 
 inline void
@@ -362,7 +668,30 @@ View::erase_internal(iterator itr) {
   m_size -= (itr < end_visible());
   m_focus -= (m_focus > position(itr));
 
+  invalidate_index(position(itr));
   base_type::erase(itr);
 }
 
+// Returns end_filtered() if the download isn't in the view.
+View::iterator
+View::find_internal(Download* d) {
+  auto index_itr = m_index.find(d);
+
+  if (index_itr == m_index.end())
+    return end_filtered();
+
+  if (index_itr->second >= m_index_valid)
+    update_index();
+
+  return begin() + index_itr->second;
+}
+
+void
+View::update_index() {
+  for (size_type pos = m_index_valid; pos != base_type::size(); pos++)
+    m_index[base_type::operator[](pos)] = pos;
+
+  m_index_valid = base_type::size();
+}
+
 } // namespace core
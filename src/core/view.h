@@ -9,18 +9,27 @@
 // remain visible, e.g. has not been filtered out. The Download's that
 // were filtered are still in the underlying vector, but cannot be
 // accessed through the normal stl container functions.
+//
+// View::m_index maps each Download to its position in the vector, so
+// finding one doesn't search the vector. Inserts and erases only mark
+// the positions after them as stale, they are refreshed by the next
+// lookup that needs them.
 
 #ifndef RTORRENT_CORE_VIEW_DOWNLOADS_H
 #define RTORRENT_CORE_VIEW_DOWNLOADS_H
 
+#include <algorithm>
+#include <deque>
 #include <functional>
 #include <list>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include <torrent/object.h>
 #include <torrent/utils/scheduler.h>
 
 #include "globals.h"
+#include "view_expression.h"
 
 namespace core {
 
@@ -72,7 +81,10 @@ public:
     emit_changed();
   }
 
-  void insert(Download* download) { base_type::push_back(download); }
+  void insert(Download* download) {
+    base_type::push_back(download);
+    m_index[download] = base_type::size() - 1;
+  }
   void erase(Download* download);
 
   void set_visible(Download* download);
@@ -86,22 +98,34 @@ public:
 
   void sort();
 
-  void set_sort_new(const torrent::Object& s) { m_sortNew = s; }
-  void set_sort_current(const torrent::Object& s) { m_sortCurrent = s; }
+  void set_sort_new(const torrent::Object& s) { m_sortNew.set(s); m_sorted = false; }
+  void set_sort_current(const torrent::Object& s) { m_sortCurrent.set(s); m_sorted = false; }
 
   // Need to explicity trigger filtering.
   void                   filter();
   void                   filter_by(const torrent::Object& condition, base_type& result);
   void                   filter_download(core::Download* download);
 
-  const torrent::Object& get_filter() const { return m_filter; }
-  void                   set_filter(const torrent::Object& s) { m_filter = s; }
-  const torrent::Object& get_filter_temp() const { return m_temp_filter; }
-  void                   set_filter_temp(const torrent::Object& s) { m_temp_filter = s; }
+  const torrent::Object& get_filter() const { return m_filter.object(); }
+  void                   set_filter(const torrent::Object& s) { m_filter.set(s); m_filter_full = true; }
+  const torrent::Object& get_filter_temp() const { return m_temp_filter.object(); }
+  void                   set_filter_temp(const torrent::Object& s) { m_temp_filter.set(s); m_filter_full = true; }
   void                   set_filter_on_event(const std::string& event);
 
   void                   clear_filter_on();
 
+  // Visibility changes are numbered by DownloadList's change
+  // sequence. Returns the sequence of the download's last change, or
+  // zero if it hasn't changed since the view was created.
+  uint64_t               visible_sequence(Download* download) const;
+
+  // Appends the hex hashes of downloads that stopped being visible
+  // after 'sequence', including erased ones, or returns false if the
+  // log doesn't go back that far.
+  bool                   left_since(uint64_t sequence, std::vector<std::string>* hashes) const;
+
+  static const size_t    left_log_size = 4096;
+
   const torrent::Object& event_added() const { return m_event_added; }
   const torrent::Object& event_removed() const { return m_event_removed; }
   void                   set_event_added(const torrent::Object& cmd) { m_event_added = cmd; }
@@ -129,6 +153,11 @@ private:
   inline void insert_visible(Download* d);
   inline void erase_internal(iterator itr);
 
+  iterator    find_internal(Download* d);
+  void        changed_visible(Download* d, bool visible, uint64_t sequence);
+  void        update_index();
+  void        invalidate_index(size_type pos) { m_index_valid = std::min(m_index_valid, pos); }
+
   void        emit_changed();
   void        emit_changed_now();
 
@@ -141,12 +170,32 @@ private:
   size_type   m_size;
   size_type   m_focus;
 
-  // These should be replaced by a faster non-string command type.
-  torrent::Object    m_sortNew;
-  torrent::Object    m_sortCurrent;
+  // Every Download in the view, mapped to its position. Positions
+  // below 'm_index_valid' are up to date.
+  std::unordered_map<Download*, size_type> m_index;
+  size_type                                m_index_valid{0};
+
+  // Set by 'sort()' and cleared when the visible downloads may no
+  // longer be in 'sort_current' order, see 'insert_visible()'.
+  bool               m_sorted{false};
+
+  // Compiled when set, see ViewExpression.
+  ViewExpression     m_sortNew;
+  ViewExpression     m_sortCurrent;
+
+  ViewExpression     m_filter;
+  ViewExpression     m_temp_filter; // Temporary view filter (eg: name based filter)
+
+  // When the filters are tracked, 'filter()' only tests the downloads
+  // that changed after 'm_filter_sequence', see
+  // DownloadList::update_changes(). A full pass is done after the
+  // filters change or downloads are made visible by hand.
+  uint64_t           m_filter_sequence{0};
+  bool               m_filter_full{true};
 
-  torrent::Object    m_filter;
-  torrent::Object    m_temp_filter; // Temporary view filter (eg: name based filter)
+  std::unordered_map<Download*, uint64_t>      m_visible_sequence;
+  uint64_t                                     m_left_trimmed{0};
+  std::deque<std::pair<uint64_t, std::string>> m_left;
 
   torrent::Object    m_event_added;
   torrent::Object    m_event_removed;
@@ -0,0 +1,658 @@
+#include "config.h"
+
+#include "core/view_expression.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <torrent/download.h>
+#include <torrent/download_info.h>
+#include <torrent/exceptions.h>
+#include <torrent/rate.h>
+#include <torrent/data/file_list.h>
+#include <torrent/peer/connection_list.h>
+
+#include "core/download.h"
+#include "rpc/command_map.h"
+#include "rpc/parse_commands.h"
+
+namespace core {
+
+enum view_node_type {
+  view_node_constant,
+  view_node_object,       // Evaluated the same way as before compiling.
+  view_node_command,      // Dict key looked up by name on each call.
+  view_node_plan,         // Command string of a built-in command.
+  view_node_field_value,
+  view_node_field_string,
+  view_node_field_object,
+  view_node_not,
+  view_node_and,
+  view_node_or,
+  view_node_less,
+  view_node_greater,
+  view_node_equal,
+  view_node_compare
+};
+
+struct view_field {
+  const char*            name;
+  int64_t                (*value)(Download* d);
+  const std::string&     (*string)(Download* d);
+  const torrent::Object& (*object)(Download* d);
+
+  // Changes to the field are seen by Download::update_changed().
+  bool                   tracked;
+};
+
+static const torrent::Object&
+view_field_variable(Download* d, const char* key) {
+  return d->bencode()->get_key("rtorrent").get_key(key);
+}
+
+// Same values as the commands, see command_download.cc. The bytes done
+// may change without any change tracked by the download.
+static const view_field view_fields[] = {
+  { "d.name",    nullptr, [](Download* d) -> const std::string& { return d->info()->name(); }, nullptr, true },
+  { "d.message", nullptr, [](Download* d) -> const std::string& { return d->message(); }, nullptr, true },
+
+  { "d.state",    nullptr, nullptr, [](Download* d) -> const torrent::Object& { return view_field_variable(d, "state"); }, true },
+  { "d.complete", nullptr, nullptr, [](Download* d) -> const torrent::Object& { return view_field_variable(d, "complete"); }, true },
+  { "d.hashing",  nullptr, nullptr, [](Download* d) -> const torrent::Object& { return view_field_variable(d, "hashing"); }, true },
+
+  { "d.is_open",          [](Download* d) -> int64_t { return d->info()->is_open(); }, nullptr, nullptr, true },
+  { "d.is_active",        [](Download* d) -> int64_t { return d->info()->is_active(); }, nullptr, nullptr, true },
+  { "d.is_hash_checking", [](Download* d) -> int64_t { return d->download()->is_hash_checking(); }, nullptr, nullptr, true },
+  { "d.creation_date",    [](Download* d) -> int64_t { return d->info()->creation_date(); }, nullptr, nullptr, true },
+  { "d.priority",         [](Download* d) -> int64_t { return d->priority(); }, nullptr, nullptr, true },
+  { "d.up.rate",          [](Download* d) -> int64_t { return d->info()->up_rate()->rate(); }, nullptr, nullptr, true },
+  { "d.up.total",         [](Download* d) -> int64_t { return d->info()->up_rate()->total(); }, nullptr, nullptr, true },
+  { "d.down.rate",        [](Download* d) -> int64_t { return d->info()->down_rate()->rate(); }, nullptr, nullptr, true },
+  { "d.down.total",       [](Download* d) -> int64_t { return d->info()->down_rate()->total(); }, nullptr, nullptr, true },
+  { "d.bytes_done",       [](Download* d) -> int64_t { return d->download()->bytes_done(); }, nullptr, nullptr, false },
+  { "d.size_bytes",       [](Download* d) -> int64_t { return d->file_list()->size_bytes(); }, nullptr, nullptr, true },
+  { "d.completed_bytes",  [](Download* d) -> int64_t { return d->file_list()->completed_bytes(); }, nullptr, nullptr, true },
+  { "d.left_bytes",       [](Download* d) -> int64_t { return d->file_list()->left_bytes(); }, nullptr, nullptr, true },
+  { "d.peers_connected",  [](Download* d) -> int64_t { return d->connection_list()->size(); }, nullptr, nullptr, true },
+  { "d.ratio",            [](Download* d) -> int64_t { return d->ratio(); }, nullptr, nullptr, false },
+};
+
+static const view_field*
+view_find_field(const std::string& key) {
+  for (const auto& field : view_fields)
+    if (key == field.name)
+      return &field;
+
+  return nullptr;
+}
+
+struct ViewExpression::node {
+  int                                 type;
+  torrent::Object                     value;
+  const torrent::Object*              object{nullptr};
+  const view_field*                   field{nullptr};
+  std::unique_ptr<rpc::CommandHandle> handle;
+  std::unique_ptr<rpc::CommandPlan>   plan;
+  std::string                         order;
+  bool                                single_side{false};
+  std::vector<node>                   children;
+
+  explicit node(int t) : type(t) {}
+};
+
+using view_node = ViewExpression::node;
+
+// Same as 'as_boolean' in command_ui.cc.
+static bool
+view_as_boolean(const torrent::Object& obj) {
+  switch (obj.type()) {
+  case torrent::Object::TYPE_VALUE:  return obj.as_value();
+  case torrent::Object::TYPE_STRING: return !obj.as_string().empty();
+  case torrent::Object::TYPE_LIST:   return !obj.as_list().empty() && view_as_boolean(obj.as_list().front());
+  default: return false;
+  }
+}
+
+// Commands the user can't replace or erase, so they may be bound at
+// compile time.
+static bool
+view_is_builtin(rpc::CommandMap::iterator itr) {
+  return itr != rpc::commands.end() && !(itr->second.m_flags & rpc::CommandMap::flag_modifiable);
+}
+
+static view_node
+view_make_constant(int64_t value) {
+  view_node n(view_node_constant);
+  n.value = value;
+  return n;
+}
+
+static view_node
+view_make_field(const view_field* field) {
+  view_node n(field->value != nullptr ? view_node_field_value : field->string != nullptr ? view_node_field_string : view_node_field_object);
+  n.field = field;
+  return n;
+}
+
+static view_node
+view_make_command(const torrent::Object& obj) {
+  view_node n(view_node_command);
+  n.object = &obj.as_dict_obj();
+  n.handle = std::make_unique<rpc::CommandHandle>(&rpc::commands, obj.as_dict_key().c_str());
+  return n;
+}
+
+static view_node view_compile_command(const torrent::Object& obj);
+
+// A command string, parsed now if it is a built-in command and else
+// left to 'parse_command_single'.
+static view_node
+view_compile_string(const torrent::Object& obj) {
+  view_node fallback(view_node_object);
+  fallback.object = &obj;
+
+  if (!obj.is_string())
+    return fallback;
+
+  std::unique_ptr<rpc::CommandPlan> plan;
+
+  try {
+    plan = std::make_unique<rpc::CommandPlan>(obj.as_string().c_str(), obj.as_string().c_str() + obj.as_string().size());
+  } catch (torrent::input_error& e) {
+    return fallback;
+  }
+
+  auto itr = rpc::commands.find_id(plan->id());
+
+  if (itr != rpc::commands.end() && !view_is_builtin(itr))
+    return fallback;
+
+  if (itr != rpc::commands.end() && !plan->needs_execute()) {
+    if (auto field = view_find_field(itr->first)) {
+      view_node n = view_make_field(field);
+      n.object = &obj;
+      return n;
+    }
+  }
+
+  view_node n(view_node_plan);
+  n.object = &obj;
+  n.plan = std::move(plan);
+  return n;
+}
+
+static view_node
+view_compile_side(const torrent::Object& obj) {
+  return obj.is_dict_key() ? view_compile_command(obj) : view_compile_string(obj);
+}
+
+// Arguments as seen by a CMD2_ANY_LIST command.
+static std::vector<const torrent::Object*>
+view_list_args(const torrent::Object& args) {
+  std::vector<const torrent::Object*> result;
+
+  if (args.is_list()) {
+    for (const auto& arg : args.as_list())
+      result.push_back(&arg);
+
+  } else if (!args.is_empty()) {
+    result.push_back(&args);
+  }
+
+  return result;
+}
+
+static view_node
+view_compile_command(const torrent::Object& obj) {
+  const std::string&     key  = obj.as_dict_key();
+  const torrent::Object& args = obj.as_dict_obj();
+
+  if (!view_is_builtin(rpc::commands.find(key)))
+    return view_make_command(obj);
+
+  if (key == "false")
+    return view_make_constant(0);
+
+  if (key == "not") {
+    const torrent::Object* arg = &args;
+
+    while (arg->is_list() && !arg->as_list().empty())
+      arg = &arg->as_list().front();
+
+    view_node n(view_node_not);
+    n.children.push_back(arg->is_dict_key() ? view_compile_command(*arg) : view_make_constant(view_as_boolean(*arg)));
+    return n;
+  }
+
+  if (key == "and" || key == "or") {
+    if (!args.is_list())
+      return view_make_constant(view_as_boolean(args));
+
+    view_node n(key == "and" ? view_node_and : view_node_or);
+
+    for (const auto& arg : args.as_list()) {
+      if (arg.is_value())
+        n.children.push_back(view_make_constant(arg.as_value() != 0));
+      else
+        n.children.push_back(view_compile_side(arg));
+    }
+
+    return n;
+  }
+
+  if (key == "less" || key == "greater" || key == "equal") {
+    auto list = view_list_args(args);
+
+    if (list.empty())
+      return view_make_command(obj);
+
+    view_node n(key == "less" ? view_node_less : key == "greater" ? view_node_greater : view_node_equal);
+    n.children.push_back(view_compile_side(*list.front()));
+    n.children.push_back(view_compile_side(*list.back()));
+    n.single_side = list.size() == 1;
+    return n;
+  }
+
+  if (key == "compare") {
+    auto list = view_list_args(args);
+
+    if (list.size() < 2 || std::any_of(list.begin(), list.end(), [](const torrent::Object* arg) { return !arg->is_string(); }))
+      return view_make_command(obj);
+
+    view_node n(view_node_compare);
+    n.order = list.front()->as_string();
+
+    for (auto itr = list.begin() + 1; itr != list.end(); itr++)
+      n.children.push_back(view_compile_string(**itr));
+
+    return n;
+  }
+
+  if (auto field = view_find_field(key))
+    return view_make_field(field);
+
+  // Resolved now so calls only read the handle, which allows pure
+  // commands to be called from several threads.
+  view_node n = view_make_command(obj);
+  n.handle->resolve();
+  return n;
+}
+
+static torrent::Object view_call(const view_node& n, rpc::target_type target);
+
+static Download*
+view_target_download(rpc::target_type target) {
+  if (!rpc::is_target_compatible<Download*>(target))
+    throw torrent::input_error("Target of wrong type to command.");
+
+  return rpc::get_target_cast<Download*>(target);
+}
+
+static torrent::Object
+view_cmp_results(const torrent::Object& result1, const torrent::Object& result2) {
+  if (result1.type() != result2.type())
+    throw torrent::input_error("Type mismatch.");
+
+  switch (result1.type()) {
+  case torrent::Object::TYPE_VALUE:  return result1.as_value() - result2.as_value();
+  case torrent::Object::TYPE_STRING: return (int64_t)result1.as_string().compare(result2.as_string());
+  default: return torrent::Object();
+  }
+}
+
+static torrent::Object
+view_cmp_result(const view_node& n, const torrent::Object& result) {
+  if (!result.is_value())
+    return (int64_t)false;
+
+  switch (n.type) {
+  case view_node_less:    return (int64_t)(result.as_value() < 0);
+  case view_node_greater: return (int64_t)(result.as_value() > 0);
+  default:                return (int64_t)(result.as_value() == 0);
+  }
+}
+
+// Returns the same as 'apply_cmp' in command_ui.cc, comparing the
+// fields directly when both sides are the same kind of field.
+static torrent::Object
+view_call_cmp(const view_node& n, rpc::target_type target) {
+  rpc::target_type target1 = rpc::is_target_pair(target) ? rpc::get_target_left(target) : target;
+  rpc::target_type target2 = rpc::is_target_pair(target) ? rpc::get_target_right(target) : target;
+
+  const view_node& left  = n.children.front();
+  const view_node& right = n.children.back();
+
+  if (left.type == view_node_field_value && right.type == view_node_field_value)
+    return left.field->value(view_target_download(target1)) - right.field->value(view_target_download(target2));
+
+  if (left.type == view_node_field_string && right.type == view_node_field_string)
+    return (int64_t)left.field->string(view_target_download(target1)).compare(right.field->string(view_target_download(target2)));
+
+  torrent::Object result1 = view_call(left, target1);
+  torrent::Object result2 = view_call(right, target2);
+
+  return view_cmp_results(result1, result2);
+}
+
+// Same as 'apply_compare' in command_ui.cc, 'result(i, right)' returns
+// the value of the i'th field of the left or right download.
+template <typename Result>
+static torrent::Object
+view_compare_results(const view_node& n, rpc::target_type target, Result result) {
+  const char* current = n.order.c_str();
+
+  for (size_t i = 0; i != n.children.size(); i++) {
+    const torrent::Object& result1 = result(i, false);
+    const torrent::Object& result2 = result(i, true);
+
+    if (result1.type() != result2.type())
+      throw torrent::input_error(std::string("Type mismatch in compare of ") + n.children[i].object->as_string());
+
+    bool descending = *current == 'd' || *current == 'D' || *current == '-';
+    if (*current) {
+      if (!descending && !(*current == 'a' || *current == 'A' || *current == '+'))
+        throw torrent::input_error(std::string("Bad order '") + *current + "' in " + n.order);
+      ++current;
+    }
+
+    switch (result1.type()) {
+    case torrent::Object::TYPE_VALUE:
+      if (result1.as_value() != result2.as_value())
+        return (int64_t)(descending ^ (result1.as_value() < result2.as_value()));
+      break;
+
+    case torrent::Object::TYPE_STRING:
+      if (result1.as_string() != result2.as_string())
+        return (int64_t)(descending ^ (result1.as_string() < result2.as_string()));
+      break;
+
+    default:
+      break;
+    }
+  }
+
+  return (int64_t)(target.second < target.third);
+}
+
+static torrent::Object
+view_call_compare(const view_node& n, rpc::target_type target) {
+  if (!rpc::is_target_pair(target))
+    throw torrent::input_error("Can only compare a target pair.");
+
+  return view_compare_results(n, target, [&](size_t i, bool right) {
+      return view_call(n.children[i], right ? rpc::get_target_right(target) : rpc::get_target_left(target));
+    });
+}
+
+static torrent::Object
+view_call(const view_node& n, rpc::target_type target) {
+  switch (n.type) {
+  case view_node_constant:
+    return n.value;
+
+  case view_node_object:
+    return rpc::parse_command_single(target, n.object->as_string());
+
+  case view_node_command:
+    return n.handle->call(*n.object, target);
+
+  case view_node_plan:
+    return n.plan->call(target);
+
+  case view_node_field_value:
+    return n.field->value(view_target_download(target));
+
+  case view_node_field_string:
+    return n.field->string(view_target_download(target));
+
+  case view_node_field_object:
+    return n.field->object(view_target_download(target));
+
+  case view_node_not:
+    return (int64_t)!view_as_boolean(view_call(n.children.front(), target));
+
+  case view_node_and:
+    for (const auto& child : n.children)
+      if (!view_as_boolean(view_call(child, target)))
+        return (int64_t)false;
+
+    return (int64_t)true;
+
+  case view_node_or:
+    for (const auto& child : n.children)
+      if (view_as_boolean(view_call(child, target)))
+        return (int64_t)true;
+
+    return (int64_t)false;
+
+  case view_node_less:
+  case view_node_greater:
+  case view_node_equal:
+    return view_cmp_result(n, view_call_cmp(n, target));
+
+  case view_node_compare:
+    return view_call_compare(n, target);
+
+  default:
+    throw torrent::internal_error("ViewExpression::call(...) invalid node type.");
+  }
+}
+
+static bool
+view_is_tracked(const view_node& n) {
+  switch (n.type) {
+  case view_node_constant:
+    return true;
+
+  case view_node_field_value:
+  case view_node_field_string:
+  case view_node_field_object:
+    return n.field->tracked;
+
+  case view_node_not:
+  case view_node_and:
+  case view_node_or:
+  case view_node_less:
+  case view_node_greater:
+  case view_node_equal:
+  case view_node_compare:
+    return std::all_of(n.children.begin(), n.children.end(), &view_is_tracked);
+
+  default:
+    return false;
+  }
+}
+
+static bool
+view_is_pure(const view_node& n) {
+  switch (n.type) {
+  case view_node_constant:
+    return true;
+
+  case view_node_field_value:
+  case view_node_field_string:
+  case view_node_field_object:
+    return rpc::commands.is_pure(rpc::commands.find(n.field->name));
+
+  case view_node_command: {
+    auto itr = rpc::commands.find(n.handle->key());
+    return view_is_builtin(itr) && rpc::commands.is_pure(itr);
+  }
+
+  case view_node_plan:
+    return !n.plan->needs_execute() && rpc::commands.is_pure(rpc::commands.find_id(n.plan->id()));
+
+  case view_node_not:
+  case view_node_and:
+  case view_node_or:
+  case view_node_less:
+  case view_node_greater:
+  case view_node_equal:
+  case view_node_compare:
+    return std::all_of(n.children.begin(), n.children.end(), &view_is_pure);
+
+  default:
+    return false;
+  }
+}
+
+// A side of 'equal' as a built-in command and its arguments, unless
+// the arguments need to be executed.
+static bool
+view_side_command(const torrent::Object& obj, rpc::CommandMap::iterator* itr, torrent::Object* args) {
+  if (obj.is_dict_key()) {
+    *itr  = rpc::commands.find(obj.as_dict_key());
+    *args = obj.as_dict_obj();
+    return view_is_builtin(*itr);
+  }
+
+  if (!obj.is_string())
+    return false;
+
+  try {
+    rpc::CommandPlan plan(obj.as_string().c_str(), obj.as_string().c_str() + obj.as_string().size());
+
+    *itr  = rpc::commands.find_id(plan.id());
+    *args = plan.args();
+    return view_is_builtin(*itr) && !plan.needs_execute();
+
+  } catch (torrent::input_error& e) {
+    return false;
+  }
+}
+
+static bool
+view_custom_equal(const torrent::Object& obj, CustomAttributes::key_type* key, torrent::Object* value) {
+  rpc::CommandMap::iterator itr;
+  torrent::Object           args;
+
+  if (!view_side_command(obj, &itr, &args) || itr->first != "equal")
+    return false;
+
+  auto list = view_list_args(args);
+
+  if (list.size() != 2)
+    return false;
+
+  for (size_t i = 0; i != 2; i++) {
+    rpc::CommandMap::iterator custom_itr;
+    rpc::CommandMap::iterator constant_itr;
+    torrent::Object           custom_args;
+    torrent::Object           constant_args;
+
+    if (!view_side_command(*list[i], &custom_itr, &custom_args) || custom_itr->first != "d.custom")
+      continue;
+
+    auto custom_key = view_list_args(custom_args);
+
+    if (custom_key.size() != 1 || !custom_key.front()->is_string())
+      return false;
+
+    if (!view_side_command(*list[1 - i], &constant_itr, &constant_args) || (constant_itr->first != "cat" && constant_itr->first != "value"))
+      return false;
+
+    // Neither depends on the target, so the result is the same as on
+    // every call.
+    try {
+      *value = rpc::commands.call_command(constant_itr, constant_args);
+    } catch (torrent::input_error& e) {
+      return false;
+    }
+
+    if (!value->is_value() && !(value->is_string() && !value->as_string().empty()))
+      return false;
+
+    *key = CustomAttributes::key(custom_key.front()->as_string());
+    return true;
+  }
+
+  return false;
+}
+
+ViewExpression::ViewExpression() = default;
+
+ViewExpression::ViewExpression(const torrent::Object& obj) {
+  set(obj);
+}
+
+ViewExpression::~ViewExpression() = default;
+
+void
+ViewExpression::set(const torrent::Object& obj) {
+  m_root.reset();
+  m_object = obj;
+
+  // Compile against our own copy as the nodes point into it.
+  m_root = std::make_unique<node>(m_object.is_dict_key() ? view_compile_command(m_object) : view_compile_string(m_object));
+  m_custom_value = torrent::Object();
+  m_custom_equal = view_custom_equal(m_object, &m_custom_key, &m_custom_value);
+
+  // Custom attributes are only changed by 'd.custom.set', which marks
+  // the download as changed.
+  m_tracked = m_object.is_empty() || m_custom_equal || view_is_tracked(*m_root);
+  m_pure    = m_object.is_empty() || view_is_pure(*m_root);
+}
+
+torrent::Object
+ViewExpression::call(rpc::target_type target) const {
+  if (m_root == nullptr)
+    return rpc::parse_command_single(target, m_object.as_string());
+
+  return view_call(*m_root, target);
+}
+
+size_t
+ViewExpression::sort_key_size() const {
+  if (m_root == nullptr)
+    return 0;
+
+  switch (m_root->type) {
+  case view_node_less:
+  case view_node_greater:
+  case view_node_equal:
+    return m_root->single_side ? 1 : 0;
+
+  case view_node_compare:
+    return m_root->children.size();
+
+  default:
+    return 0;
+  }
+}
+
+void
+ViewExpression::sort_keys(rpc::target_type target, sort_key* keys) const {
+  for (size_t i = 0, last = sort_key_size(); i != last; i++) {
+    try {
+      keys[i].value = view_call(m_root->children[i], target);
+      keys[i].failed = false;
+
+    } catch (torrent::input_error& e) {
+      keys[i].value = torrent::Object();
+      keys[i].error = e.what();
+      keys[i].failed = true;
+    }
+  }
+}
+
+bool
+ViewExpression::sort_keys_less(const sort_key* keys1, const sort_key* keys2, rpc::target_type target) const {
+  auto result = [&](size_t i, bool right) -> const torrent::Object& {
+    const sort_key& key = right ? keys2[i] : keys1[i];
+
+    if (key.failed)
+      throw torrent::input_error(key.error);
+
+    return key.value;
+  };
+
+  if (m_root->type == view_node_compare)
+    return view_compare_results(*m_root, target, result).as_value();
+
+  const torrent::Object& result1 = result(0, false);
+  const torrent::Object& result2 = result(0, true);
+
+  return view_cmp_result(*m_root, view_cmp_results(result1, result2)).as_value();
+}
+
+} // namespace core
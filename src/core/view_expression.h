@@ -0,0 +1,100 @@
+// Filter and sort expressions of a View, compiled once when set
+// instead of being looked up and parsed for every download.
+//
+// The boolean and comparison commands, such as 'and' and 'less', are
+// evaluated directly on their compiled arguments and the common
+// download getters read the fields without going through the
+// command map. Anything else is called as a command with the
+// arguments parsed at compile time.
+//
+// Only commands that cannot be modified by the user are compiled,
+// others are looked up by name on each call so that the expression
+// follows 'method.insert' and 'method.erase'.
+
+#ifndef RTORRENT_CORE_VIEW_EXPRESSION_H
+#define RTORRENT_CORE_VIEW_EXPRESSION_H
+
+#include <memory>
+#include <string>
+#include <torrent/object.h>
+
+#include "core/custom_attributes.h"
+#include "rpc/command.h"
+
+namespace core {
+
+class ViewExpression {
+public:
+  ViewExpression();
+  explicit ViewExpression(const torrent::Object& obj);
+  ~ViewExpression();
+
+  const torrent::Object& object() const { return m_object; }
+  bool                   is_empty() const { return m_object.is_empty(); }
+
+  void                   set(const torrent::Object& obj);
+
+  // True if the result for a download only depends on fields whose
+  // changes are tracked by Download::update_changed(), so the result
+  // can't change unless the download's change sequence does.
+  bool                   is_tracked() const { return m_tracked; }
+
+  // True if the expression only reads the download through commands
+  // flagged as pure, see CommandMap::flag_pure, so different downloads
+  // may be evaluated on other threads.
+  bool                   is_pure() const { return m_pure; }
+
+  // True if the expression is 'equal' of 'd.custom' with a fixed key
+  // and a constant from 'cat' or 'value', so a CustomIndex can tell
+  // which downloads match. Never an empty string, which also matches
+  // downloads that don't have the attribute.
+  bool                       is_custom_equal() const { return m_custom_equal; }
+  CustomAttributes::key_type custom_key() const { return m_custom_key; }
+  const torrent::Object&     custom_value() const { return m_custom_value; }
+
+  // Calls a command object as the views always did, a dict key with
+  // its arguments or a single command string. Throws input_error.
+  torrent::Object        call(rpc::target_type target) const;
+
+  // A sort expression that only compares the results of the same
+  // commands called on each download, such as 'less' with a single
+  // argument or 'compare', can be split into per-download keys. The
+  // keys are then evaluated once per download instead of for each
+  // comparison.
+  //
+  // Errors are kept in the key and thrown by 'sort_keys_less' when
+  // the comparison reaches that key.
+  struct sort_key {
+    torrent::Object      value;
+    std::string          error;
+    bool                 failed{false};
+  };
+
+  // Returns 0 if the expression can't be split into keys.
+  size_t                 sort_key_size() const;
+
+  void                   sort_keys(rpc::target_type target, sort_key* keys) const;
+
+  // Same result as 'call(target).as_value()' for the target pair the
+  // keys were evaluated for.
+  bool                   sort_keys_less(const sort_key* keys1, const sort_key* keys2, rpc::target_type target) const;
+
+  struct node;
+
+private:
+  ViewExpression(const ViewExpression&) = delete;
+  ViewExpression& operator=(const ViewExpression&) = delete;
+
+  torrent::Object        m_object;
+  std::unique_ptr<node>  m_root;
+  bool                   m_tracked{true};
+  bool                   m_pure{true};
+
+  bool                       m_custom_equal{false};
+  CustomAttributes::key_type m_custom_key{};
+  torrent::Object            m_custom_value;
+};
+
+} // namespace core
+
+#endif
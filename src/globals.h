@@ -1,6 +1,7 @@
 #ifndef TORRENT_GLOBALS_H
 #define TORRENT_GLOBALS_H
 
+#include <vector>
 #include <torrent/common.h>
 
 #include "rpc/ip_table_list.h"
@@ -30,8 +31,16 @@ void                    cancel_callback_and_wait(void* target);
 
 rpc::SCgi*              scgi();
 void                    set_scgi(rpc::SCgi* scgi);
+rpc::SCgi*              http();
+void                    set_http(rpc::SCgi* http);
 void                    set_rpc_log(const std::string& filename);
 
+// Worker threads serving connections accepted on the SCGI thread.
+void                    start_workers(unsigned int count);
+void                    stop_workers();
+
+const std::vector<torrent::utils::Thread*>& workers();
+
 } // namespace torrent::scgi_thread
 
 
@@ -0,0 +1,353 @@
+#include "config.h"
+
+#include "rpc/bencode_rpc.h"
+
+#include <string>
+#include <torrent/exceptions.h>
+#include <torrent/object.h>
+#include <torrent/object_stream.h>
+
+#include "rpc/command_map.h"
+#include "rpc/rpc_batch.h"
+#include "rpc/rpc_manager.h"
+#include "utils/functional.h"
+
+namespace rpc {
+
+// Same codes as JSON-RPC.
+constexpr int BENCODE_RPC_PARSE_ERROR            = -32700;
+constexpr int BENCODE_RPC_INVALID_REQUEST_ERROR  = -32600;
+constexpr int BENCODE_RPC_METHOD_NOT_FOUND_ERROR = -32601;
+constexpr int BENCODE_RPC_INVALID_PARAMS_ERROR   = -32602;
+constexpr int BENCODE_RPC_INTERNAL_ERROR         = -32000;
+
+static void
+bencode_write_string(std::string* buffer, const std::string& str) {
+  buffer->append(std::to_string(str.size()));
+  buffer->push_back(':');
+  buffer->append(str);
+}
+
+// Dict keys are written as a list of the key followed by the values,
+// the same as the JSON-RPC encoding.
+static void
+bencode_write(std::string* buffer, const torrent::Object& object) {
+  switch (object.type()) {
+  case torrent::Object::TYPE_VALUE:
+    buffer->push_back('i');
+    buffer->append(std::to_string(object.as_value()));
+    buffer->push_back('e');
+    break;
+
+  case torrent::Object::TYPE_STRING:
+    bencode_write_string(buffer, object.as_string());
+    break;
+
+  case torrent::Object::TYPE_LIST:
+    buffer->push_back('l');
+
+    for (const auto& obj : object.as_list())
+      bencode_write(buffer, obj);
+
+    buffer->push_back('e');
+    break;
+
+  case torrent::Object::TYPE_MAP:
+    // The map is ordered by the raw key bytes, as bencode requires.
+    buffer->push_back('d');
+
+    for (const auto& entry : object.as_map()) {
+      bencode_write_string(buffer, entry.first);
+      bencode_write(buffer, entry.second);
+    }
+
+    buffer->push_back('e');
+    break;
+
+  case torrent::Object::TYPE_DICT_KEY: {
+    buffer->push_back('l');
+    bencode_write(buffer, object.as_dict_key());
+
+    const auto& dict_obj = object.as_dict_obj();
+
+    if (dict_obj.is_list()) {
+      for (const auto& element : dict_obj.as_list())
+        bencode_write(buffer, element);
+    } else {
+      bencode_write(buffer, dict_obj);
+    }
+
+    buffer->push_back('e');
+    break;
+  }
+
+  default:
+    buffer->append("i0e");
+    break;
+  }
+}
+
+static std::string
+bencode_error(int code, const std::string& msg, const std::string& id) {
+  std::string buffer = "d5:errord4:codei" + std::to_string(code) + "e7:message";
+
+  bencode_write_string(&buffer, msg);
+  buffer.push_back('e');
+
+  if (!id.empty()) {
+    buffer.append("2:id");
+    buffer.append(id);
+  }
+
+  buffer.push_back('e');
+  return buffer;
+}
+
+// The serialized id is kept as-is, an empty id is left out of the
+// response.
+static RpcCall
+bencode_decode_call(const torrent::Object& request) {
+  RpcCall call;
+
+  call.id.clear();
+
+  if (!request.is_map()) {
+    call.set_error(BENCODE_RPC_INVALID_REQUEST_ERROR, "invalid request: not a dictionary");
+    return call;
+  }
+
+  if (request.has_key("id")) {
+    const auto& id = request.get_key("id");
+
+    if (!id.is_value() && !id.is_string()) {
+      call.set_error(BENCODE_RPC_INVALID_REQUEST_ERROR, "request id is invalid type");
+      return call;
+    }
+
+    bencode_write(&call.id, id);
+
+  } else {
+    call.is_notification = true;
+  }
+
+  if (!request.has_key_string("method")) {
+    call.set_error(BENCODE_RPC_INVALID_REQUEST_ERROR, "method string not present");
+    return call;
+  }
+
+  call.method = request.get_key_string("method");
+
+  if (!request.has_key("params")) {
+    call.params.as_list().push_back("");
+    return call;
+  }
+
+  if (!request.get_key("params").is_list()) {
+    call.set_error(BENCODE_RPC_INVALID_REQUEST_ERROR, "invalid request: params field must be a list");
+    return call;
+  }
+
+  call.params = request.get_key("params");
+  return call;
+}
+
+static void
+bencode_call_command(RpcCall* call) {
+  CommandMap::iterator itr = commands.find(call->method.c_str());
+
+  if (itr == commands.end() || !(itr->second.m_flags & CommandMap::flag_public_rpc))
+    throw rpc_error(BENCODE_RPC_METHOD_NOT_FOUND_ERROR, "method not found: " + call->method);
+
+  call->is_known_method = true;
+
+  if (call->has_error)
+    throw rpc_error(call->error_code, call->error_message);
+
+  auto&            params = call->params.as_list();
+  rpc::target_type target = rpc::make_target();
+
+  std::function<void()> deleter = []() {};
+  utils::scope_guard    guard([&deleter]() { deleter(); });
+
+  if (params.empty())
+    params.push_back("");
+
+  if (!params.front().is_string())
+    throw torrent::input_error("invalid parameters: target must be a string");
+
+  RpcManager::object_to_target(params.front(), itr->second.m_flags, &target, &deleter);
+
+  params.erase(params.begin());
+
+  call->result = rpc::commands.call_command(itr, call->params, target);
+}
+
+static void
+bencode_execute_call(RpcCall* call) {
+  if (call->has_error && !call->is_error_after_lookup)
+    return;
+
+  try {
+    bencode_call_command(call);
+    return;
+
+  } catch (rpc_error& e) {
+    call->set_error(e.type(), e.what());
+  } catch (torrent::input_error& e) {
+    call->set_error(BENCODE_RPC_INVALID_PARAMS_ERROR, e.what());
+  } catch (torrent::local_error& e) {
+    call->set_error(BENCODE_RPC_INTERNAL_ERROR, e.what());
+  } catch (std::exception& e) {
+    if (!call->is_notification)
+      throw;
+  }
+
+  call->is_error_after_lookup = false;
+}
+
+void
+BencodeRpc::decode(const char* in_buffer, uint32_t length, RpcBatch* batch) {
+  torrent::Object body;
+
+  try {
+    if (torrent::object_read_bencode_c(in_buffer, in_buffer + length, &body) != in_buffer + length)
+      throw torrent::input_error("trailing data after request");
+
+  } catch (torrent::input_error& e) {
+    batch->set_response(bencode_error(BENCODE_RPC_PARSE_ERROR, std::string("parse error: ") + e.what(), std::string()));
+    return;
+  }
+
+  if (!body.is_list()) {
+    batch->calls.push_back(bencode_decode_call(body));
+    return;
+  }
+
+  if (body.as_list().empty()) {
+    batch->set_response(bencode_error(BENCODE_RPC_INVALID_REQUEST_ERROR, "invalid request: empty batch", std::string()));
+    return;
+  }
+
+  batch->is_multicall = true;
+  batch->calls.reserve(body.as_list().size());
+
+  for (const auto& request : body.as_list())
+    batch->calls.push_back(bencode_decode_call(request));
+}
+
+void
+BencodeRpc::execute(RpcBatch* batch) {
+  if (batch->has_response)
+    return;
+
+  for (auto& call : batch->calls) {
+    auto started = std::chrono::steady_clock::now();
+    bencode_execute_call(&call);
+    call.execute_time = std::chrono::steady_clock::now() - started;
+  }
+}
+
+std::string
+BencodeRpc::encode(RpcBatch* batch) {
+  std::string response;
+
+  while (!encode_partial(batch, &response, std::string::npos))
+    ;
+
+  return response;
+}
+
+struct BencodeRpcEncodeState : public RpcEncodeState {
+  size_t call{0};
+  size_t element{0};
+
+  bool   is_started{false};
+  bool   is_in_result{false};
+};
+
+// Bencode has no invalid values to recover from, so unlike JSON-RPC
+// the response cannot fail once encoding has started.
+bool
+BencodeRpc::encode_partial(RpcBatch* batch, std::string* buffer, size_t max_size) {
+  if (batch->has_response) {
+    buffer->append(batch->response);
+    return true;
+  }
+
+  if (!batch->encode_state)
+    batch->encode_state = std::make_unique<BencodeRpcEncodeState>();
+
+  auto   state = static_cast<BencodeRpcEncodeState*>(batch->encode_state.get());
+  size_t start = buffer->size();
+
+  if (!state->is_started) {
+    if (batch->is_multicall)
+      buffer->push_back('l');
+
+    state->is_started = true;
+  }
+
+  for (; state->call != batch->calls.size(); state->call++) {
+    auto& call = batch->calls[state->call];
+
+    if (call.is_notification)
+      continue;
+
+    if (!state->is_in_result) {
+      if (call.has_error) {
+        buffer->append(bencode_error(call.error_code, call.error_message, call.id));
+        continue;
+      }
+
+      buffer->push_back('d');
+
+      if (!call.id.empty()) {
+        buffer->append("2:id");
+        buffer->append(call.id);
+      }
+
+      buffer->append("6:result");
+
+      if (!call.result.is_list()) {
+        bencode_write(buffer, call.result);
+        buffer->push_back('e');
+        continue;
+      }
+
+      buffer->push_back('l');
+
+      state->is_in_result = true;
+      state->element      = 0;
+    }
+
+    auto& list = call.result.as_list();
+
+    while (state->element != list.size()) {
+      bencode_write(buffer, list[state->element]);
+      list[state->element++] = torrent::Object();
+
+      if (buffer->size() - start >= max_size)
+        return false;
+    }
+
+    buffer->append("ee");
+    state->is_in_result = false;
+  }
+
+  if (batch->is_multicall)
+    buffer->push_back('e');
+
+  return true;
+}
+
+bool
+BencodeRpc::process(const char* in_buffer, uint32_t length, slot_write_buffer callback) {
+  RpcBatch batch;
+
+  decode(in_buffer, length, &batch);
+  execute(&batch);
+
+  return callback(encode(&batch));
+}
+
+} // namespace rpc
@@ -0,0 +1,45 @@
+#ifndef RTORRENT_RPC_BENCODE_RPC_H
+#define RTORRENT_RPC_BENCODE_RPC_H
+
+#include <functional>
+#include <string>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace rpc {
+
+struct RpcBatch;
+
+// Binary RPC using bencode, with the same request and response
+// semantics as JSON-RPC:
+//
+// Request:  d6:method<str>6:paramsl<target>...e2:id<int|str>e
+// Response: d2:id<id>6:result<obj>e
+// Error:    d5:errord4:codei<code>e7:message<str>e2:id<id>e
+//
+// A list of requests is a batch, and requests without an id are
+// notifications that get no response.
+class BencodeRpc {
+public:
+  using slot_write_buffer = std::function<bool(std::string&&)>;
+
+  void        initialize() {};
+  void        cleanup() {};
+
+  bool        process(const char* in_buffer, uint32_t length, slot_write_buffer callback);
+
+  // Only 'execute' needs to be called from the main thread.
+  void        decode(const char* in_buffer, uint32_t length, RpcBatch* batch);
+  void        execute(RpcBatch* batch);
+  std::string encode(RpcBatch* batch);
+
+  // See JsonRpc::encode_partial.
+  bool        encode_partial(RpcBatch* batch, std::string* buffer, size_t max_size);
+
+  void        insert_command(const char* name, const char* parm, const char* doc) {};
+};
+
+} // namespace rpc
+
+#endif
@@ -21,16 +21,28 @@ command_base::stack_type command_base::current_stack;
 
 CommandMap::iterator
 CommandMap::insert(const key_type& key, int flags, const char* parm, const char* doc) {
-  iterator itr = base_type::find(key);
+  iterator itr = base_type::lower_bound(key);
 
-  if (itr != base_type::end())
+  if (itr != base_type::end() && itr->first == key)
     throw torrent::internal_error("CommandMap::insert(...) tried to insert an already existing key.");
 
   // TODO: This is not honoring the public_xmlrpc flags!!!
   if (rpc::rpc.is_handlers_initialized() && (flags & flag_public_rpc))
     rpc::rpc.insert_command(key.c_str(), parm, doc);
 
-  return base_type::insert(itr, value_type(key, command_map_data_type(flags, parm, doc)));
+  return insert_entry(itr, key, command_map_data_type(flags, parm, doc));
+}
+
+CommandMap::iterator
+CommandMap::insert_entry(iterator hint, const key_type& key, const command_map_data_type& data) {
+  iterator itr = base_type::insert(hint, value_type(key, data));
+
+  itr->second.m_id = m_ids.size();
+
+  m_ids.push_back(itr);
+  m_index.emplace(key, itr);
+
+  return itr;
 }
 
 void
@@ -45,13 +57,16 @@ CommandMap::erase(iterator itr) {
 //   if (!(itr->second.m_flags & flag_dont_delete))
 //     delete itr->second.m_variable;
 
+  m_ids[itr->second.m_id] = end();
+  m_index.erase(itr->first);
+
   base_type::erase(itr);
 }
 
 void
 CommandMap::create_redirect(const key_type& key_new, const key_type& key_dest, int flags) {
-  iterator new_itr  = base_type::find(key_new);
-  iterator dest_itr = base_type::find(key_dest);
+  iterator new_itr  = find(key_new);
+  iterator dest_itr = find(key_dest);
 
   if (dest_itr == base_type::end())
     throw torrent::input_error("Tried to redirect to a key that doesn't exist: '" + std::string(key_dest) + "'.");
@@ -71,10 +86,9 @@ CommandMap::create_redirect(const key_type& key_new, const key_type& key_dest, i
   if (rpc::rpc.is_handlers_initialized() && (flags & flag_public_rpc))
     rpc::rpc.insert_command(key_new.c_str(), dest_itr->second.m_parm, dest_itr->second.m_doc);
 
-  iterator itr = base_type::insert(base_type::end(),
-                                   value_type(key_new, command_map_data_type(flags,
-                                                                             dest_itr->second.m_parm,
-                                                                             dest_itr->second.m_doc)));
+  iterator itr = insert_entry(base_type::lower_bound(key_new), key_new, command_map_data_type(flags,
+                                                                                             dest_itr->second.m_parm,
+                                                                                             dest_itr->second.m_doc));
 
   // We can assume all the slots are the same size.
   itr->second.m_variable = dest_itr->second.m_variable;
@@ -93,9 +107,9 @@ CommandMap::call_catch(const key_type& key, const target_type& target, const map
 
 const CommandMap::mapped_type
 CommandMap::call_command(const key_type& key, const mapped_type& arg, const target_type& target) {
-  iterator itr = base_type::find(key);
+  iterator itr = find(key);
 
-  if (itr == base_type::end())
+  if (itr == end())
     throw torrent::input_error("Command \"" + std::string(key) + "\" does not exist.");
 
   return itr->second.m_anySlot(&itr->second.m_variable, target, arg);
@@ -106,4 +120,15 @@ CommandMap::call_command(iterator itr, const mapped_type& arg, const target_type
   return itr->second.m_anySlot(&itr->second.m_variable, target, arg);
 }
 
+CommandMap::iterator
+CommandHandle::resolve() {
+  CommandMap::iterator itr = m_map->find(m_key);
+
+  if (itr == m_map->end())
+    throw torrent::input_error("Command \"" + std::string(m_key) + "\" does not exist.");
+
+  m_id = itr->second.m_id;
+  return itr;
+}
+
 }
@@ -4,6 +4,8 @@
 #include <map>
 #include <string>
 #include <cstring>
+#include <unordered_map>
+#include <vector>
 #include <torrent/object.h>
 
 #include "command.h"
@@ -26,11 +28,16 @@ struct command_map_data_type {
   command_base::any_slot   m_anySlot;
 
   int           m_flags;
+  uint32_t      m_id{~uint32_t()};
 
   const char*   m_parm;
   const char*   m_doc;
 };
 
+// Commands are kept sorted by name for listing, while lookups by name
+// go through a hash index. Each command is also interned as an id at
+// registration, which is used by CommandHandle to dispatch without any
+// lookup. Ids are not reused after a command is erased.
 class CommandMap : public std::map<std::string, command_map_data_type> {
 public:
   typedef std::map<std::string, command_map_data_type> base_type;
@@ -38,6 +45,8 @@ public:
   typedef torrent::Object         mapped_type;
   typedef mapped_type::value_type mapped_value_type;
 
+  typedef uint32_t                id_type;
+
   using base_type::iterator;
   using base_type::const_iterator;
   using base_type::key_type;
@@ -45,7 +54,8 @@ public:
 
   using base_type::begin;
   using base_type::end;
-  using base_type::find;
+
+  static constexpr id_type invalid_id = ~id_type();
 
   static const int flag_dont_delete   = 0x1;
   static const int flag_public_rpc    = 0x4;
@@ -53,14 +63,26 @@ public:
   static const int flag_is_redirect   = 0x20;
   static const int flag_has_redirects = 0x40;
 
+  // The command only reads its target and has no side effects, so it
+  // may be called for different targets on other threads while the
+  // main thread waits for them.
+  static const int flag_pure          = 0x80;
+
   static const int flag_file_target    = 0x100;
   static const int flag_tracker_target = 0x200;
 
   CommandMap() = default;
 
-  bool                has(const std::string& key) const { return base_type::find(key) != base_type::end(); }
+  iterator            find(const key_type& key);
+  const_iterator      find(const key_type& key) const;
+
+  bool                has(const std::string& key) const { return find(key) != end(); }
+
+  // Returns end() if the command with that id has been erased.
+  iterator            find_id(id_type id) { return id < m_ids.size() ? m_ids[id] : end(); }
 
   bool                is_modifiable(const_iterator itr) { return itr != end() && (itr->second.m_flags & flag_modifiable); }
+  bool                is_pure(const_iterator itr)       { return itr != end() && (itr->second.m_flags & flag_pure); }
 
   iterator            insert(const key_type& key, int flags, const char* parm, const char* doc);
 
@@ -91,6 +113,31 @@ public:
 private:
   CommandMap(const CommandMap&);
   void operator = (const CommandMap&);
+
+  iterator            insert_entry(iterator hint, const key_type& key, const command_map_data_type& data);
+
+  std::unordered_map<std::string, iterator> m_index;
+  std::vector<iterator>                     m_ids;
+};
+
+// A command bound by name and resolved to its id on the first call,
+// for call sites that call the same command many times. The name is
+// looked up again only if the command has been erased.
+class CommandHandle {
+public:
+  CommandHandle(CommandMap* map, const char* key) : m_map(map), m_key(key) {}
+
+  const char*             key() const { return m_key; }
+
+  // Looks up the command by name, throws if it does not exist.
+  CommandMap::iterator    resolve();
+
+  const torrent::Object   call(const torrent::Object& args, const target_type& target);
+
+private:
+  CommandMap*             m_map;
+  const char*             m_key;
+  CommandMap::id_type     m_id{CommandMap::invalid_id};
 };
 
 inline target_type make_target()                                  { return target_type((int)command_base::target_generic, NULL); }
@@ -132,6 +179,28 @@ CommandMap::call(const key_type& key, const mapped_type& args) {
   return call_command(key, args, make_target());
 }
 
+inline CommandMap::iterator
+CommandMap::find(const key_type& key) {
+  auto itr = m_index.find(key);
+  return itr != m_index.end() ? itr->second : end();
+}
+
+inline CommandMap::const_iterator
+CommandMap::find(const key_type& key) const {
+  auto itr = m_index.find(key);
+  return itr != m_index.end() ? const_iterator(itr->second) : end();
+}
+
+inline const torrent::Object
+CommandHandle::call(const torrent::Object& args, const target_type& target) {
+  auto itr = m_map->find_id(m_id);
+
+  if (itr == m_map->end())
+    itr = resolve();
+
+  return m_map->call_command(itr, args, target);
+}
+
 }
 
 #endif
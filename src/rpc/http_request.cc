@@ -0,0 +1,193 @@
+#include "config.h"
+
+#include "rpc/http_request.h"
+
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <strings.h>
+
+namespace rpc {
+
+static inline bool
+http_match_header(const char* line, const char* line_end, const char* key, const char** value) {
+  size_t key_size = std::strlen(key);
+
+  if ((size_t)std::distance(line, line_end) <= key_size || line[key_size] != ':' || strncasecmp(line, key, key_size) != 0)
+    return false;
+
+  *value = line + key_size + 1;
+
+  while (*value != line_end && (**value == ' ' || **value == '\t'))
+    (*value)++;
+
+  return true;
+}
+
+static inline bool
+http_match_value(const char* value, const char* value_end, const char* token) {
+  size_t token_size = std::strlen(token);
+
+  while (value_end != value && (value_end[-1] == ' ' || value_end[-1] == '\t'))
+    value_end--;
+
+  return (size_t)std::distance(value, value_end) == token_size && strncasecmp(value, token, token_size) == 0;
+}
+
+static inline const char*
+http_find_line_end(const char* first, const char* last) {
+  return static_cast<const char*>(memmem(first, std::distance(first, last), "\r\n", 2));
+}
+
+const char*
+HttpRequest::parse_header(const char* first, const char* header_end, size_t max_content_size) {
+  const char* line     = first;
+  const char* line_end = static_cast<const char*>(std::memchr(line, '\r', std::distance(line, header_end) + 2));
+
+  if (std::strncmp(line, "POST ", 5) != 0)
+    return "405 Method Not Allowed";
+
+  if (std::distance(line, line_end) < 14 || std::strncmp(line_end - 9, " HTTP/1.", 8) != 0)
+    return "400 Bad Request";
+
+  keep_alive      = line_end[-1] == '1';
+  chunked         = false;
+  expect_continue = false;
+  content_length  = 0;
+  accept_encoding = ResponseCompressor::NONE;
+  content_type.clear();
+
+  bool        has_content_length = false;
+  const char* value;
+
+  while (line_end != header_end) {
+    line     = line_end + 2;
+    line_end = static_cast<const char*>(std::memchr(line, '\r', std::distance(line, header_end) + 2));
+
+    if (http_match_header(line, line_end, "Content-Length", &value)) {
+      char* content_pos;
+
+      errno              = 0;
+      content_length     = std::strtoul(value, &content_pos, 10);
+      has_content_length = true;
+
+      if (content_pos == value || !std::isdigit(*value) || !http_match_value(content_pos, line_end, ""))
+        return "400 Bad Request";
+
+      if (errno == ERANGE || content_length > max_content_size)
+        return "413 Payload Too Large";
+
+    } else if (http_match_header(line, line_end, "Transfer-Encoding", &value)) {
+      if (!http_match_value(value, line_end, "chunked"))
+        return "501 Not Implemented";
+
+      chunked = true;
+
+    } else if (http_match_header(line, line_end, "Content-Type", &value)) {
+      content_type.assign(value, std::distance(value, line_end));
+
+    } else if (http_match_header(line, line_end, "Connection", &value)) {
+      if (http_match_value(value, line_end, "close"))
+        keep_alive = false;
+      else if (http_match_value(value, line_end, "keep-alive"))
+        keep_alive = true;
+
+    } else if (http_match_header(line, line_end, "Accept-Encoding", &value)) {
+      accept_encoding = ResponseCompressor::negotiate(value, line_end);
+
+    } else if (http_match_header(line, line_end, "Expect", &value)) {
+      if (!http_match_value(value, line_end, "100-continue"))
+        return "417 Expectation Failed";
+
+      expect_continue = true;
+    }
+  }
+
+  if (!chunked && !has_content_length)
+    return "411 Length Required";
+
+  if (!chunked && content_length == 0)
+    return "400 Bad Request";
+
+  return NULL;
+}
+
+// Chunk sizes are checked against what is left of 'max_size' before
+// being added, so neither the length nor the position can wrap.
+HttpChunkedBody::Status
+HttpChunkedBody::parse(const char* body, const char* last, size_t max_size) {
+  const char* current = body + m_offset;
+
+  while (true) {
+    const char* line_end = http_find_line_end(current, last);
+
+    if (line_end == NULL)
+      return INCOMPLETE;
+
+    if (!std::isxdigit(*current))
+      return BAD_REQUEST;
+
+    char*  size_end;
+
+    errno = 0;
+    size_t chunk_size = std::strtoul(current, &size_end, 16);
+
+    if (errno == ERANGE || chunk_size > max_size - m_length)
+      return TOO_LARGE;
+
+    if (size_end != line_end && *size_end != ';')
+      return BAD_REQUEST;
+
+    current = line_end + 2;
+
+    if (chunk_size == 0) {
+      // Skip the trailer fields, the body ends with an empty line.
+      while ((line_end = http_find_line_end(current, last)) != NULL && line_end != current)
+        current = line_end + 2;
+
+      if (line_end == NULL)
+        return INCOMPLETE;
+
+      if (m_length == 0)
+        return BAD_REQUEST;
+
+      m_end = std::distance(body, line_end + 2);
+      return COMPLETE;
+    }
+
+    if ((size_t)std::distance(current, last) < chunk_size + 2)
+      return INCOMPLETE;
+
+    if (current[chunk_size] != '\r' || current[chunk_size + 1] != '\n')
+      return BAD_REQUEST;
+
+    current  += chunk_size + 2;
+    m_length += chunk_size;
+    m_offset  = std::distance(body, current);
+  }
+}
+
+size_t
+HttpChunkedBody::decode(char* body) const {
+  char*       target = body;
+  const char* chunk  = body;
+
+  while (true) {
+    size_t size = std::strtoul(chunk, NULL, 16);
+
+    if (size == 0)
+      break;
+
+    chunk = static_cast<const char*>(std::memchr(chunk, '\n', m_end)) + 1;
+
+    std::memmove(target, chunk, size);
+    target += size;
+    chunk  += size + 2;
+  }
+
+  return std::distance(body, target);
+}
+
+} // namespace rpc
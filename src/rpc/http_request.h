@@ -0,0 +1,57 @@
+#ifndef RTORRENT_RPC_HTTP_REQUEST_H
+#define RTORRENT_RPC_HTTP_REQUEST_H
+
+#include <cstddef>
+#include <string>
+
+#include "rpc/response_compressor.h"
+
+namespace rpc {
+
+// The request line and headers of an HTTP/1.1 POST to the RPC
+// listener. Bodies have either a Content-Length or are chunked.
+struct HttpRequest {
+  // Parses the request line and headers in [first, header_end), where
+  // 'header_end' points to the "\r\n\r\n" ending them. Returns NULL,
+  // or the status of the error response.
+  const char*  parse_header(const char* first, const char* header_end, size_t max_content_size);
+
+  bool                          keep_alive{false};
+  bool                          chunked{false};
+  bool                          expect_continue{false};
+  size_t                        content_length{0};
+  std::string                   content_type;
+  ResponseCompressor::Encoding  accept_encoding{ResponseCompressor::NONE};
+};
+
+// Checks a chunked body as it arrives. Complete chunks are only
+// checked once, later calls resume from the first chunk that hadn't
+// fully arrived.
+class HttpChunkedBody {
+public:
+  enum Status { INCOMPLETE, COMPLETE, BAD_REQUEST, TOO_LARGE };
+
+  void                reset() { m_offset = 0; m_length = 0; m_end = 0; }
+
+  // The received part of the body is [body, last), with a nul at
+  // 'last'. The decoded body may be at most 'max_size' bytes.
+  Status              parse(const char* body, const char* last, size_t max_size);
+
+  // Once complete, moves the data of the chunks to the start of
+  // 'body', returning the decoded size.
+  size_t              decode(char* body) const;
+
+  size_t              length() const { return m_length; }
+
+  // Offset of the data following the body, once complete.
+  size_t              end() const    { return m_end; }
+
+private:
+  size_t              m_offset{0};
+  size_t              m_length{0};
+  size_t              m_end{0};
+};
+
+} // namespace rpc
+
+#endif
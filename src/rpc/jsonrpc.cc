@@ -2,11 +2,15 @@
 
 #include "rpc/jsonrpc.h"
 
+#include <algorithm>
 #include <cstdint>
+#include <cstdio>
 #include <string>
+#include <vector>
 #include <torrent/common.h>
 #include <torrent/torrent.h>
 
+#include "rpc/rpc_batch.h"
 #include "rpc/rpc_manager.h"
 #include "rpc/command.h"
 #include "rpc/command_map.h"
@@ -27,96 +31,473 @@ constexpr int JSONRPC_INTERNAL_ERROR         = -32000;
 
 using json = nlohmann::json;
 
-torrent::Object
-json_to_object(const json& value) {
-  switch (value.type()) {
-  case json::value_t::number_unsigned:
-  case json::value_t::number_integer:
-    return torrent::Object(value.get<int64_t>());
-  case json::value_t::boolean:
-    return value.get<bool>() ? torrent::Object(int64_t(1)) : torrent::Object(int64_t(0));
-  case json::value_t::string:
-    return torrent::Object(value.get<std::string>());
-  case json::value_t::array: {
-    auto  array_raw = torrent::Object::create_list();
-    auto& array     = array_raw.as_list();
-    for (const auto& entry : value) {
-      array.push_back(json_to_object(entry));
-    }
-    return array_raw;
+json
+json_error(int code, const std::string& msg, json id) {
+  return json{{"jsonrpc", "2.0"}, {"id", id}, {"error", {{"code", code}, {"message", msg}}}};
+}
+
+static std::string
+jsonrpc_dump(const json& value, bool replace_invalid) {
+  if (replace_invalid)
+    return value.dump(-1, ' ', false, json::error_handler_t::replace);
+
+  return value.dump();
+}
+
+// Same output as nlohmann::json::dump(), strings that are not plain
+// ASCII are left to nlohmann as they need UTF-8 validation.
+static void
+json_write_string(std::string* buffer, const std::string& str, bool replace_invalid) {
+  if (std::any_of(str.begin(), str.end(), [](char c) { return static_cast<unsigned char>(c) >= 0x80; })) {
+    buffer->append(jsonrpc_dump(json(str), replace_invalid));
+    return;
   }
-  case json::value_t::object: {
-    auto  map_raw = torrent::Object::create_map();
-    auto& map     = map_raw.as_map();
-    for (const auto& entry : value.items()) {
-      map[entry.key()] = json_to_object(entry.value());
+
+  buffer->push_back('"');
+
+  for (auto c : str) {
+    switch (c) {
+    case '"':  buffer->append("\\\""); break;
+    case '\\': buffer->append("\\\\"); break;
+    case '\b': buffer->append("\\b"); break;
+    case '\f': buffer->append("\\f"); break;
+    case '\n': buffer->append("\\n"); break;
+    case '\r': buffer->append("\\r"); break;
+    case '\t': buffer->append("\\t"); break;
+    default:
+      if (static_cast<unsigned char>(c) < 0x20) {
+        char escaped[7];
+        std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned int>(c));
+        buffer->append(escaped);
+      } else {
+        buffer->push_back(c);
+      }
     }
-    return map_raw;
-  }
-  case json::value_t::number_float:
-    // type_name() for floats returns 'number', which is accurate for JSON but misleading
-    throw torrent::input_error("invalid parameters: unexpected data type float");
-  default:
-    throw torrent::input_error("invalid parameters: unexpected data type " + std::string(value.type_name()));
   }
+
+  buffer->push_back('"');
 }
 
-json
-object_to_json(const torrent::Object& object) noexcept {
+// Writes the object straight into the buffer, without building a json
+// tree first.
+static void
+json_write(std::string* buffer, const torrent::Object& object, bool replace_invalid) {
   switch (object.type()) {
   case torrent::Object::TYPE_VALUE:
-    return object.as_value();
+    buffer->append(std::to_string(object.as_value()));
+    break;
+
   case torrent::Object::TYPE_STRING:
-    return object.as_string();
+    json_write_string(buffer, object.as_string(), replace_invalid);
+    break;
+
   case torrent::Object::TYPE_LIST: {
-    json result = json::array();
-    for (const auto& obj : object.as_list())
-      result.push_back(object_to_json(obj));
-    return result;
+    buffer->push_back('[');
+
+    bool is_first = true;
+
+    for (const auto& obj : object.as_list()) {
+      if (!is_first)
+        buffer->push_back(',');
+
+      json_write(buffer, obj, replace_invalid);
+      is_first = false;
+    }
+
+    buffer->push_back(']');
+    break;
   }
+
   case torrent::Object::TYPE_MAP: {
-    json result = json::object();
+    // Both maps are ordered by key, as are the members of a json
+    // object.
+    buffer->push_back('{');
+
+    bool is_first = true;
+
     for (const auto& entry : object.as_map()) {
-      result.emplace(entry.first, object_to_json(entry.second));
+      if (!is_first)
+        buffer->push_back(',');
+
+      json_write_string(buffer, entry.first, replace_invalid);
+      buffer->push_back(':');
+      json_write(buffer, entry.second, replace_invalid);
+      is_first = false;
     }
-    return result;
+
+    buffer->push_back('}');
+    break;
   }
+
   case torrent::Object::TYPE_DICT_KEY: {
-    json result = json::array();
-    result.push_back(object_to_json(object.as_dict_key()));
+    buffer->push_back('[');
+    json_write(buffer, object.as_dict_key(), replace_invalid);
 
     const auto& dict_obj = object.as_dict_obj();
+
     if (dict_obj.is_list()) {
-      for (const auto& element : dict_obj.as_list())
-        result.push_back(object_to_json(element));
+      for (const auto& element : dict_obj.as_list()) {
+        buffer->push_back(',');
+        json_write(buffer, element, replace_invalid);
+      }
     } else {
-      result.push_back(object_to_json(dict_obj));
+      buffer->push_back(',');
+      json_write(buffer, dict_obj, replace_invalid);
     }
 
-    return result;
+    buffer->push_back(']');
+    break;
   }
+
   default:
-    return 0;
+    buffer->push_back('0');
+    break;
   }
 }
 
-json
-jsonrpc_call_command(const std::string& method, const json& params) {
-  if (params.type() == json::value_t::object) {
+// Decodes the request from the parser events, building the call params
+// as torrent::Object directly rather than going through a json tree.
+//
+// Members other than 'id', 'method' and 'params' are skipped, and as
+// with a json object the last of any duplicate members is used.
+class JsonRpcDecoder : public nlohmann::json_sax<json> {
+public:
+  JsonRpcDecoder(RpcBatch* batch) : m_batch(batch) {}
+
+  const std::string& error() const          { return m_error; }
+  const char*        unsupported() const    { return m_unsupported; }
+  bool               is_batch() const       { return m_is_batch; }
+  bool               is_empty_batch() const { return m_is_batch && m_batch->calls.empty(); }
+
+  bool null() override                                 { return insert_scalar(torrent::Object(), "null", "null"); }
+  bool boolean(bool val) override                      { return insert_scalar(int64_t(val), "boolean", std::string()); }
+  bool number_integer(number_integer_t val) override   { return insert_scalar(int64_t(val), "number", std::to_string(val)); }
+  bool number_unsigned(number_unsigned_t val) override { return insert_scalar(int64_t(val), "number", std::to_string(val)); }
+  bool number_float(number_float_t val, const string_t&) override;
+  bool string(string_t& val) override;
+  bool binary(binary_t&) override                      { return insert_scalar(torrent::Object(), "binary", std::string()); }
+
+  bool start_object(std::size_t) override              { return start_container(true); }
+  bool start_array(std::size_t) override               { return start_container(false); }
+  bool end_object() override                           { return end_container(); }
+  bool end_array() override                            { return end_container(); }
+
+  bool key(string_t& val) override;
+
+  bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception& ex) override;
+
+private:
+  enum params_type { PARAMS_NONE, PARAMS_ARRAY, PARAMS_OBJECT, PARAMS_OTHER };
+
+  struct request_type {
+    bool              has_id{false};
+    std::string       id{"null"};
+    const char*       id_invalid_type{nullptr};
+
+    bool              has_method{false};
+    std::string       method;
+
+    params_type       params{PARAMS_NONE};
+    torrent::Object   params_list;
+    std::string       params_error;
+  };
+
+  struct frame_type {
+    torrent::Object*  object;
+    std::string       key;
+  };
+
+  bool                is_request_member() const { return m_depth == m_request_depth && m_skip_depth == 0 && m_frames.empty(); }
+
+  bool                insert_scalar(torrent::Object&& object, const char* type_name, std::string id);
+  bool                insert_param(torrent::Object&& object, bool is_container);
+  bool                start_container(bool is_object);
+  bool                end_container();
+
+  void                finish_request();
+  void                finish_invalid_request();
+
+  RpcBatch*           m_batch;
+
+  unsigned int        m_depth{0};
+  unsigned int        m_request_depth{0};
+  unsigned int        m_skip_depth{0};
+  bool                m_is_batch{false};
+
+  const char*         m_unsupported{nullptr};
+  std::string         m_error;
+
+  request_type        m_request;
+  std::string         m_member;
+  std::vector<frame_type> m_frames;
+};
+
+bool
+JsonRpcDecoder::number_float(number_float_t val, const string_t&) {
+  // type_name() for floats returns 'number', which is accurate for JSON but misleading
+  if (!m_frames.empty() && m_request.params_error.empty())
+    m_request.params_error = "invalid parameters: unexpected data type float";
+
+  return insert_scalar(torrent::Object(), "number", json(val).dump());
+}
+
+bool
+JsonRpcDecoder::string(string_t& val) {
+  auto object = torrent::Object::create_string();
+  object.as_string().swap(val);
+
+  if (is_request_member() && m_member == "id") {
+    std::string id;
+    json_write_string(&id, object.as_string(), false);
+
+    return insert_scalar(std::move(object), "string", std::move(id));
+  }
+
+  return insert_scalar(std::move(object), "string", std::string());
+}
+
+bool
+JsonRpcDecoder::key(string_t& val) {
+  if (m_skip_depth != 0)
+    return true;
+
+  if (!m_frames.empty())
+    m_frames.back().key.swap(val);
+  else if (m_depth == m_request_depth)
+    m_member.swap(val);
+
+  return true;
+}
+
+bool
+JsonRpcDecoder::parse_error(std::size_t, const std::string&, const nlohmann::detail::exception& ex) {
+  m_error = ex.what();
+  return false;
+}
+
+// The 'id' argument is the serialized value when used as a request id,
+// or empty if the type cannot be an id.
+bool
+JsonRpcDecoder::insert_scalar(torrent::Object&& object, const char* type_name, std::string id) {
+  if (m_skip_depth != 0)
+    return true;
+
+  if (!m_frames.empty()) {
+    if (object.is_empty() && m_request.params_error.empty())
+      m_request.params_error = std::string("invalid parameters: unexpected data type ") + type_name;
+
+    return insert_param(std::move(object), false);
+  }
+
+  if (m_depth == 0) {
+    m_unsupported = type_name;
+    return true;
+  }
+
+  if (m_is_batch && m_depth == 1) {
+    finish_invalid_request();
+    return true;
+  }
+
+  if (m_depth != m_request_depth)
+    return true;
+
+  if (m_member == "id") {
+    m_request.has_id          = true;
+    m_request.id_invalid_type = id.empty() ? type_name : nullptr;
+    m_request.id              = id.empty() ? "null" : std::move(id);
+
+  } else if (m_member == "method") {
+    m_request.has_method = object.is_string();
+    m_request.method     = object.is_string() ? std::move(object.as_string()) : std::string();
+
+  } else if (m_member == "params") {
+    m_request.params = PARAMS_OTHER;
+  }
+
+  return true;
+}
+
+bool
+JsonRpcDecoder::insert_param(torrent::Object&& object, bool is_container) {
+  auto& parent = *m_frames.back().object;
+
+  torrent::Object* inserted;
+
+  if (parent.is_list()) {
+    parent.as_list().push_back(std::move(object));
+    inserted = &parent.as_list().back();
+  } else {
+    inserted  = &parent.as_map()[m_frames.back().key];
+    *inserted = std::move(object);
+  }
+
+  if (is_container)
+    m_frames.push_back(frame_type{inserted, std::string()});
+
+  return true;
+}
+
+bool
+JsonRpcDecoder::start_container(bool is_object) {
+  m_depth++;
+
+  if (m_skip_depth != 0)
+    return true;
+
+  if (!m_frames.empty())
+    return insert_param(is_object ? torrent::Object::create_map() : torrent::Object::create_list(), true);
+
+  if (m_depth == 1) {
+    m_is_batch      = !is_object;
+    m_request_depth = is_object ? 1 : 2;
+    return true;
+  }
+
+  if (m_is_batch && m_depth == 2) {
+    if (!is_object) {
+      finish_invalid_request();
+      m_skip_depth = m_depth;
+    }
+
+    return true;
+  }
+
+  if (m_depth != m_request_depth + 1) {
+    m_skip_depth = m_depth;
+    return true;
+  }
+
+  if (m_member == "id") {
+    m_request.has_id          = true;
+    m_request.id              = "null";
+    m_request.id_invalid_type = is_object ? "object" : "array";
+
+  } else if (m_member == "method") {
+    m_request.has_method = false;
+
+  } else if (m_member == "params" && !is_object) {
+    m_request.params       = PARAMS_ARRAY;
+    m_request.params_list  = torrent::Object::create_list();
+    m_request.params_error.clear();
+
+    m_frames.push_back(frame_type{&m_request.params_list, std::string()});
+    return true;
+
+  } else if (m_member == "params") {
+    m_request.params = PARAMS_OBJECT;
+  }
+
+  m_skip_depth = m_depth;
+  return true;
+}
+
+bool
+JsonRpcDecoder::end_container() {
+  if (m_skip_depth != 0) {
+    if (m_skip_depth == m_depth)
+      m_skip_depth = 0;
+
+  } else if (!m_frames.empty()) {
+    m_frames.pop_back();
+
+  } else if (m_depth == m_request_depth) {
+    finish_request();
+  }
+
+  m_depth--;
+  return true;
+}
+
+// Notifications are basically the same as requests, except we can
+// just drop the message on the floor if there are any errors.
+void
+JsonRpcDecoder::finish_request() {
+  auto    request = std::move(m_request);
+  RpcCall call;
+
+  m_request = request_type();
+  m_member.clear();
+
+  if (!request.has_id) {
+    call.is_notification = true;
+
+    if (!request.has_method) {
+      call.set_error(JSONRPC_INVALID_REQUEST_ERROR, "method string not present");
+      m_batch->calls.push_back(std::move(call));
+      return;
+    }
+
+  } else {
+    if (request.id_invalid_type != nullptr) {
+      call.set_error(JSONRPC_INVALID_REQUEST_ERROR, "request id is invalid type " + std::string(request.id_invalid_type));
+      m_batch->calls.push_back(std::move(call));
+      return;
+    }
+
+    call.id = std::move(request.id);
+
+    if (!request.has_method) {
+      call.set_error(JSONRPC_INVALID_REQUEST_ERROR, "method string not present");
+      m_batch->calls.push_back(std::move(call));
+      return;
+    }
+  }
+
+  call.method = std::move(request.method);
+
+  switch (request.params) {
+  case PARAMS_NONE:
+    call.params.as_list().push_back("");
+    break;
+
+  case PARAMS_OBJECT:
     // Named parameters is valid JSON-RPC, rtorrent just doesn't support it
-    throw rpc_error(JSONRPC_INVALID_PARAMS_ERROR, "invalid parameter: procedure named parameter not supported");
-  } else if (params.type() != json::value_t::array) {
-    throw rpc_error(JSONRPC_INVALID_REQUEST_ERROR, "invalid request: params field must be an array");
+    call.set_error(JSONRPC_INVALID_PARAMS_ERROR, "invalid parameter: procedure named parameter not supported");
+    break;
+
+  case PARAMS_OTHER:
+    call.set_error(JSONRPC_INVALID_REQUEST_ERROR, "invalid request: params field must be an array");
+    break;
+
+  case PARAMS_ARRAY:
+    if (!request.params_error.empty()) {
+      call.set_error(JSONRPC_INVALID_PARAMS_ERROR, request.params_error);
+      call.is_error_after_lookup = true;
+      break;
+    }
+
+    call.params = std::move(request.params_list);
+    break;
   }
 
-  CommandMap::iterator itr = commands.find(method.c_str());
+  m_batch->calls.push_back(std::move(call));
+}
+
+void
+JsonRpcDecoder::finish_invalid_request() {
+  RpcCall call;
+
+  call.is_notification = true;
+  call.set_error(JSONRPC_INVALID_REQUEST_ERROR, "method string not present");
+
+  m_batch->calls.push_back(std::move(call));
+}
+
+void
+jsonrpc_call_command(RpcCall* call) {
+  CommandMap::iterator itr = commands.find(call->method.c_str());
 
   if (itr == commands.end()) {
-    throw rpc_error(JSONRPC_METHOD_NOT_FOUND_ERROR, "method not found: " + method);
+    throw rpc_error(JSONRPC_METHOD_NOT_FOUND_ERROR, "method not found: " + call->method);
   }
 
-  torrent::Object  params_object      = json_to_object(params);
-  auto&            params_object_list = params_object.as_list();
+  call->is_known_method = true;
+
+  if (call->has_error)
+    throw rpc_error(call->error_code, call->error_message);
+
+  auto&            params_object_list = call->params.as_list();
   rpc::target_type target             = rpc::make_target();
 
   std::function<void()> deleter = []() {};
@@ -133,107 +514,194 @@ jsonrpc_call_command(const std::string& method, const json& params) {
 
   params_object_list.erase(params_object_list.begin());
 
-  const auto& result = rpc::commands.call_command(itr, params_object, target);
-
-  return object_to_json(result);
-}
-
-json
-json_error(int code, const std::string& msg, json id) {
-  return json{{"jsonrpc", "2.0"}, {"id", id}, {"error", {{"code", code}, {"message", msg}}}};
+  call->result = rpc::commands.call_command(itr, call->params, target);
 }
 
-json
-handle_request(const json& request) {
-  json response = {{"jsonrpc", "2.0"}, {"id", nullptr}};
+void
+jsonrpc_execute_call(RpcCall* call) {
+  if (call->has_error && !call->is_error_after_lookup)
+    return;
 
   try {
-    if (!request["id"].is_number() && !request["id"].is_string() && !request["id"].is_null())
-      return json_error(JSONRPC_INVALID_REQUEST_ERROR, "request id is invalid type " + std::string(request["id"].type_name()), response["id"]);
-    response["id"] = request["id"];
-    if (!request.contains("method") || !request["method"].is_string())
-      return json_error(JSONRPC_INVALID_REQUEST_ERROR, "method string not present", response["id"]);
-    if (request.contains("params"))
-      response["result"] = jsonrpc_call_command(request["method"], request["params"]);
-    else
-      response["result"] = jsonrpc_call_command(request["method"], json::array({""}));
-    return response;
+    jsonrpc_call_command(call);
+    return;
+
   } catch (rpc_error& e) {
-    return json_error(e.type(), e.what(), response["id"]);
+    call->set_error(e.type(), e.what());
   } catch (torrent::input_error& e) {
-    return json_error(JSONRPC_INVALID_PARAMS_ERROR, e.what(), response["id"]);
+    call->set_error(JSONRPC_INVALID_PARAMS_ERROR, e.what());
   } catch (torrent::local_error& e) {
-    return json_error(JSONRPC_INTERNAL_ERROR, e.what(), response["id"]);
+    call->set_error(JSONRPC_INTERNAL_ERROR, e.what());
+  } catch (std::exception& e) {
+    // Only notifications dropped unknown exceptions on the floor.
+    if (!call->is_notification)
+      throw;
   }
+
+  call->is_error_after_lookup = false;
+}
+
+static void
+jsonrpc_encode_call(std::string* buffer, const RpcCall& call, bool replace_invalid) {
+  if (call.has_error) {
+    buffer->append(jsonrpc_dump(json_error(call.error_code, call.error_message, json::parse(call.id)), replace_invalid));
+    return;
+  }
+
+  // Same member order as the sorted keys of a json object.
+  buffer->append("{\"id\":");
+  buffer->append(call.id);
+  buffer->append(",\"jsonrpc\":\"2.0\",\"result\":");
+  json_write(buffer, call.result, replace_invalid);
+  buffer->push_back('}');
 }
 
-// Notifications are basically the same as requests, except we can
-// just drop the message on the floor if there are any errors
 void
-handle_notification(const json& request) noexcept {
-  if (!request.contains("method") || !request["method"].is_string())
+JsonRpc::decode(const char* in_buffer, uint32_t length, RpcBatch* batch) {
+  JsonRpcDecoder decoder(batch);
+
+  if (!json::sax_parse(in_buffer, in_buffer + length, &decoder)) {
+    batch->calls.clear();
+    batch->set_response(json_error(JSONRPC_PARSE_ERROR, decoder.error(), nullptr).dump(-1, ' ', false, json::error_handler_t::replace));
     return;
-  try {
-    if (request.contains("params"))
-      jsonrpc_call_command(request["method"], request["params"]);
-    else
-      jsonrpc_call_command(request["method"], json::array({""}));
-  } catch (std::exception& e) {
   }
+
+  if (decoder.unsupported() != nullptr) {
+    batch->set_response(json_error(JSONRPC_PARSE_ERROR, "message type " + std::string(decoder.unsupported()) + " unsupported", nullptr).dump());
+    return;
+  }
+
+  // Empty batch requests are invalid as per the spec
+  if (decoder.is_empty_batch()) {
+    batch->set_response(json_error(JSONRPC_INVALID_REQUEST_ERROR, "invalid request: empty batch", nullptr).dump());
+    return;
+  }
+
+  batch->is_multicall = decoder.is_batch();
 }
 
+void
+JsonRpc::execute(RpcBatch* batch) {
+  if (batch->has_response)
+    return;
+
+  for (auto& call : batch->calls) {
+    auto started = std::chrono::steady_clock::now();
+    jsonrpc_execute_call(&call);
+    call.execute_time = std::chrono::steady_clock::now() - started;
+  }
+}
+
+std::string
+JsonRpc::encode(RpcBatch* batch) {
+  std::string response;
+
+  while (!encode_partial(batch, &response, std::string::npos))
+    ;
+
+  return response;
+}
+
+struct JsonRpcEncodeState : public RpcEncodeState {
+  size_t call{0};
+  size_t element{0};
+
+  bool   is_in_result{false};
+  bool   has_output{false};
+
+  // Part of the response has been handed out, errors can no longer
+  // replace it.
+  bool   is_flushed{false};
+};
+
+// List results are written one element at a time, so large multicall
+// responses can be sent while they are being encoded.
 bool
-JsonRpc::process(const char* in_buffer, uint32_t length, slot_write callback) {
-  json response;
-  json body;
+JsonRpc::encode_partial(RpcBatch* batch, std::string* buffer, size_t max_size) {
+  if (batch->has_response) {
+    buffer->append(batch->response);
+    return true;
+  }
+
+  if (!batch->encode_state)
+    batch->encode_state = std::make_unique<JsonRpcEncodeState>();
+
+  auto   state = static_cast<JsonRpcEncodeState*>(batch->encode_state.get());
+  size_t start = buffer->size();
 
   try {
-    body = json::parse(in_buffer, in_buffer + length);
-    switch (body.type()) {
-    case json::value_t::object: {
-      if (!body.contains("id")) {
-        handle_notification(body);
-        return callback("", 0);
-      } else {
-        response = handle_request(body);
-      }
-      break;
-    }
-    case json::value_t::array: {
-      // Empty batch requests are invalid as per the spec
-      if (body.empty()) {
-        response = json_error(JSONRPC_INVALID_REQUEST_ERROR, "invalid request: empty batch", nullptr);
-        break;
+    for (; state->call != batch->calls.size(); state->call++) {
+      auto& call = batch->calls[state->call];
+
+      if (call.is_notification)
+        continue;
+
+      if (!state->is_in_result) {
+        if (batch->is_multicall)
+          buffer->push_back(state->has_output ? ',' : '[');
+
+        state->has_output = true;
+
+        if (call.has_error || !call.result.is_list()) {
+          jsonrpc_encode_call(buffer, call, state->is_flushed);
+          continue;
+        }
+
+        // Same member order as the sorted keys of a json object.
+        buffer->append("{\"id\":");
+        buffer->append(call.id);
+        buffer->append(",\"jsonrpc\":\"2.0\",\"result\":[");
+
+        state->is_in_result = true;
+        state->element      = 0;
       }
-      response = json::array();
-      for (const auto& sub_body : body) {
-        if (!sub_body.contains("id"))
-          handle_notification(sub_body);
-        else
-          response.push_back(handle_request(sub_body));
+
+      auto& list = call.result.as_list();
+
+      while (state->element != list.size()) {
+        if (state->element != 0)
+          buffer->push_back(',');
+
+        json_write(buffer, list[state->element], state->is_flushed);
+        list[state->element++] = torrent::Object();
+
+        if (buffer->size() - start >= max_size) {
+          state->is_flushed = true;
+          return false;
+        }
       }
-      // This indicates the batch was composed entirely of
-      // notifications, in which case nothing is returned
-      if (response.empty())
-        return callback("", 0);
-      break;
-    }
-    default:
-      response = json_error(JSONRPC_PARSE_ERROR, "message type " + std::string(body.type_name()) + " unsupported", nullptr);
-    }
 
-    std::string response_str = response.dump();
+      buffer->append("]}");
+      state->is_in_result = false;
+    }
 
-    return callback(response_str.c_str(), response_str.size());
+    if (batch->is_multicall && state->has_output)
+      buffer->push_back(']');
 
-  } catch (json::parse_error& e) {
-    auto err_str = json_error(JSONRPC_PARSE_ERROR, e.what(), nullptr).dump(-1, ' ', false, json::error_handler_t::replace);
-    return callback(err_str.c_str(), err_str.size());
   } catch (json::type_error& e) {
     // Type errors may be caused by invalid UTF-8 strings in exception strings, hence the ::replace
-    auto err_str = json_error(JSONRPC_PARSE_ERROR, e.what(), nullptr).dump(-1, ' ', false, json::error_handler_t::replace);
-    return callback(err_str.c_str(), err_str.size());
+    buffer->resize(start);
+    buffer->append(json_error(JSONRPC_PARSE_ERROR, e.what(), nullptr).dump(-1, ' ', false, json::error_handler_t::replace));
   }
+
+  return true;
+}
+
+bool
+JsonRpc::process(const char* in_buffer, uint32_t length, slot_write callback) {
+  return process(in_buffer, length, [&callback](std::string&& response) {
+      return callback(response.c_str(), response.size());
+    });
+}
+
+bool
+JsonRpc::process(const char* in_buffer, uint32_t length, slot_write_buffer callback) {
+  RpcBatch batch;
+
+  decode(in_buffer, length, &batch);
+  execute(&batch);
+
+  return callback(encode(&batch));
 }
 
 } // namespace rpc
@@ -2,21 +2,39 @@
 #define RTORRENT_RPC_JSONRPC_H
 
 #include <functional>
+#include <string>
 
+#include <cstddef>
 #include <cstdint>
 
 namespace rpc {
 
+struct RpcBatch;
+
 class JsonRpc {
 public:
-  using slot_write = std::function<bool(const char*, uint32_t)>;
+  using slot_write        = std::function<bool(const char*, uint32_t)>;
+  using slot_write_buffer = std::function<bool(std::string&&)>;
+
+  void        initialize() {};
+  void        cleanup() {};
+
+  bool        process(const char* in_buffer, uint32_t length, slot_write callback);
+
+  // Hands the serialized response buffer over to the callback.
+  bool        process(const char* in_buffer, uint32_t length, slot_write_buffer callback);
 
-  void initialize() {};
-  void cleanup() {};
+  // Only 'execute' needs to be called from the main thread.
+  void        decode(const char* in_buffer, uint32_t length, RpcBatch* batch);
+  void        execute(RpcBatch* batch);
+  std::string encode(RpcBatch* batch);
 
-  bool process(const char* in_buffer, uint32_t length, slot_write callback);
+  // Appends to 'buffer' until at least 'max_size' bytes were added or
+  // the response is complete, in which case it returns true. Encoded
+  // results are released as they are written.
+  bool        encode_partial(RpcBatch* batch, std::string* buffer, size_t max_size);
 
-  void insert_command(const char* name, const char* parm, const char* doc) {};
+  void        insert_command(const char* name, const char* parm, const char* doc) {};
 };
 
 } // namespace rpc
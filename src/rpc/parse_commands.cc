@@ -84,25 +84,24 @@ parse_command_name(const char* first, const char* last, char* dest_first, char*
   return first;
 }
 
-// Set 'download' to NULL to call the generic functions, thus reusing
-// the code below for both cases.
-parse_command_type
-parse_command(target_type target, const char* first, const char* last) {
+// Parses the command name and arguments without calling it, 'key'
+// is left empty for blank and comment lines.
+static const char*
+parse_command_args(const char* first, const char* last, char* key, char* key_last, torrent::Object* args) {
   first = std::find_if(first, last, [&](char c) { return !command_map_is_space(c); });
 
-  if (first == last || *first == '#')
-    return std::make_pair(torrent::Object(), first);
-
-  char key[128];
+  if (first == last || *first == '#') {
+    *key = '\0';
+    return first;
+  }
 
-  first = parse_command_name(first, last, key, key + 128);
+  first = parse_command_name(first, last, key, key_last);
   first = std::find_if(first, last, [&](char c) { return !command_map_is_space(c); });
 
   if (first == last || *first != '=')
     throw torrent::input_error("Could not find '=' in command '" + std::string(key) + "'.");
 
-  torrent::Object args;
-  first = parse_whole_list(first + 1, last, &args, &parse_is_delim_command);
+  first = parse_whole_list(first + 1, last, args, &parse_is_delim_command);
 
   // Find the last character that is part of this command, skipping
   // the whitespace at the end. This ensures us that the caller
@@ -116,6 +115,21 @@ parse_command(target_type target, const char* first, const char* last) {
     first++;
   }
 
+  return first;
+}
+
+// Set 'download' to NULL to call the generic functions, thus reusing
+// the code below for both cases.
+parse_command_type
+parse_command(target_type target, const char* first, const char* last) {
+  char            key[128];
+  torrent::Object args;
+
+  first = parse_command_args(first, last, key, key + 128, &args);
+
+  if (*key == '\0')
+    return std::make_pair(torrent::Object(), first);
+
   // Replace any strings starting with '$' with the result of the
   // following command.
   parse_command_execute(target, &args);
@@ -123,6 +137,68 @@ parse_command(target_type target, const char* first, const char* last) {
   return std::make_pair(commands.call_command(key, args, target), first);
 }
 
+// Check if 'parse_command_execute' would modify the arguments, in
+// which case they need to be copied for each call.
+static bool
+parse_command_needs_execute(const torrent::Object& object) {
+  if (object.is_list())
+    return std::any_of(object.as_list().begin(), object.as_list().end(), [](const torrent::Object& obj) {
+        return !obj.is_list() && parse_command_needs_execute(obj);
+      });
+
+  return object.is_dict_key() || (object.is_string() && *object.as_string().c_str() == '$');
+}
+
+CommandPlan::CommandPlan(const char* first, const char* last) {
+  char key[128];
+
+  parse_command_args(first, last, key, key + 128, &m_args);
+
+  if (*key == '\0')
+    return;
+
+  CommandMap::iterator itr = commands.find(key);
+
+  if (itr == commands.end())
+    throw torrent::input_error("Command \"" + std::string(key) + "\" does not exist.");
+
+  m_id            = itr->second.m_id;
+  m_needs_execute = parse_command_needs_execute(m_args);
+}
+
+torrent::Object
+CommandPlan::call(target_type target) const {
+  if (m_id == CommandMap::invalid_id)
+    return torrent::Object();
+
+  // The command might have been erased by an earlier call.
+  CommandMap::iterator itr = commands.find_id(m_id);
+
+  if (itr == commands.end())
+    throw torrent::input_error("Command was erased.");
+
+  if (!m_needs_execute)
+    return commands.call_command(itr, m_args, target);
+
+  torrent::Object args = m_args;
+  parse_command_execute(target, &args);
+
+  return commands.call_command(itr, args, target);
+}
+
+std::vector<CommandPlan>
+parse_command_plans(torrent::Object::list_const_iterator first, torrent::Object::list_const_iterator last) {
+  std::vector<CommandPlan> plans;
+  plans.reserve(std::distance(first, last));
+
+  for (; first != last; first++) {
+    auto& cmd = first->as_string();
+    plans.emplace_back(cmd.c_str(), cmd.c_str() + cmd.size());
+  }
+
+  return plans;
+}
+
 torrent::Object
 parse_command_multiple(target_type target, const char* first, const char* last) {
   parse_command_type result;
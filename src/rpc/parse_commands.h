@@ -37,6 +37,7 @@
 
 #include <string>
 #include <cstring>
+#include <vector>
 
 #include "xmlrpc.h"
 #include "rpc_manager.h"
@@ -62,6 +63,30 @@ inline torrent::Object parse_command_multiple(target_type target, const char* fi
 bool                   parse_command_file(const std::string& path);
 const char*            parse_command_name(const char* first, const char* last, std::string* dest);
 
+// A single command parsed once and then called on any number of
+// targets, as done by the multicall commands. The command is looked up
+// and its arguments parsed up front, only the '$' substitutions are
+// done for each call.
+//
+// Like 'parse_command', anything after the first command is ignored.
+class CommandPlan {
+public:
+  CommandPlan(const char* first, const char* last);
+
+  torrent::Object call(target_type target) const;
+
+  CommandMap::id_type    id() const            { return m_id; }
+  const torrent::Object& args() const          { return m_args; }
+  bool                   needs_execute() const { return m_needs_execute; }
+
+private:
+  CommandMap::id_type  m_id{CommandMap::invalid_id};
+  torrent::Object      m_args;
+  bool                 m_needs_execute{false};
+};
+
+std::vector<CommandPlan> parse_command_plans(torrent::Object::list_const_iterator first, torrent::Object::list_const_iterator last);
+
 inline torrent::Object
 parse_command_single(target_type target, const std::string& cmd) {
   return parse_command(target, cmd.c_str(), cmd.c_str() + cmd.size()).first;
@@ -91,6 +116,9 @@ inline torrent::Object call_command       (const char* key, const torrent::Objec
 inline std::string     call_command_string(const char* key, target_type target = make_target()) { return commands.call_command(key, torrent::Object(), target).as_string(); }
 inline int64_t         call_command_value (const char* key, target_type target = make_target()) { return commands.call_command(key, torrent::Object(), target).as_value(); }
 
+inline torrent::Object call_command       (CommandHandle& handle, const torrent::Object& obj = torrent::Object(), target_type target = make_target()) { return handle.call(obj, target); }
+inline int64_t         call_command_value (CommandHandle& handle, target_type target = make_target()) { return handle.call(torrent::Object(), target).as_value(); }
+
 inline void            call_command_set_string(const char* key, const std::string& arg)            { commands.call_command(key, torrent::Object(arg)); }
 inline void            call_command_set_std_string(const std::string& key, const std::string& arg) { commands.call_command(key.c_str(), torrent::Object(arg)); }
 inline void            call_command_set_value(const char* key, int64_t arg, target_type target = make_target()) { commands.call_command(key, torrent::Object(arg), target); }
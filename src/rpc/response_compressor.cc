@@ -0,0 +1,208 @@
+#include "config.h"
+
+#include "rpc/response_compressor.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <strings.h>
+#include <torrent/exceptions.h>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace rpc {
+
+struct ResponseCompressor::state_type {
+#ifdef HAVE_ZLIB
+  z_stream  zlib{};
+#endif
+#ifdef HAVE_ZSTD
+  ZSTD_CCtx* zstd{nullptr};
+#endif
+};
+
+static bool
+compressor_is_supported(ResponseCompressor::Encoding encoding) {
+  switch (encoding) {
+#ifdef HAVE_ZLIB
+  case ResponseCompressor::GZIP:
+    return true;
+#endif
+#ifdef HAVE_ZSTD
+  case ResponseCompressor::ZSTD:
+    return true;
+#endif
+  default:
+    return false;
+  }
+}
+
+ResponseCompressor::Encoding
+ResponseCompressor::negotiate(const char* value, const char* value_end) {
+  bool accept_gzip = false;
+  bool accept_zstd = false;
+
+  while (value != value_end) {
+    auto token_end = static_cast<const char*>(std::memchr(value, ',', std::distance(value, value_end)));
+
+    if (token_end == NULL)
+      token_end = value_end;
+
+    auto name     = value;
+    auto name_end = static_cast<const char*>(std::memchr(value, ';', std::distance(value, token_end)));
+
+    if (name_end == NULL)
+      name_end = token_end;
+
+    while (name != name_end && (*name == ' ' || *name == '\t'))
+      name++;
+
+    while (name_end != name && (name_end[-1] == ' ' || name_end[-1] == '\t'))
+      name_end--;
+
+    // Only 'q=0' matters, any other weight accepts the coding.
+    bool is_accepted = true;
+
+    for (auto param = name_end; param != token_end; param++) {
+      if (*param != 'q' && *param != 'Q')
+        continue;
+
+      auto q_value = param + 1;
+
+      while (q_value != token_end && (*q_value == ' ' || *q_value == '\t'))
+        q_value++;
+
+      if (q_value == token_end || *q_value != '=')
+        continue;
+
+      is_accepted = std::strtod(std::string(q_value + 1, token_end).c_str(), NULL) > 0.0;
+      break;
+    }
+
+    size_t name_size = std::distance(name, name_end);
+
+    if (is_accepted) {
+      if ((name_size == 4 && strncasecmp(name, "gzip", 4) == 0) ||
+          (name_size == 6 && strncasecmp(name, "x-gzip", 6) == 0))
+        accept_gzip = true;
+      else if (name_size == 4 && strncasecmp(name, "zstd", 4) == 0)
+        accept_zstd = true;
+    }
+
+    value = token_end != value_end ? token_end + 1 : value_end;
+  }
+
+  if (accept_zstd && compressor_is_supported(ZSTD))
+    return ZSTD;
+
+  if (accept_gzip && compressor_is_supported(GZIP))
+    return GZIP;
+
+  return NONE;
+}
+
+const char*
+ResponseCompressor::encoding_name(Encoding encoding) {
+  switch (encoding) {
+  case GZIP: return "gzip";
+  case ZSTD: return "zstd";
+  default:   return "identity";
+  }
+}
+
+// Compression runs on the RPC thread, so favor speed over ratio, the
+// responses are repetitive enough to shrink well at the fast levels.
+ResponseCompressor::ResponseCompressor(Encoding encoding) :
+  m_encoding(encoding),
+  m_state(std::make_unique<state_type>()) {
+
+  if (!compressor_is_supported(encoding))
+    throw torrent::internal_error("ResponseCompressor::ResponseCompressor(...) unsupported encoding.");
+
+#ifdef HAVE_ZLIB
+  if (encoding == GZIP && deflateInit2(&m_state->zlib, Z_BEST_SPEED, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    throw torrent::local_error("ResponseCompressor::ResponseCompressor(...) could not initialize zlib.");
+#endif
+
+#ifdef HAVE_ZSTD
+  if (encoding == ZSTD && (m_state->zstd = ZSTD_createCCtx()) == NULL)
+    throw torrent::local_error("ResponseCompressor::ResponseCompressor(...) could not initialize zstd.");
+#endif
+}
+
+ResponseCompressor::~ResponseCompressor() {
+#ifdef HAVE_ZLIB
+  if (m_encoding == GZIP)
+    deflateEnd(&m_state->zlib);
+#endif
+
+#ifdef HAVE_ZSTD
+  if (m_encoding == ZSTD)
+    ZSTD_freeCCtx(m_state->zstd);
+#endif
+}
+
+void
+ResponseCompressor::compress(const std::string& input, std::string* output, bool is_last) {
+#ifdef HAVE_ZLIB
+  if (m_encoding == GZIP) {
+    z_stream& stream   = m_state->zlib;
+    size_t    position = output->size();
+
+    stream.next_in  = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+    stream.avail_in = input.size();
+
+    do {
+      output->resize(position + deflateBound(&stream, stream.avail_in) + 16);
+
+      stream.next_out  = reinterpret_cast<Bytef*>(&(*output)[position]);
+      stream.avail_out = output->size() - position;
+
+      int result = deflate(&stream, is_last ? Z_FINISH : Z_SYNC_FLUSH);
+
+      if (result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR)
+        throw torrent::local_error("ResponseCompressor::compress(...) zlib failed.");
+
+      position = output->size() - stream.avail_out;
+
+    } while (stream.avail_out == 0 || stream.avail_in != 0);
+
+    output->resize(position);
+    return;
+  }
+#endif
+
+#ifdef HAVE_ZSTD
+  if (m_encoding == ZSTD) {
+    ZSTD_inBuffer in_buffer{input.data(), input.size(), 0};
+    size_t        position = output->size();
+    size_t        remaining;
+
+    do {
+      output->resize(position + ZSTD_compressBound(in_buffer.size - in_buffer.pos) + 16);
+
+      ZSTD_outBuffer out_buffer{&(*output)[position], output->size() - position, 0};
+
+      remaining = ZSTD_compressStream2(m_state->zstd, &out_buffer, &in_buffer, is_last ? ZSTD_e_end : ZSTD_e_flush);
+
+      if (ZSTD_isError(remaining))
+        throw torrent::local_error("ResponseCompressor::compress(...) zstd failed: " + std::string(ZSTD_getErrorName(remaining)));
+
+      position += out_buffer.pos;
+
+    } while (remaining != 0);
+
+    output->resize(position);
+    return;
+  }
+#endif
+
+  throw torrent::internal_error("ResponseCompressor::compress(...) unsupported encoding.");
+}
+
+} // namespace rpc
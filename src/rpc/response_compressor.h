@@ -0,0 +1,43 @@
+#ifndef RTORRENT_RPC_RESPONSE_COMPRESSOR_H
+#define RTORRENT_RPC_RESPONSE_COMPRESSOR_H
+
+#include <memory>
+#include <string>
+
+namespace rpc {
+
+// Compresses RPC responses with the content coding negotiated from
+// the client's Accept-Encoding header. A response may be compressed
+// in parts, each part is flushed so the client can decode everything
+// it has received so far.
+class ResponseCompressor {
+public:
+  enum Encoding { NONE, GZIP, ZSTD };
+
+  // Picks the preferred encoding supported by both sides, zstd over
+  // gzip, ignoring codings the client refused with 'q=0'.
+  static Encoding     negotiate(const char* value, const char* value_end);
+  static const char*  encoding_name(Encoding encoding);
+
+  ResponseCompressor(Encoding encoding);
+  ~ResponseCompressor();
+
+  Encoding            encoding() const { return m_encoding; }
+
+  // Appends the compressed data to 'output', ending the stream if
+  // 'is_last' is set. Throws local_error if the library fails.
+  void                compress(const std::string& input, std::string* output, bool is_last);
+
+private:
+  ResponseCompressor(const ResponseCompressor&) = delete;
+  ResponseCompressor& operator=(const ResponseCompressor&) = delete;
+
+  struct state_type;
+
+  Encoding                    m_encoding;
+  std::unique_ptr<state_type> m_state;
+};
+
+} // namespace rpc
+
+#endif
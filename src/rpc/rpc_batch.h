@@ -0,0 +1,84 @@
+#ifndef RTORRENT_RPC_RPC_BATCH_H
+#define RTORRENT_RPC_RPC_BATCH_H
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <torrent/object.h>
+
+namespace rpc {
+
+// A decoded RPC request. Requests are processed in three stages so
+// that only the command calls need to run on the main thread:
+//
+// decode:  Parse the request into calls, on the RPC thread.
+// execute: Look up and call the commands, on the main thread.
+// encode:  Serialize the results, on the RPC thread.
+//
+// Errors found while decoding a call are stored in the call and
+// reported by the encoder, errors that make the whole request invalid
+// set the response directly.
+
+// Backend specific position of a response that is encoded in parts.
+struct RpcEncodeState {
+  virtual ~RpcEncodeState() = default;
+};
+
+struct RpcCall {
+  void                set_error(int code, const std::string& msg) { has_error = true; error_code = code; error_message = msg; }
+
+  std::string         method;
+
+  // The first element is the target, if any was supplied.
+  torrent::Object     params{torrent::Object::create_list()};
+
+  // Serialized id, in the encoding of the request.
+  std::string         id{"null"};
+  bool                is_notification{false};
+
+  bool                has_error{false};
+  int                 error_code{0};
+  std::string         error_message;
+
+  // Only report the decoding error if the method exists, to keep the
+  // order of errors the same as when decoding on the main thread.
+  bool                is_error_after_lookup{false};
+
+  // Set once the method has been found, statistics are only kept for
+  // existing methods.
+  bool                is_known_method{false};
+
+  torrent::Object     result;
+
+  std::chrono::steady_clock::duration execute_time{};
+};
+
+struct RpcBatch {
+  void                set_response(std::string&& str) { has_response = true; response = std::move(str); }
+
+  std::vector<RpcCall> calls;
+
+  // JSON-RPC batch or XML-RPC system.multicall.
+  bool                is_multicall{false};
+
+  // Used by backends that cannot decode off the main thread.
+  const char*         request{nullptr};
+  uint32_t            request_length{0};
+
+  bool                has_response{false};
+  std::string         response;
+
+  std::unique_ptr<RpcEncodeState> encode_state;
+
+  // Time spent in each stage, see RpcStats.
+  std::chrono::steady_clock::time_point decode_done{};
+  std::chrono::steady_clock::duration   queue_time{};
+  std::chrono::steady_clock::duration   execute_time{};
+  std::chrono::steady_clock::duration   encode_time{};
+};
+
+} // namespace rpc
+
+#endif
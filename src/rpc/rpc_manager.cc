@@ -1,17 +1,20 @@
 #include "config.h"
 
 #include <cstring>
+#include <vector>
 
 #include <torrent/exceptions.h>
 
 #include "parse_commands.h"
 #include "rpc/rpc_manager.h"
+#include "rpc/subscription_manager.h"
 
 namespace rpc {
 
-CommandMap commands;
-RpcManager rpc;
-ExecFile   execFile;
+CommandMap          commands;
+RpcManager          rpc;
+ExecFile            execFile;
+SubscriptionManager subscriptions;
 
 void
 RpcManager::object_to_target(const torrent::Object& obj, int call_flags, rpc::target_type* target, std::function<void()>* deleter) {
@@ -97,28 +100,127 @@ RpcManager::object_to_target(const torrent::Object& obj, int call_flags, rpc::ta
 
 bool
 RpcManager::process(RPCType type, const char* in_buffer, uint32_t length, slot_response_callback callback) {
+  RpcBatch batch;
+
+  decode(type, in_buffer, length, &batch);
+  execute(type, &batch);
+
+  return callback(encode(type, &batch));
+}
+
+void
+RpcManager::decode(RPCType type, const char* in_buffer, uint32_t length, RpcBatch* batch) {
+  switch (type) {
+  case RPCType::XML:
+    if (m_xmlrpc.is_valid())
+      m_xmlrpc.decode(in_buffer, length, batch);
+    break;
+
+  case RPCType::JSON:
+    m_jsonrpc.decode(in_buffer, length, batch);
+    break;
+
+  case RPCType::BENCODE:
+    m_bencode_rpc.decode(in_buffer, length, batch);
+    break;
+
+  default:
+    throw torrent::input_error("invalid parameters: unknown RPC type");
+  }
+
+  batch->decode_done = std::chrono::steady_clock::now();
+}
+
+void
+RpcManager::execute(RPCType type, RpcBatch* batch) {
+  auto started = std::chrono::steady_clock::now();
+
+  batch->queue_time = started - batch->decode_done;
+
+  execute_backend(type, batch);
+
+  batch->execute_time = std::chrono::steady_clock::now() - started;
+
+  m_stats.record_execute(*batch);
+}
+
+void
+RpcManager::execute_backend(RPCType type, RpcBatch* batch) {
   switch (type) {
   case RPCType::XML:
     // TODO: 'network.rpc.use_xmlrpc' should be a bool in RpcManager, not a command variable.
     if (m_xmlrpc.is_valid() && rpc::call_command_value("network.rpc.use_xmlrpc")) {
-      return m_xmlrpc.process(in_buffer, length, callback);
+      m_xmlrpc.execute(batch);
 
     } else {
-      const std::string response = "<?xml version=\"1.0\"?><methodResponse><fault><value><struct><member><name>faultCode</name><value><i8>-501</i8></value></member><member><name>faultString</name><value><string>XML-RPC not supported</string></value></member></struct></value></fault></methodResponse>";
-      return callback(response.c_str(), response.size());
+      batch->set_response("<?xml version=\"1.0\"?><methodResponse><fault><value><struct><member><name>faultCode</name><value><i8>-501</i8></value></member><member><name>faultString</name><value><string>XML-RPC not supported</string></value></member></struct></value></fault></methodResponse>");
     }
     break;
 
   case RPCType::JSON:
     if (rpc::call_command_value("network.rpc.use_jsonrpc")) {
-      return m_jsonrpc.process(in_buffer, length, callback);
+      m_jsonrpc.execute(batch);
 
     } else {
-      const std::string response = "{\"jsonrpc\":\"2.0\",\"error\":{\"code\":-32601,\"message\":\"JSON-RPC not supported\"},\"id\":null}";
-      return callback(response.c_str(), response.size());
+      batch->set_response("{\"jsonrpc\":\"2.0\",\"error\":{\"code\":-32601,\"message\":\"JSON-RPC not supported\"},\"id\":null}");
     }
     break;
 
+  case RPCType::BENCODE:
+    if (rpc::call_command_value("network.rpc.use_bencode")) {
+      m_bencode_rpc.execute(batch);
+
+    } else {
+      batch->set_response("d5:errord4:codei-32601e7:message25:Bencode RPC not supportedee");
+    }
+    break;
+
+  default:
+    throw torrent::input_error("invalid parameters: unknown RPC type");
+  }
+}
+
+std::string
+RpcManager::encode(RPCType type, RpcBatch* batch) {
+  std::string response;
+
+  while (!encode_partial(type, batch, &response, std::string::npos))
+    ;
+
+  return response;
+}
+
+bool
+RpcManager::encode_partial(RPCType type, RpcBatch* batch, std::string* buffer, size_t max_size) {
+  auto started = std::chrono::steady_clock::now();
+  bool is_done = encode_backend(type, batch, buffer, max_size);
+
+  batch->encode_time += std::chrono::steady_clock::now() - started;
+
+  if (is_done)
+    m_stats.record_encode(*batch);
+
+  return is_done;
+}
+
+bool
+RpcManager::encode_backend(RPCType type, RpcBatch* batch, std::string* buffer, size_t max_size) {
+  if (batch->has_response) {
+    if (buffer->empty())
+      *buffer = std::move(batch->response);
+    else
+      buffer->append(batch->response);
+
+    return true;
+  }
+
+  switch (type) {
+  case RPCType::XML:
+    return m_xmlrpc.encode_partial(batch, buffer, max_size);
+  case RPCType::JSON:
+    return m_jsonrpc.encode_partial(batch, buffer, max_size);
+  case RPCType::BENCODE:
+    return m_bencode_rpc.encode_partial(batch, buffer, max_size);
   default:
     throw torrent::input_error("invalid parameters: unknown RPC type");
   }
@@ -131,6 +233,7 @@ RpcManager::initialize_handlers() {
 
   m_xmlrpc.initialize();
   m_jsonrpc.initialize();
+  m_bencode_rpc.initialize();
 
   m_handlers_initialized = true;
 }
@@ -139,8 +242,13 @@ void
 RpcManager::cleanup() {
   m_handlers_initialized = false;
 
+  std::atomic_store(&m_snapshot, std::shared_ptr<const RpcSnapshot>());
+
+  subscriptions.cleanup();
+
   m_xmlrpc.cleanup();
   m_jsonrpc.cleanup();
+  m_bencode_rpc.cleanup();
 }
 
 bool
@@ -150,6 +258,8 @@ RpcManager::is_type_enabled(RPCType type) const {
     return m_is_xmlrpc_enabled;
   case RPCType::JSON:
     return m_is_jsonrpc_enabled;
+  case RPCType::BENCODE:
+    return m_is_bencode_rpc_enabled;
   default:
     throw torrent::input_error("invalid parameters: unknown RPC type");
   }
@@ -164,15 +274,85 @@ RpcManager::set_type_enabled(RPCType type, bool enabled) {
   case RPCType::JSON:
     m_is_jsonrpc_enabled = enabled;
     break;
+  case RPCType::BENCODE:
+    m_is_bencode_rpc_enabled = enabled;
+    break;
   default:
     throw torrent::input_error("invalid parameters: unknown RPC type");
   }
 }
 
+// Snapshots are published every second while in use, older ones are
+// left unused until the main thread catches up.
+static constexpr auto snapshot_max_age = std::chrono::seconds(2);
+
+bool
+RpcManager::execute_snapshot(RPCType type, RpcBatch* batch) {
+  if (!m_is_snapshot_enabled || batch->has_response || batch->request != nullptr || batch->calls.empty())
+    return false;
+
+  for (const auto& call : batch->calls)
+    if (call.has_error || !RpcSnapshot::is_whitelisted(call.method))
+      return false;
+
+  auto started  = std::chrono::steady_clock::now();
+  auto snapshot = std::atomic_load(&m_snapshot);
+
+  m_is_snapshot_wanted = true;
+
+  if (snapshot == nullptr || started - snapshot->created() > snapshot_max_age || !snapshot->is_type_enabled(type))
+    return false;
+
+  std::vector<torrent::Object> results(batch->calls.size());
+
+  for (size_t i = 0; i != batch->calls.size(); i++)
+    if (!snapshot->lookup(batch->calls[i], &results[i]))
+      return false;
+
+  for (size_t i = 0; i != batch->calls.size(); i++) {
+    batch->calls[i].result          = std::move(results[i]);
+    batch->calls[i].is_known_method = true;
+  }
+
+  batch->queue_time   = started - batch->decode_done;
+  batch->execute_time = std::chrono::steady_clock::now() - started;
+
+  m_stats.record_execute(*batch);
+  return true;
+}
+
+void
+RpcManager::publish_snapshot(core::DownloadList* download_list) {
+  if (!m_is_snapshot_enabled || !m_is_snapshot_wanted.exchange(false))
+    return;
+
+  unsigned int types = 0;
+
+  if (m_xmlrpc.is_valid() && rpc::call_command_value("network.rpc.use_xmlrpc"))
+    types |= 1 << RPCType::XML;
+
+  if (rpc::call_command_value("network.rpc.use_jsonrpc"))
+    types |= 1 << RPCType::JSON;
+
+  if (rpc::call_command_value("network.rpc.use_bencode"))
+    types |= 1 << RPCType::BENCODE;
+
+  std::atomic_store(&m_snapshot, RpcSnapshot::create(++m_snapshot_version, types, download_list));
+}
+
+void
+RpcManager::set_snapshot_enabled(bool v) {
+  m_is_snapshot_enabled = v;
+
+  if (!v)
+    std::atomic_store(&m_snapshot, std::shared_ptr<const RpcSnapshot>());
+}
+
 void
 RpcManager::insert_command(const char* name, const char* parm, const char* doc) {
   m_xmlrpc.insert_command(name, parm, doc);
   m_jsonrpc.insert_command(name, parm, doc);
+  m_bencode_rpc.insert_command(name, parm, doc);
 }
 
 } // namespace rpc
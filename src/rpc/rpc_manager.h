@@ -1,18 +1,26 @@
 #ifndef RTORRENT_RPC_MANAGER_H
 #define RTORRENT_RPC_MANAGER_H
 
+#include <atomic>
 #include <cstdint>
 #include <functional>
+#include <memory>
+#include <string>
 #include <torrent/common.h>
 
+#include "rpc/bencode_rpc.h"
 #include "rpc/command.h"
 #include "rpc/command_map.h"
 #include "rpc/exec_file.h"
 #include "rpc/jsonrpc.h"
+#include "rpc/rpc_batch.h"
+#include "rpc/rpc_snapshot.h"
+#include "rpc/rpc_stats.h"
 #include "rpc/xmlrpc.h"
 
 namespace core {
 class Download;
+class DownloadList;
 }
 
 namespace rpc {
@@ -40,10 +48,11 @@ public:
   using slot_file              = std::function<torrent::File*(core::Download*, uint32_t)>;
   using slot_tracker           = std::function<torrent::tracker::Tracker(core::Download*, uint32_t)>;
   using slot_peer              = std::function<torrent::Peer*(core::Download*, const torrent::HashString&)>;
-  using slot_response_callback = std::function<bool(const char*, uint32_t)>;
+  using slot_response_callback = std::function<bool(std::string&&)>;
 
   enum RPCType { XML,
-                 JSON };
+                 JSON,
+                 BENCODE };
 
   RpcManager()  = default;
   ~RpcManager() = default;
@@ -64,8 +73,33 @@ public:
 
   bool           process(RPCType type, const char* in_buffer, uint32_t length, slot_response_callback callback);
 
+  // Staged processing, only 'execute' must be called from the main
+  // thread. The input buffer must remain valid until 'execute' has
+  // returned.
+  void           decode(RPCType type, const char* in_buffer, uint32_t length, RpcBatch* batch);
+  void           execute(RPCType type, RpcBatch* batch);
+  std::string    encode(RPCType type, RpcBatch* batch);
+
+  // Encode the response in parts of roughly 'max_size' bytes, returns
+  // true when the last part has been appended to 'buffer'.
+  bool           encode_partial(RPCType type, RpcBatch* batch, std::string* buffer, size_t max_size);
+
+  // Answers requests that only call whitelisted read-only methods
+  // from the last published snapshot, on the calling RPC thread.
+  // Returns false if the request must be executed on the main thread.
+  bool           execute_snapshot(RPCType type, RpcBatch* batch);
+
+  // Called periodically from the main thread, only builds a new
+  // snapshot if one was used or asked for since the last call.
+  void           publish_snapshot(core::DownloadList* download_list);
+
+  bool           is_snapshot_enabled() const   { return m_is_snapshot_enabled; }
+  void           set_snapshot_enabled(bool v);
+
   void           insert_command(const char* name, const char* parm, const char* doc);
 
+  RpcStats*      stats() { return &m_stats; }
+
   slot_download& slot_find_download() { return m_slot_find_download; }
   slot_file&     slot_find_file()     { return m_slot_find_file; }
   slot_tracker&  slot_find_tracker()  { return m_slot_find_tracker; }
@@ -74,13 +108,26 @@ public:
   static void    object_to_target(const torrent::Object& obj, int callFlags, rpc::target_type* target, std::function<void()>* deleter);
 
 private:
+  void           execute_backend(RPCType type, RpcBatch* batch);
+  bool           encode_backend(RPCType type, RpcBatch* batch, std::string* buffer, size_t max_size);
+
   XmlRpc        m_xmlrpc;
   JsonRpc       m_jsonrpc;
+  BencodeRpc    m_bencode_rpc;
+  RpcStats      m_stats;
 
   bool          m_handlers_initialized{};
   bool          m_is_jsonrpc_enabled{true};
+  bool          m_is_bencode_rpc_enabled{true};
   bool          m_is_xmlrpc_enabled{true};
 
+  // Accessed with std::atomic_load/store, swapped whole so readers
+  // never see a partially built snapshot.
+  std::shared_ptr<const RpcSnapshot> m_snapshot;
+  uint64_t                           m_snapshot_version{0};
+  std::atomic<bool>                  m_is_snapshot_enabled{true};
+  std::atomic<bool>                  m_is_snapshot_wanted{false};
+
   slot_download m_slot_find_download;
   slot_file     m_slot_find_file;
   slot_tracker  m_slot_find_tracker;
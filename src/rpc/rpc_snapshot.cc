@@ -0,0 +1,154 @@
+#include "config.h"
+
+#include "rpc/rpc_snapshot.h"
+
+#include <cctype>
+#include <torrent/download.h>
+#include <torrent/download_info.h>
+#include <torrent/object.h>
+#include <torrent/rate.h>
+#include <torrent/torrent.h>
+#include <torrent/data/file_list.h>
+#include <torrent/peer/connection_list.h>
+
+#include "core/download.h"
+#include "core/download_list.h"
+#include "rak/string_manip.h"
+#include "rpc/command_map.h"
+#include "rpc/rpc_batch.h"
+#include "rpc/rpc_manager.h"
+
+namespace rpc {
+
+struct snapshot_field {
+  const char* name;
+  int64_t     (*download)(core::Download* d);
+  int64_t     (*global)();
+};
+
+// Same values as the commands, see command_download.cc and
+// command_throttle.cc.
+static const snapshot_field snapshot_fields[] = {
+  { "d.up.rate",         [](core::Download* d) -> int64_t { return d->info()->up_rate()->rate(); }, nullptr },
+  { "d.up.total",        [](core::Download* d) -> int64_t { return d->info()->up_rate()->total(); }, nullptr },
+  { "d.down.rate",       [](core::Download* d) -> int64_t { return d->info()->down_rate()->rate(); }, nullptr },
+  { "d.down.total",      [](core::Download* d) -> int64_t { return d->info()->down_rate()->total(); }, nullptr },
+  { "d.skip.rate",       [](core::Download* d) -> int64_t { return d->info()->skip_rate()->rate(); }, nullptr },
+  { "d.skip.total",      [](core::Download* d) -> int64_t { return d->info()->skip_rate()->total(); }, nullptr },
+  { "d.bytes_done",      [](core::Download* d) -> int64_t { return d->download()->bytes_done(); }, nullptr },
+  { "d.completed_bytes", [](core::Download* d) -> int64_t { return d->file_list()->completed_bytes(); }, nullptr },
+  { "d.left_bytes",      [](core::Download* d) -> int64_t { return d->file_list()->left_bytes(); }, nullptr },
+  { "d.size_bytes",      [](core::Download* d) -> int64_t { return d->file_list()->size_bytes(); }, nullptr },
+  { "d.peers_connected", [](core::Download* d) -> int64_t { return d->connection_list()->size(); }, nullptr },
+  { "d.peers_complete",  [](core::Download* d) -> int64_t { return d->download()->peers_complete(); }, nullptr },
+  { "d.peers_accounted", [](core::Download* d) -> int64_t { return d->download()->peers_accounted(); }, nullptr },
+  { "d.ratio",           [](core::Download* d) -> int64_t { return d->ratio(); }, nullptr },
+
+  { "throttle.global_up.rate",    nullptr, []() -> int64_t { return torrent::up_rate()->rate(); } },
+  { "throttle.global_up.total",   nullptr, []() -> int64_t { return torrent::up_rate()->total(); } },
+  { "throttle.global_down.rate",  nullptr, []() -> int64_t { return torrent::down_rate()->rate(); } },
+  { "throttle.global_down.total", nullptr, []() -> int64_t { return torrent::down_rate()->total(); } },
+};
+
+constexpr size_t snapshot_field_size = sizeof(snapshot_fields) / sizeof(snapshot_fields[0]);
+
+static_assert(snapshot_field_size <= 32, "RpcSnapshot::m_methods too small");
+
+static const snapshot_field*
+snapshot_find_field(const std::string& method) {
+  for (const auto& field : snapshot_fields)
+    if (method == field.name)
+      return &field;
+
+  return nullptr;
+}
+
+RpcSnapshot::RpcSnapshot(uint64_t version, unsigned int types) :
+  m_version(version),
+  m_created(clock_type::now()),
+  m_types(types),
+  m_globals(snapshot_field_size) {
+}
+
+// Must be called from the main thread.
+std::shared_ptr<const RpcSnapshot>
+RpcSnapshot::create(uint64_t version, unsigned int types, core::DownloadList* download_list) {
+  auto snapshot = std::make_shared<RpcSnapshot>(version, types);
+
+  // Skip methods that have been erased or hidden from RPC since
+  // startup, those must fail the same way as on the main thread.
+  for (size_t i = 0; i != snapshot_field_size; i++) {
+    auto itr = commands.find(snapshot_fields[i].name);
+
+    if (itr == commands.end() || !(itr->second.m_flags & CommandMap::flag_public_rpc))
+      continue;
+
+    snapshot->m_methods |= uint32_t{1} << i;
+
+    if (snapshot_fields[i].global != nullptr)
+      snapshot->m_globals[i] = snapshot_fields[i].global();
+  }
+
+  snapshot->m_rows.reserve(download_list->size());
+  snapshot->m_downloads.reserve(download_list->size() * snapshot_field_size);
+
+  for (auto download : *download_list) {
+    snapshot->m_rows.emplace(rak::transform_hex_str(download->info()->hash()), snapshot->m_downloads.size());
+
+    for (const auto& field : snapshot_fields)
+      snapshot->m_downloads.push_back(field.download != nullptr ? field.download(download) : 0);
+  }
+
+  return snapshot;
+}
+
+bool
+RpcSnapshot::is_whitelisted(const std::string& method) {
+  return snapshot_find_field(method) != nullptr;
+}
+
+// Anything unusual, such as extra arguments or an unknown target, is
+// left to the main thread so that errors are reported the same way.
+bool
+RpcSnapshot::lookup(const RpcCall& call, torrent::Object* result) const {
+  auto field = snapshot_find_field(call.method);
+
+  if (field == nullptr || !(m_methods & (uint32_t{1} << (field - snapshot_fields))))
+    return false;
+
+  if (!call.params.is_list() || call.params.as_list().size() > 1)
+    return false;
+
+  const auto& params = call.params.as_list();
+
+  if (!params.empty() && !params.front().is_string())
+    return false;
+
+  const std::string& target = params.empty() ? std::string() : params.front().as_string();
+
+  if (field->global != nullptr) {
+    if (!target.empty())
+      return false;
+
+    *result = m_globals[field - snapshot_fields];
+    return true;
+  }
+
+  if (target.size() != 40)
+    return false;
+
+  std::string key(target);
+
+  for (auto& c : key)
+    c = std::toupper(static_cast<unsigned char>(c));
+
+  auto itr = m_rows.find(key);
+
+  if (itr == m_rows.end())
+    return false;
+
+  *result = m_downloads[itr->second + (field - snapshot_fields)];
+  return true;
+}
+
+} // namespace rpc
@@ -0,0 +1,67 @@
+#ifndef RTORRENT_RPC_RPC_SNAPSHOT_H
+#define RTORRENT_RPC_RPC_SNAPSHOT_H
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace core {
+class DownloadList;
+}
+
+namespace torrent {
+class Object;
+}
+
+namespace rpc {
+
+struct RpcCall;
+
+// Immutable copy of the numeric download and global statistics,
+// built on the main thread and read by the RPC threads without
+// locking.
+//
+// Only fields the client cannot change are whitelisted, so a client
+// never reads back an old value after calling a setter.
+class RpcSnapshot {
+public:
+  using clock_type = std::chrono::steady_clock;
+
+  RpcSnapshot(uint64_t version, unsigned int types);
+
+  static std::shared_ptr<const RpcSnapshot> create(uint64_t version, unsigned int types, core::DownloadList* download_list);
+
+  static bool         is_whitelisted(const std::string& method);
+
+  uint64_t            version() const { return m_version; }
+  clock_type::time_point created() const { return m_created; }
+
+  // Bitmask of the RPC types enabled when the snapshot was built,
+  // indexed by RpcManager::RPCType.
+  bool                is_type_enabled(int type) const { return m_types & (1 << type); }
+
+  // Sets the result of a call to a whitelisted method, returns false
+  // if the call must be executed on the main thread.
+  bool                lookup(const RpcCall& call, torrent::Object* result) const;
+
+private:
+  uint64_t               m_version;
+  clock_type::time_point m_created;
+  unsigned int           m_types;
+
+  // Bitmask of the whitelisted methods that are still public commands.
+  uint32_t               m_methods{0};
+
+  std::vector<int64_t>   m_globals;
+
+  // Rows of download fields, keyed by the upper-case hex info hash.
+  std::unordered_map<std::string, size_t> m_rows;
+  std::vector<int64_t>                    m_downloads;
+};
+
+} // namespace rpc
+
+#endif
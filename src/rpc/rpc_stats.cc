@@ -0,0 +1,140 @@
+#include "config.h"
+
+#include "rpc/rpc_stats.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "rpc/rpc_batch.h"
+
+namespace rpc {
+
+constexpr std::array<int64_t, 6> RpcStats::histogram_bounds_usec;
+
+void
+RpcStats::timing_type::record(duration time) {
+  auto usec = std::chrono::duration_cast<std::chrono::microseconds>(time).count();
+  auto itr  = std::upper_bound(histogram_bounds_usec.begin(), histogram_bounds_usec.end(), usec);
+
+  count++;
+  total += time;
+  max    = std::max(max, time);
+
+  histogram[std::distance(histogram_bounds_usec.begin(), itr)]++;
+}
+
+// Calls to unknown methods are only counted for the request, to avoid
+// clients adding arbitrary entries.
+void
+RpcStats::record_execute(const RpcBatch& batch) {
+  auto lock = std::lock_guard<std::mutex>(m_mutex);
+
+  m_queue.record(batch.queue_time);
+  m_execute.record(batch.execute_time);
+
+  for (const auto& call : batch.calls) {
+    if (!call.is_known_method)
+      continue;
+
+    auto& method = m_methods[call.method];
+
+    if (call.has_error)
+      method.errors++;
+
+    method.execute.record(call.execute_time);
+  }
+}
+
+void
+RpcStats::record_encode(const RpcBatch& batch) {
+  auto lock = std::lock_guard<std::mutex>(m_mutex);
+
+  m_encode.record(batch.encode_time);
+}
+
+void
+RpcStats::reset() {
+  auto lock = std::lock_guard<std::mutex>(m_mutex);
+
+  m_methods.clear();
+
+  m_queue   = timing_type();
+  m_execute = timing_type();
+  m_encode  = timing_type();
+}
+
+static int64_t
+rpc_stats_usec(RpcStats::duration time) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(time).count();
+}
+
+static torrent::Object
+rpc_stats_histogram(const RpcStats::histogram_type& histogram) {
+  auto result = torrent::Object::create_list();
+
+  for (auto count : histogram)
+    result.as_list().push_back((int64_t)count);
+
+  return result;
+}
+
+static void
+rpc_stats_timing(torrent::Object::map_type& map, const std::string& prefix, const RpcStats::timing_type& timing) {
+  map[prefix + "_total_usec"] = rpc_stats_usec(timing.total);
+  map[prefix + "_max_usec"]   = rpc_stats_usec(timing.max);
+  map[prefix + "_histogram"]  = rpc_stats_histogram(timing.histogram);
+}
+
+torrent::Object
+RpcStats::methods_to_object() {
+  auto lock   = std::lock_guard<std::mutex>(m_mutex);
+  auto result = torrent::Object::create_list();
+
+  std::vector<const std::pair<const std::string, method_type>*> methods;
+  methods.reserve(m_methods.size());
+
+  for (const auto& method : m_methods)
+    methods.push_back(&method);
+
+  std::sort(methods.begin(), methods.end(), [](auto a, auto b) { return a->first < b->first; });
+
+  for (auto method : methods) {
+    auto  entry = torrent::Object::create_map();
+    auto& map   = entry.as_map();
+
+    map["method"] = method->first;
+    map["calls"]  = (int64_t)method->second.execute.count;
+    map["errors"] = (int64_t)method->second.errors;
+
+    rpc_stats_timing(map, "execute", method->second.execute);
+
+    result.as_list().push_back(std::move(entry));
+  }
+
+  return result;
+}
+
+torrent::Object
+RpcStats::requests_to_object() {
+  auto lock   = std::lock_guard<std::mutex>(m_mutex);
+  auto result = torrent::Object::create_map();
+  auto& map   = result.as_map();
+
+  map["requests"] = (int64_t)m_execute.count;
+  map["encoded"]  = (int64_t)m_encode.count;
+
+  rpc_stats_timing(map, "queue", m_queue);
+  rpc_stats_timing(map, "execute", m_execute);
+  rpc_stats_timing(map, "encode", m_encode);
+
+  auto bounds = torrent::Object::create_list();
+
+  for (auto bound : histogram_bounds_usec)
+    bounds.as_list().push_back(bound);
+
+  map["histogram_bounds_usec"] = bounds;
+
+  return result;
+}
+
+} // namespace rpc
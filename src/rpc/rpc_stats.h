@@ -0,0 +1,69 @@
+#ifndef RTORRENT_RPC_RPC_STATS_H
+#define RTORRENT_RPC_RPC_STATS_H
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <torrent/object.h>
+
+namespace rpc {
+
+struct RpcBatch;
+
+// Per-method call statistics and the time spent in each stage of a
+// request. Requests are recorded from both the main thread, for the
+// command calls, and the RPC threads, for encoding.
+//
+// queue:   From the end of decoding until the main thread starts
+//          executing the request.
+// execute: Command calls on the main thread.
+// encode:  Serializing the response, including all streamed parts.
+class RpcStats {
+public:
+  using duration = std::chrono::steady_clock::duration;
+
+  // Upper bounds of the latency histogram buckets, the last bucket
+  // holds everything slower.
+  static constexpr std::array<int64_t, 6> histogram_bounds_usec{{10, 100, 1000, 10000, 100000, 1000000}};
+
+  using histogram_type = std::array<uint64_t, histogram_bounds_usec.size() + 1>;
+
+  struct timing_type {
+    void               record(duration time);
+
+    uint64_t           count{0};
+    duration           total{};
+    duration           max{};
+    histogram_type     histogram{};
+  };
+
+  struct method_type {
+    uint64_t           errors{0};
+    timing_type        execute;
+  };
+
+  void                 record_execute(const RpcBatch& batch);
+  void                 record_encode(const RpcBatch& batch);
+
+  void                 reset();
+
+  // Lists the methods sorted by name.
+  torrent::Object      methods_to_object();
+  torrent::Object      requests_to_object();
+
+private:
+  std::mutex                                   m_mutex;
+
+  std::unordered_map<std::string, method_type> m_methods;
+
+  timing_type          m_queue;
+  timing_type          m_execute;
+  timing_type          m_encode;
+};
+
+} // namespace rpc
+
+#endif
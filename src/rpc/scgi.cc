@@ -1,6 +1,7 @@
 #include "config.h"
 
 #include <cassert>
+#include <future>
 #include <sys/un.h>
 #include <torrent/connection_manager.h>
 #include <torrent/torrent.h>
@@ -23,9 +24,39 @@ SCgi::~SCgi() {
   if (!get_fd().is_valid())
     return;
 
-  for (SCgiTask* itr = m_task, *last = m_task + max_tasks; itr != last; ++itr)
-    if (itr->is_open())
-      itr->close();
+  // The listener is closed below, don't resume accepting.
+  m_throttled = false;
+
+  // Tasks owned by worker threads can only be closed on their own
+  // thread, so wait for each running worker to close them before the
+  // pools are freed. Stopped workers no longer poll, only the sockets
+  // need closing.
+  for (auto& pool : m_pools) {
+    if (pool->thread == torrent::this_thread::thread()) {
+      close_tasks(pool.get());
+      continue;
+    }
+
+    if (!pool->thread->is_active()) {
+      for (auto& task : pool->tasks)
+        if (task->is_open())
+          task->get_fd().close();
+
+      continue;
+    }
+
+    pool->thread->cancel_callback_and_wait(this);
+
+    std::promise<void> closed;
+    auto               pool_ptr = pool.get();
+
+    pool->thread->callback_interrupt_pollling(this, [this, pool_ptr, &closed]() {
+        close_tasks(pool_ptr);
+        closed.set_value();
+      });
+
+    closed.get_future().wait();
+  }
 
   deactivate();
   torrent::connection_manager()->dec_socket_count();
@@ -69,13 +100,21 @@ SCgi::open_named(const std::string& filename) {
   m_path = filename;
 }
 
+void
+SCgi::set_max_tasks(unsigned int size) {
+  if (size == 0 || size > (1 << 16))
+    throw torrent::input_error("Invalid number of SCGI tasks.");
+
+  m_max_tasks = size;
+}
+
 void
 SCgi::open(void* sa, unsigned int length) {
   try {
     if (!get_fd().set_nonblock() ||
         !get_fd().set_reuse_address(true) ||
         !get_fd().bind_sa(reinterpret_cast<sockaddr*>(sa), length) ||
-        !get_fd().listen(max_tasks))
+        !get_fd().listen(m_max_tasks))
       throw torrent::resource_error("Could not prepare socket for listening: " + std::string(std::strerror(errno)));
 
     torrent::connection_manager()->inc_socket_count();
@@ -94,6 +133,12 @@ void
 SCgi::activate() {
   assert(torrent::this_thread::thread() == scgi_thread::thread());
 
+  m_pools.clear();
+  m_pools.push_back(std::make_unique<TaskPool>(TaskPool{torrent::this_thread::thread(), {}, {}}));
+
+  for (auto thread : scgi_thread::workers())
+    m_pools.push_back(std::make_unique<TaskPool>(TaskPool{thread, {}, {}}));
+
   torrent::this_thread::poll()->open(this);
   torrent::this_thread::poll()->insert_read(this);
   torrent::this_thread::poll()->insert_error(this);
@@ -106,9 +151,27 @@ SCgi::deactivate() {
   torrent::this_thread::poll()->remove_and_close(this);
 }
 
+// Pending connections are left in the listen queue while all tasks
+// are busy, the listener is re-enabled by release_task().
 void
 SCgi::event_read() {
   while (true) {
+    if (m_in_flight >= m_max_tasks) {
+      torrent::this_thread::poll()->remove_read(this);
+      m_throttled = true;
+
+      // A worker thread may have released a task before the flag was
+      // set, in which case it did not ask us to resume.
+      if (m_in_flight >= m_max_tasks) {
+        m_rejected++;
+        close_idle_tasks();
+        break;
+      }
+
+      torrent::this_thread::poll()->insert_read(this);
+      m_throttled = false;
+    }
+
     int fd = torrent::fd_accept(get_fd().get_fd());
 
     if (fd == -1) {
@@ -118,17 +181,94 @@ SCgi::event_read() {
       throw torrent::resource_error("Listener port accept() failed: " + std::string(std::strerror(errno)));
     }
 
-    SCgiTask* task = std::find_if(m_task, m_task + max_tasks, std::mem_fn(&SCgiTask::is_available));
+    m_accepted++;
+    m_in_flight++;
 
-    if (task == m_task + max_tasks) {
-      torrent::fd_close(fd);
-      continue;
-    }
+    TaskPool* pool = m_pools[m_next_pool++ % m_pools.size()].get();
+
+    if (pool->thread == torrent::this_thread::thread())
+      open_task(pool, fd);
+    else
+      pool->thread->callback_interrupt_pollling(this, [this, pool, fd]() { open_task(pool, fd); });
+  }
+}
 
-    task->open(this, fd);
+void
+SCgi::open_task(TaskPool* pool, int fd) {
+  SCgiTask* task;
+
+  if (pool->free_tasks.empty()) {
+    pool->tasks.push_back(std::make_unique<SCgiTask>());
+    task = pool->tasks.back().get();
+  } else {
+    task = pool->free_tasks.back();
+    pool->free_tasks.pop_back();
+  }
+
+  task->open(this, fd);
+}
+
+void
+SCgi::close_tasks(TaskPool* pool) {
+  for (auto& task : pool->tasks)
+    if (task->is_open())
+      task->close();
+}
+
+// Make room for new connections by dropping keep-alive connections
+// that are waiting for their next request, the released tasks resume
+// accepting.
+void
+SCgi::close_idle_tasks() {
+  for (auto& pool : m_pools) {
+    auto pool_ptr = pool.get();
+
+    if (pool->thread == torrent::this_thread::thread())
+      close_idle_tasks(pool_ptr);
+    else
+      pool->thread->callback_interrupt_pollling(this, [this, pool_ptr]() { close_idle_tasks(pool_ptr); });
   }
 }
 
+void
+SCgi::close_idle_tasks(TaskPool* pool) {
+  for (auto& task : pool->tasks)
+    if (task->is_idle())
+      task->close();
+}
+
+SCgi::TaskPool*
+SCgi::current_pool() {
+  for (auto& pool : m_pools)
+    if (pool->thread == torrent::this_thread::thread())
+      return pool.get();
+
+  throw torrent::internal_error("SCgi::current_pool() called from a thread without a task pool.");
+}
+
+void
+SCgi::release_task(SCgiTask* task) {
+  current_pool()->free_tasks.push_back(task);
+  m_in_flight--;
+
+  if (!m_throttled)
+    return;
+
+  if (torrent::this_thread::thread() == scgi_thread::thread())
+    resume_accept();
+  else
+    scgi_thread::thread()->callback_interrupt_pollling(this, [this]() { resume_accept(); });
+}
+
+void
+SCgi::resume_accept() {
+  if (!m_throttled)
+    return;
+
+  torrent::this_thread::poll()->insert_read(this);
+  m_throttled = false;
+}
+
 void
 SCgi::event_write() {
   throw torrent::internal_error("Listener does not support write().");
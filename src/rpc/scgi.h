@@ -1,8 +1,12 @@
 #ifndef RTORRENT_RPC_SCGI_H
 #define RTORRENT_RPC_SCGI_H
 
+#include <atomic>
 #include <functional>
+#include <memory>
+#include <vector>
 #include <torrent/event.h>
+#include <torrent/common.h>
 
 #include "rpc/scgi_task.h"
 #include "utils/socket_fd.h"
@@ -15,7 +19,10 @@ namespace rpc {
 
 class SCgi : public torrent::Event {
 public:
-  static const int max_tasks = 100;
+  static const unsigned int default_max_tasks = 100;
+  static const uint32_t     default_compress_min_size = (64 << 10);
+
+  enum Protocol { SCGI, HTTP };
 
   ~SCgi() override;
 
@@ -29,9 +36,45 @@ public:
 
   const std::string&  path() const { return m_path; }
 
+  // HTTP listeners accept plain HTTP/1.1 POST requests and decide on
+  // keep-alive per request.
+  Protocol            protocol() const                 { return m_protocol; }
+  void                set_protocol(Protocol protocol)  { m_protocol = protocol; }
+
   int                 log_fd() const     { return m_logFd; }
   void                set_log_fd(int fd) { m_logFd = fd; }
 
+  // Keep-alive connections are not closed after the response has
+  // been sent, allowing clients to pipeline requests on the same
+  // socket. Must be set before the listener is activated.
+  bool                is_keep_alive() const            { return m_keep_alive; }
+  void                set_keep_alive(bool keep_alive)  { m_keep_alive = keep_alive; }
+
+  // Responses of at least this many bytes are compressed if the
+  // client accepts gzip or zstd, zero disables compression.
+  uint32_t            compress_min_size() const            { return m_compress_min_size; }
+  void                set_compress_min_size(uint32_t size) { m_compress_min_size = size; }
+
+  // Tasks are allocated on demand up to this ceiling, after which the
+  // listener stops accepting until a connection closes. Must be set
+  // before the socket is opened. The ceiling is shared by all threads
+  // serving the listener.
+  unsigned int        max_tasks() const                { return m_max_tasks; }
+  void                set_max_tasks(unsigned int size);
+
+  // Counters may be read from any thread. Accepts are rejected when
+  // every task is in use, the connections wait in the backlog until a
+  // task is released. Errors are requests that could not be parsed.
+  uint64_t            accepted() const   { return m_accepted; }
+  uint64_t            rejected() const   { return m_rejected; }
+  uint64_t            errors() const     { return m_errors; }
+  unsigned int        in_flight() const  { return m_in_flight; }
+
+  void                receive_error()    { m_errors++; }
+
+  // Called from the thread that owns the task.
+  void                release_task(SCgiTask* task);
+
   void                event_read() override;
   void                event_write() override;
   void                event_error() override;
@@ -39,11 +82,39 @@ public:
   utils::SocketFd&    get_fd()            { return *reinterpret_cast<utils::SocketFd*>(&m_fileDesc); }
 
 private:
+  // Connections are accepted on the SCGI thread and handed off
+  // round-robin to the SCGI worker threads. Each pool is only used by
+  // its own thread.
+  struct TaskPool {
+    torrent::utils::Thread*                thread;
+    std::vector<std::unique_ptr<SCgiTask>> tasks;
+    std::vector<SCgiTask*>                 free_tasks;
+  };
+
   void                open(void* sa, unsigned int length);
+  void                open_task(TaskPool* pool, int fd);
+  void                resume_accept();
+
+  void                close_tasks(TaskPool* pool);
+  void                close_idle_tasks();
+  void                close_idle_tasks(TaskPool* pool);
+  TaskPool*           current_pool();
 
   std::string         m_path;
-  int                 m_logFd{-1};
-  SCgiTask            m_task[max_tasks];
+  std::atomic<int>    m_logFd{-1};
+  Protocol            m_protocol{SCGI};
+  bool                m_keep_alive{false};
+  uint32_t            m_compress_min_size{default_compress_min_size};
+  std::atomic<bool>   m_throttled{false};
+  unsigned int        m_max_tasks{default_max_tasks};
+
+  std::vector<std::unique_ptr<TaskPool>> m_pools;
+  unsigned int                           m_next_pool{0};
+
+  std::atomic<uint64_t>     m_accepted{0};
+  std::atomic<uint64_t>     m_rejected{0};
+  std::atomic<uint64_t>     m_errors{0};
+  std::atomic<unsigned int> m_in_flight{0};
 };
 
 }
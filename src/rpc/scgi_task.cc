@@ -3,10 +3,14 @@
 #include "rpc/scgi_task.h"
 
 #include <rak/error_number.h>
+#include <algorithm>
 #include <cstdio>
+#include <cstring>
+#include <strings.h>
 #include <vector>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <torrent/exceptions.h>
 #include <torrent/torrent.h>
 #include <torrent/net/poll.h>
@@ -17,10 +21,17 @@
 #include "globals.h"
 #include "scgi.h"
 #include "rpc/parse_commands.h"
+#include "rpc/rpc_batch.h"
+#include "rpc/subscription_manager.h"
 #include "utils/socket_fd.h"
 
 namespace rpc {
 
+SCgiTask::SCgiTask() {
+  m_fileDesc = -1;
+  m_task_timeout.slot() = [this] { receive_timeout(); };
+}
+
 void
 SCgiTask::open(SCgi* parent, int fd) {
   m_parent      = parent;
@@ -29,10 +40,16 @@ SCgiTask::open(SCgi* parent, int fd) {
   m_buffer_size = default_buffer_size;
   m_position    = m_buffer;
   m_body        = NULL;
+  m_keep_alive  = parent->is_keep_alive();
+  m_idle        = false;
+
+  m_pending.clear();
 
   torrent::this_thread::poll()->open(this);
   torrent::this_thread::poll()->insert_read(this);
   torrent::this_thread::poll()->insert_error(this);
+
+  torrent::this_thread::scheduler()->update_wait_for(&m_task_timeout, read_timeout);
 }
 
 void
@@ -40,9 +57,16 @@ SCgiTask::close() {
   if (!get_fd().is_valid())
     return;
 
+  // A main thread callback that is already running may still hold the
+  // request, and a held request may be woken before it is dropped, so
+  // cancel the callbacks again once no request is held.
+  torrent::main_thread::thread()->cancel_callback_and_wait(this);
+  subscriptions.cancel(this);
   torrent::main_thread::thread()->cancel_callback_and_wait(this);
   torrent::utils::Thread::self()->cancel_callback(this);
 
+  torrent::this_thread::scheduler()->erase(&m_task_timeout);
+
   torrent::this_thread::poll()->remove_and_close(this);
 
   get_fd().close();
@@ -52,6 +76,16 @@ SCgiTask::close() {
 
   delete[] m_buffer;
   m_buffer = NULL;
+
+  m_response.clear();
+  m_response.shrink_to_fit();
+  m_header_size   = 0;
+  m_response_sent = 0;
+
+  m_stream_batch.reset();
+  m_compressor.reset();
+
+  m_parent->release_task(this);
 }
 
 void
@@ -68,6 +102,17 @@ SCgiTask::event_read() {
   // The buffer has space to nul-terminate to ease the parsing below.
   m_position += bytes;
   *m_position = '\0';
+  m_idle      = false;
+
+  torrent::this_thread::scheduler()->update_wait_for(&m_task_timeout, read_timeout);
+
+  parse_request();
+}
+
+void
+SCgiTask::parse_request() {
+  if (m_parent->protocol() == SCgi::HTTP)
+    return parse_http_request();
 
   if (m_body == NULL) {
     // Don't bother caching the parsed values, as we're likely to
@@ -96,6 +141,8 @@ SCgiTask::event_read() {
     size_t      content_length = 0;
     const char* header_end     = current + header_size;
 
+    m_accept_encoding = ResponseCompressor::NONE;
+
     // Parse out the null-terminated header keys and values, with
     // checks to ensure it doesn't scan beyond the limits of the
     // header
@@ -126,6 +173,8 @@ SCgiTask::event_read() {
           goto event_read_failed;
       } else if (strcmp(key, "CONTENT_TYPE") == 0) {
         content_type = value;
+      } else if (strcmp(key, "HTTP_ACCEPT_ENCODING") == 0) {
+        m_accept_encoding = ResponseCompressor::negotiate(value, value_end);
       }
     }
 
@@ -141,28 +190,60 @@ SCgiTask::event_read() {
     if (!detect_content_type(content_type))
       goto event_read_failed;
 
-    if ((unsigned int)(content_length + header_size) < m_buffer_size) {
-      m_buffer_size = content_length + header_size;
+    prepare_body(content_length);
+  }
 
-    } else if ((unsigned int)content_length <= default_buffer_size) {
-      m_buffer_size = content_length;
+  complete_request();
+  return;
 
-      std::memmove(m_buffer, m_body, std::distance(m_body, m_position));
-      m_position = m_buffer + std::distance(m_body, m_position);
-      m_body     = m_buffer;
+event_read_failed:
+  //   throw torrent::internal_error("SCgiTask::parse_request() fault not handled.");
+  m_parent->receive_error();
+  close();
+}
 
-    } else {
-      realloc_buffer((m_buffer_size = content_length) + 1, m_body, std::distance(m_body, m_position));
+// Size the buffer to hold exactly the header and a body of
+// 'content_length' bytes, moving the body to the start of the buffer
+// if the header and body don't fit together.
+void
+SCgiTask::prepare_body(size_t content_length) {
+  unsigned int header_size = std::distance(m_buffer, m_body);
 
-      m_position = m_buffer + std::distance(m_body, m_position);
-      m_body     = m_buffer;
-    }
+  if ((unsigned int)(content_length + header_size) < m_buffer_size) {
+    m_buffer_size = content_length + header_size;
+
+  } else if ((unsigned int)content_length <= default_buffer_size) {
+    m_buffer_size = content_length;
+
+    std::memmove(m_buffer, m_body, std::distance(m_body, m_position));
+    m_position = m_buffer + std::distance(m_body, m_position);
+    m_body     = m_buffer;
+
+  } else {
+    realloc_buffer((m_buffer_size = content_length) + 1, m_body, std::distance(m_body, m_position));
+
+    m_position = m_buffer + std::distance(m_body, m_position);
+    m_body     = m_buffer;
   }
+}
 
-  if ((unsigned int)std::distance(m_buffer, m_position) != m_buffer_size)
+void
+SCgiTask::complete_request() {
+  if ((unsigned int)std::distance(m_buffer, m_position) < m_buffer_size)
     return;
 
+  // Pipelined requests may arrive in the same read as the tail of the
+  // current one, keep those bytes until the response has been sent.
+  if ((unsigned int)std::distance(m_buffer, m_position) > m_buffer_size) {
+    if (m_keep_alive)
+      m_pending.assign(m_buffer + m_buffer_size, m_position);
+
+    m_position = m_buffer + m_buffer_size;
+    *m_position = '\0';
+  }
+
   torrent::this_thread::poll()->remove_read(this);
+  torrent::this_thread::scheduler()->erase(&m_task_timeout);
 
   if (m_parent->log_fd() >= 0) {
     [[maybe_unused]] int result;
@@ -176,21 +257,217 @@ SCgiTask::event_read() {
   lt_log_print_dump(torrent::LOG_RPC_DUMP, m_body, m_buffer_size - std::distance(m_buffer, m_body), "scgi", "RPC read.", 0);
 
   receive_call(m_body, m_buffer_size - std::distance(m_buffer, m_body));
-  return;
+}
 
-event_read_failed:
-  //   throw torrent::internal_error("SCgiTask::event_read() fault not handled.");
-  close();
+// Grow the buffer while keeping the header and any partial body,
+// returns false if the new size would exceed 'max_size'.
+bool
+SCgiTask::grow_buffer(unsigned int max_size) {
+  if (m_buffer_size >= max_size)
+    return false;
+
+  unsigned int size     = std::min(m_buffer_size * 2 + 1, max_size);
+  auto         position = std::distance(m_buffer, m_position);
+  auto         body     = m_body != NULL ? std::distance(m_buffer, m_body) : -1;
+
+  realloc_buffer(size + 1, m_buffer, position + 1);
+
+  m_buffer_size = size;
+  m_position    = m_buffer + position;
+  m_body        = body != -1 ? m_buffer + body : NULL;
+  return true;
+}
+
+// Requests are accepted with either a Content-Length or a chunked
+// body, and responses always carry a Content-Length. HTTP/1.1
+// connections are kept alive unless the client asks otherwise.
+void
+SCgiTask::parse_http_request() {
+  if (m_body == NULL) {
+    auto header_end = static_cast<char*>(memmem(m_buffer, std::distance(m_buffer, m_position), "\r\n\r\n", 4));
+
+    if (header_end == NULL) {
+      if ((unsigned int)std::distance(m_buffer, m_position) == m_buffer_size && !grow_buffer(max_http_header_size))
+        return http_error("431 Request Header Fields Too Large");
+
+      return;
+    }
+
+    if (auto status = m_http_request.parse_header(m_buffer, header_end, max_content_size))
+      return http_error(status);
+
+    m_keep_alive      = m_http_request.keep_alive;
+    m_accept_encoding = m_http_request.accept_encoding;
+    m_chunked_body.reset();
+
+    m_body = header_end + 4;
+
+    if (!m_http_request.chunked)
+      prepare_body(m_http_request.content_length);
+  }
+
+  if (m_http_request.chunked && !decode_chunked_body())
+    return;
+
+  if ((unsigned int)std::distance(m_buffer, m_position) < m_buffer_size) {
+    send_continue();
+    return;
+  }
+
+  if (!detect_content_type(m_http_request.content_type))
+    return http_error("415 Unsupported Media Type");
+
+  complete_request();
+}
+
+// Wait for the whole chunked body and then decode it in place. The
+// buffer grows as needed, leaving room to read until the final chunk
+// has arrived. Returns false while the body is incomplete.
+bool
+SCgiTask::decode_chunked_body() {
+  switch (m_chunked_body.parse(m_body, m_position, max_content_size)) {
+  case HttpChunkedBody::COMPLETE:
+    break;
+
+  case HttpChunkedBody::BAD_REQUEST:
+    http_error("400 Bad Request");
+    return false;
+
+  case HttpChunkedBody::TOO_LARGE:
+    http_error("413 Payload Too Large");
+    return false;
+
+  case HttpChunkedBody::INCOMPLETE:
+    send_continue();
+
+    if ((unsigned int)std::distance(m_buffer, m_position) == m_buffer_size &&
+        !grow_buffer(max_content_size + std::distance(m_buffer, m_body) + max_http_header_size))
+      http_error("413 Payload Too Large");
+
+    return false;
+  }
+
+  char*  target    = m_body + m_chunked_body.decode(m_body);
+  char*  next      = m_body + m_chunked_body.end();
+  size_t remaining = std::distance(next, m_position);
+
+  std::memmove(target, next, remaining);
+
+  m_buffer_size = std::distance(m_buffer, target);
+  m_position    = target + remaining;
+  *m_position   = '\0';
+
+  return true;
+}
+
+// Ask a client that sent 'Expect: 100-continue' for the rest of the
+// body, once the headers have been accepted.
+void
+SCgiTask::send_continue() {
+  static const char continue_response[] = "HTTP/1.1 100 Continue\r\n\r\n";
+
+  if (!m_http_request.expect_continue)
+    return;
+
+  // The status line is short enough to always fit in the socket
+  // buffer of a new connection, so the result is ignored.
+#if defined(__APPLE__) || defined(__sun__)
+  [[maybe_unused]] auto result = ::send(m_fileDesc, continue_response, sizeof(continue_response) - 1, 0);
+#else
+  [[maybe_unused]] auto result = ::send(m_fileDesc, continue_response, sizeof(continue_response) - 1, MSG_NOSIGNAL);
+#endif
+  m_http_request.expect_continue = false;
+}
+
+// Send an error status and close the connection.
+void
+SCgiTask::http_error(const char* status) {
+  m_parent->receive_error();
+
+  torrent::this_thread::poll()->remove_read(this);
+  torrent::this_thread::scheduler()->erase(&m_task_timeout);
+
+  auto lock = std::lock_guard<std::mutex>(m_result_mutex);
+
+  int header_size = snprintf(m_header, max_response_header_size,
+                             "HTTP/1.1 %s\r\nContent-Length: 0\r\nConnection: close\r\n\r\n", status);
+
+  if (header_size <= 0 || header_size >= max_response_header_size)
+    throw torrent::internal_error("SCgiTask::http_error(...) could not format header.");
+
+  m_keep_alive    = false;
+  m_header_size   = header_size;
+  m_response_sent = 0;
+  m_response.clear();
+
+  torrent::this_thread::poll()->insert_write(this);
+}
+
+// Prepare a keep-alive connection for the next request, feeding it
+// any pipelined data that was received along with the last one.
+void
+SCgiTask::next_request() {
+  torrent::this_thread::poll()->remove_write(this);
+
+  {
+    auto lock = std::lock_guard<std::mutex>(m_result_mutex);
+
+    delete[] m_buffer;
+
+    // The pending data can be larger than the default buffer when
+    // the previous request needed a larger header or chunked body.
+    m_buffer_size = m_pending.size() > default_buffer_size ? m_pending.size() : default_buffer_size;
+    m_buffer      = new char[m_buffer_size + 1];
+    m_position    = m_buffer;
+    m_body        = NULL;
+
+    m_response.clear();
+    m_response.shrink_to_fit();
+    m_header_size   = 0;
+    m_response_sent = 0;
+  }
+
+  if (m_parent->protocol() == SCgi::SCGI)
+    m_keep_alive = m_parent->is_keep_alive();
+
+  std::memcpy(m_buffer, m_pending.c_str(), m_pending.size());
+  m_position += m_pending.size();
+  *m_position = '\0';
+
+  m_pending.clear();
+  m_idle = m_position == m_buffer;
+
+  torrent::this_thread::poll()->insert_read(this);
+  torrent::this_thread::scheduler()->update_wait_for(&m_task_timeout, read_timeout);
+
+  if (m_position != m_buffer)
+    parse_request();
 }
 
 void
 SCgiTask::event_write() {
+  struct iovec iov[2];
+  int          iov_count = 0;
+  size_t       total     = m_header_size + m_response.size();
+
+  if (m_response_sent < m_header_size)
+    iov[iov_count++] = { m_header + m_response_sent, m_header_size - m_response_sent };
+
+  size_t body_sent = m_response_sent > m_header_size ? m_response_sent - m_header_size : 0;
+
+  if (body_sent < m_response.size())
+    iov[iov_count++] = { m_response.data() + body_sent, m_response.size() - body_sent };
+
+  struct msghdr msg{};
+  msg.msg_iov    = iov;
+  msg.msg_iovlen = iov_count;
+
 // Apple and Solaris do not support MSG_NOSIGNAL,
 // so disable this fix until we find a better solution
 #if defined(__APPLE__) || defined(__sun__)
-  int bytes = ::send(m_fileDesc, m_position, m_buffer_size, 0);
+  ssize_t bytes = ::sendmsg(m_fileDesc, &msg, 0);
 #else
-  int bytes = ::send(m_fileDesc, m_position, m_buffer_size, MSG_NOSIGNAL);
+  ssize_t bytes = ::sendmsg(m_fileDesc, &msg, MSG_NOSIGNAL);
 #endif
 
   if (bytes == -1) {
@@ -200,11 +477,21 @@ SCgiTask::event_write() {
     return;
   }
 
-  m_position += bytes;
-  m_buffer_size -= bytes;
+  m_response_sent += bytes;
 
-  if (bytes == 0 || m_buffer_size == 0)
+  if (bytes == 0)
     return close();
+
+  if (m_response_sent != total)
+    return;
+
+  if (m_stream_batch)
+    return next_stream_part();
+
+  if (!m_keep_alive)
+    return close();
+
+  next_request();
 }
 
 void
@@ -212,6 +499,11 @@ SCgiTask::event_error() {
   close();
 }
 
+void
+SCgiTask::receive_timeout() {
+  close();
+}
+
 static inline bool
 scgi_match_content_type(const std::string& content_type, const char* type) {
   std::string::size_type pos = content_type.find_first_of(" ;");
@@ -226,9 +518,12 @@ bool
 SCgiTask::detect_content_type(const std::string& content_type) {
   if (content_type.empty()) {
     // If no CONTENT_TYPE was supplied, peek at the body to check if it's JSON
-    // { is a single request object, while [ is a batch array
+    // { is a single request object, while [ is a batch array, the
+    // same goes for bencode dictionaries and lists
     if (*m_body == '{' || *m_body == '[')
       m_content_type = ContentType::JSON;
+    else if (*m_body == 'd' || *m_body == 'l')
+      m_content_type = ContentType::BENCODE;
     else
       m_content_type = ContentType::XML;
 
@@ -238,6 +533,9 @@ SCgiTask::detect_content_type(const std::string& content_type) {
   } else if (scgi_match_content_type(content_type, "text/xml")) {
     m_content_type = ContentType::XML;
 
+  } else if (scgi_match_content_type(content_type, "application/x-bencode")) {
+    m_content_type = ContentType::BENCODE;
+
   } else {
     // If the content type is not JSON or XML, we don't know how to handle it.
     return false;
@@ -252,86 +550,252 @@ SCgiTask::realloc_buffer(uint32_t size, const char* buffer, uint32_t bufferSize)
   char* tmp = new char[size];
 
   std::memcpy(tmp, buffer, bufferSize);
-  ::free(m_buffer);
+  delete[] m_buffer;
   m_buffer = tmp;
 }
 
+static const char*
+scgi_content_type_name(SCgiTask::ContentType content_type) {
+  switch (content_type) {
+  case rpc::SCgiTask::ContentType::JSON:
+    return "application/json";
+  case rpc::SCgiTask::ContentType::BENCODE:
+    return "application/x-bencode";
+  default:
+    return "text/xml";
+  }
+}
+
+// The request is decoded and the response encoded on the SCGI thread,
+// only the command calls are run on the main thread.
+static RpcManager::RPCType
+scgi_rpc_type(SCgiTask::ContentType content_type) {
+  switch (content_type) {
+  case rpc::SCgiTask::ContentType::JSON:
+    return RpcManager::RPCType::JSON;
+  case rpc::SCgiTask::ContentType::XML:
+    return RpcManager::RPCType::XML;
+  case rpc::SCgiTask::ContentType::BENCODE:
+    return RpcManager::RPCType::BENCODE;
+  default:
+    throw torrent::internal_error("SCgiTask::receive_call(...) received bad input.");
+  }
+}
+
 void
 SCgiTask::receive_call(const char* buffer, uint32_t length) {
-  // TODO: Rewrite RpcManager.process to pass the result buffer instead of having to copy it.
-
+  auto type        = scgi_rpc_type(content_type());
   auto scgi_thread = torrent::utils::Thread::self();
+  auto batch       = std::make_shared<RpcBatch>();
 
-  auto result_callback = [this, scgi_thread](const char* b, uint32_t l) {
-      receive_write(b, l);
-
-      scgi_thread->callback_interrupt_pollling(this, [this]() {
-          // Only need to lock once here as a memory barrier.
-          m_result_mutex.lock();
-          m_result_mutex.unlock();
+  rpc.decode(type, buffer, length, batch.get());
 
-          torrent::this_thread::poll()->insert_write(this);
-        });
-    };
+  if (rpc.execute_snapshot(type, batch.get())) {
+    receive_response(batch);
+    torrent::this_thread::poll()->insert_write(this);
+    return;
+  }
 
   auto lock = std::lock_guard<std::mutex>(m_result_mutex);
 
-  switch (content_type()) {
-  case rpc::SCgiTask::ContentType::JSON:
-    torrent::main_thread::thread()->callback_interrupt_pollling(this, [buffer, length, result_callback]() {
-        rpc.process(RpcManager::RPCType::JSON, buffer, length,
-                    [result_callback](const char* b, uint32_t l) {
-                      result_callback(b, l);
-                      return true;
-                    });
-      });
-    break;
+  torrent::main_thread::thread()->callback_interrupt_pollling(this, [this, scgi_thread, type, batch]() {
+      auto respond = [this, scgi_thread, type, batch]() {
+          rpc.execute(type, batch.get());
+
+          scgi_thread->callback_interrupt_pollling(this, [this, batch]() {
+              receive_response(batch);
+              torrent::this_thread::poll()->insert_write(this);
+            });
+        };
+
+      auto wake = [batch, respond]() {
+          // Don't count the time spent waiting for events as queue time.
+          batch->decode_done = std::chrono::steady_clock::now();
+          respond();
+        };
+
+      if (!subscriptions.defer(*batch, this, wake))
+        respond();
+    });
+}
 
-  case rpc::SCgiTask::ContentType::XML:
-    torrent::main_thread::thread()->callback_interrupt_pollling(this, [buffer, length, result_callback]() {
-        rpc.process(RpcManager::RPCType::XML, buffer, length,
-                    [result_callback](const char* b, uint32_t l) {
-                      result_callback(b, l);
-                      return true;
-                    });
-      });
-    break;
+// Responses larger than 'stream_part_size' are streamed, encoding the
+// next part only once the previous one has been sent. Only the
+// encoding is streamed, the result objects were all built by the
+// call.
+//
+// Streamed SCGI responses have no Content-Length, so keep-alive SCGI
+// connections are closed after them.
+void
+SCgiTask::receive_response(const std::shared_ptr<RpcBatch>& batch) {
+  auto type = scgi_rpc_type(content_type());
 
-  default:
-    throw torrent::internal_error("SCgiTask::receive_call(...) received bad input.");
+  std::string response;
+
+  if (rpc.encode_partial(type, batch.get(), &response, stream_part_size))
+    return receive_write(std::move(response));
+
+  m_stream_batch = batch;
+
+  receive_stream(std::move(response), true, false);
+}
+
+bool
+SCgiTask::should_compress(size_t size) const {
+  return m_accept_encoding != ResponseCompressor::NONE &&
+    m_parent->compress_min_size() != 0 &&
+    size >= m_parent->compress_min_size();
+}
+
+// Takes ownership of the serialized response, only the header is
+// formatted here and both are sent with a single sendmsg call.
+void
+SCgiTask::receive_write(std::string&& response) {
+  std::string content_encoding;
+
+  if (should_compress(response.size())) {
+    std::string compressed;
+
+    try {
+      ResponseCompressor(m_accept_encoding).compress(response, &compressed, true);
+
+      response         = std::move(compressed);
+      content_encoding = std::string("Content-Encoding: ") + ResponseCompressor::encoding_name(m_accept_encoding) + "\r\n";
+
+    } catch (torrent::local_error& e) {
+      lt_log_print(torrent::LOG_RPC_EVENTS, "scgi: sending response uncompressed: %s", e.what());
+    }
   }
+
+  auto lock = std::lock_guard<std::mutex>(m_result_mutex);
+
+  const auto content_type = scgi_content_type_name(m_content_type);
+
+  int header_size;
+
+  if (m_parent->protocol() == SCgi::HTTP)
+    header_size = snprintf(m_header, max_response_header_size,
+                           "HTTP/1.1 200 OK\r\nContent-Type: %s\r\n%sContent-Length: %zu\r\nConnection: %s\r\n\r\n",
+                           content_type, content_encoding.c_str(), response.size(), m_keep_alive ? "keep-alive" : "close");
+  else
+    header_size = snprintf(m_header, max_response_header_size,
+                           "Status: 200 OK\r\nContent-Type: %s\r\n%sContent-Length: %zu\r\n\r\n",
+                           content_type, content_encoding.c_str(), response.size());
+
+  if (header_size <= 0 || header_size >= max_response_header_size)
+    throw torrent::internal_error("SCgiTask::receive_write(...) could not format header.");
+
+  m_header_size    = header_size;
+  m_response       = std::move(response);
+  m_response_sent  = 0;
+
+  log_response();
 }
 
+// HTTP responses use chunked transfer encoding, while SCGI responses
+// are ended by closing the connection. Whether to compress is decided
+// by the size of the first part, each part is then flushed from the
+// compressor as it is sent.
 void
-SCgiTask::receive_write(const char* buffer, uint32_t length) {
-  if (buffer == NULL || length > (100 << 20))
-    throw torrent::internal_error("SCgiTask::receive_write(...) received bad input.");
+SCgiTask::receive_stream(std::string&& part, bool is_first, bool is_last) {
+  try {
+    if (is_first && should_compress(part.size()))
+      m_compressor = std::make_unique<ResponseCompressor>(m_accept_encoding);
+
+    if (m_compressor) {
+      std::string compressed;
+      m_compressor->compress(part, &compressed, is_last);
+
+      part = std::move(compressed);
+    }
+
+  } catch (torrent::local_error& e) {
+    // Once the header naming the encoding has been sent the response
+    // can't continue uncompressed.
+    if (!is_first) {
+      lt_log_print(torrent::LOG_RPC_EVENTS, "scgi: closing connection: %s", e.what());
+      return close();
+    }
+
+    lt_log_print(torrent::LOG_RPC_EVENTS, "scgi: sending response uncompressed: %s", e.what());
+    m_compressor.reset();
+  }
 
   auto lock = std::lock_guard<std::mutex>(m_result_mutex);
 
-  // Need to cast due to a bug in MacOSX gcc-4.0.1.
-  if (length + 256 > std::max(m_buffer_size, (unsigned int)default_buffer_size))
-    realloc_buffer(length + 256, NULL, 0);
+  const auto content_type = scgi_content_type_name(m_content_type);
+
+  int header_size = 0;
+
+  if (is_first) {
+    std::string content_encoding;
+
+    if (m_compressor)
+      content_encoding = std::string("Content-Encoding: ") + ResponseCompressor::encoding_name(m_compressor->encoding()) + "\r\n";
+
+    if (m_parent->protocol() == SCgi::HTTP)
+      header_size = snprintf(m_header, max_response_header_size,
+                             "HTTP/1.1 200 OK\r\nContent-Type: %s\r\n%sTransfer-Encoding: chunked\r\nConnection: %s\r\n\r\n",
+                             content_type, content_encoding.c_str(), m_keep_alive ? "keep-alive" : "close");
+    else
+      header_size = snprintf(m_header, max_response_header_size,
+                             "Status: 200 OK\r\nContent-Type: %s\r\n%s\r\n", content_type, content_encoding.c_str());
+
+    if (header_size <= 0 || header_size >= max_response_header_size)
+      throw torrent::internal_error("SCgiTask::receive_stream(...) could not format header.");
+
+    if (m_parent->protocol() == SCgi::SCGI)
+      m_keep_alive = false;
+  }
+
+  if (is_last)
+    m_compressor.reset();
 
-  const auto header = m_content_type == ContentType::JSON
-                        ? "Status: 200 OK\r\nContent-Type: application/json\r\nContent-Length: %i\r\n\r\n"
-                        : "Status: 200 OK\r\nContent-Type: text/xml\r\nContent-Length: %i\r\n\r\n";
+  m_response = std::move(part);
 
-  // Who ever bothers to check the return value?
-  int headerSize = snprintf(m_buffer, m_buffer_size, header, length);
+  if (m_parent->protocol() == SCgi::HTTP) {
+    // An empty chunk would end the body early.
+    if (!m_response.empty()) {
+      int chunk_size = snprintf(m_header + header_size, max_response_header_size - header_size, "%zx\r\n", m_response.size());
 
-  m_position   = m_buffer;
-  m_buffer_size = length + headerSize;
+      if (chunk_size <= 0 || chunk_size >= max_response_header_size - header_size)
+        throw torrent::internal_error("SCgiTask::receive_stream(...) could not format chunk header.");
 
-  std::memcpy(m_buffer + headerSize, buffer, length);
+      header_size += chunk_size;
+      m_response.append("\r\n");
+    }
+
+    if (is_last)
+      m_response.append("0\r\n\r\n");
+  }
+
+  m_header_size   = header_size;
+  m_response_sent = 0;
 
+  log_response();
+}
+
+void
+SCgiTask::next_stream_part() {
+  std::string part;
+  bool        is_last = rpc.encode_partial(scgi_rpc_type(content_type()), m_stream_batch.get(), &part, stream_part_size);
+
+  if (is_last)
+    m_stream_batch.reset();
+
+  receive_stream(std::move(part), false, is_last);
+}
+
+void
+SCgiTask::log_response() {
   if (m_parent->log_fd() >= 0) {
     [[maybe_unused]] int result;
-    result = write(m_parent->log_fd(), m_buffer, m_buffer_size);
+    result = write(m_parent->log_fd(), m_header, m_header_size);
+    result = write(m_parent->log_fd(), m_response.c_str(), m_response.size());
     result = write(m_parent->log_fd(), "\n---\n", sizeof("\n---\n"));
   }
 
-  lt_log_print_dump(torrent::LOG_RPC_DUMP, m_buffer, m_buffer_size, "scgi", "RPC write.", 0);
+  lt_log_print_dump(torrent::LOG_RPC_DUMP, m_response.c_str(), m_response.size(), "scgi", "RPC write.", 0);
 }
 
 } // namespace rpc
@@ -1,9 +1,15 @@
 #ifndef RTORRENT_RPC_SCGI_TASK_H
 #define RTORRENT_RPC_SCGI_TASK_H
 
+#include <chrono>
 #include <memory>
 #include <mutex>
+#include <string>
 #include <torrent/event.h>
+#include <torrent/utils/scheduler.h>
+
+#include "rpc/http_request.h"
+#include "rpc/response_compressor.h"
 
 namespace utils {
   class SocketFd;
@@ -12,22 +18,34 @@ namespace utils {
 namespace rpc {
 
 class SCgi;
+struct RpcBatch;
 
 class SCgiTask : public torrent::Event {
 public:
-  static const unsigned int default_buffer_size = 2047;
-  static const          int max_header_size     = 2000;
-  static const          int max_content_size    = (2 << 23);
+  static const unsigned int default_buffer_size      = 2047;
+  static const          int max_header_size          = 2000;
+  static const          int max_content_size         = (2 << 23);
+  static const          int max_response_header_size = 256;
+  static const unsigned int max_http_header_size     = 8192;
+  static const unsigned int stream_part_size         = (256 << 10);
+
+  // Connections are closed if no part of a request arrives for this
+  // long, including keep-alive connections between requests.
+  static constexpr std::chrono::seconds read_timeout{30};
 
-  enum ContentType { XML, JSON };
+  enum ContentType { XML, JSON, BENCODE };
 
-  SCgiTask() { m_fileDesc = -1; }
+  SCgiTask();
 
   const char*         type_name() const override { return "scgi-task"; }
 
   bool                is_open() const      { return m_fileDesc != -1; }
   bool                is_available() const { return m_fileDesc == -1; }
 
+  // A keep-alive connection waiting for its next request. Only call
+  // from the task's own thread.
+  bool                is_idle() const      { return is_open() && m_idle; }
+
   void                open(SCgi* parent, int fd);
   void                close();
 
@@ -43,11 +61,30 @@ private:
   bool                detect_content_type(const std::string& content_type);
   void                realloc_buffer(uint32_t size, const char* buffer, uint32_t bufferSize);
 
+  void                parse_request();
+  void                parse_http_request();
+  bool                decode_chunked_body();
+  void                send_continue();
+  void                prepare_body(size_t content_length);
+  bool                grow_buffer(unsigned int max_size);
+  void                complete_request();
+  void                next_request();
+
+  void                http_error(const char* status);
+  void                receive_timeout();
+
   void                receive_call(const char* buffer, uint32_t length);
-  void                receive_write(const char* buffer, uint32_t length);
+  void                receive_response(const std::shared_ptr<RpcBatch>& batch);
+  void                receive_write(std::string&& response);
+  void                receive_stream(std::string&& part, bool is_first, bool is_last);
+  bool                should_compress(size_t size) const;
+  void                next_stream_part();
+  void                log_response();
 
   SCgi*               m_parent;
 
+  torrent::utils::SchedulerEntry m_task_timeout;
+
   std::mutex          m_result_mutex;
 
   char*               m_buffer{nullptr};
@@ -57,6 +94,26 @@ private:
   unsigned int        m_buffer_size{0};
 
   ContentType         m_content_type{ XML };
+
+  bool                m_keep_alive{false};
+  bool                m_idle{false};
+  HttpRequest         m_http_request;
+  HttpChunkedBody     m_chunked_body;
+
+  ResponseCompressor::Encoding        m_accept_encoding{ResponseCompressor::NONE};
+  std::unique_ptr<ResponseCompressor> m_compressor;
+
+  char                m_header[max_response_header_size];
+  size_t              m_header_size{0};
+  std::string         m_response;
+  size_t              m_response_sent{0};
+
+  // Set while a response is being streamed in parts.
+  std::shared_ptr<RpcBatch> m_stream_batch;
+
+  // Bytes of pipelined requests received together with the current
+  // request on a keep-alive connection.
+  std::string         m_pending;
 };
 
 }
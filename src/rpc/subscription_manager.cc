@@ -0,0 +1,233 @@
+#include "config.h"
+
+#include "rpc/subscription_manager.h"
+
+#include <algorithm>
+#include <torrent/download_info.h>
+#include <torrent/exceptions.h>
+#include <torrent/torrent.h>
+#include <torrent/utils/thread.h>
+
+#include "core/download.h"
+#include "rak/string_manip.h"
+#include "rpc/rpc_batch.h"
+
+namespace rpc {
+
+constexpr size_t SubscriptionManager::max_subscriptions;
+constexpr size_t SubscriptionManager::max_queued_events;
+constexpr std::chrono::seconds SubscriptionManager::max_wait;
+constexpr std::chrono::seconds SubscriptionManager::expire_time;
+
+static bool
+subscription_is_valid_event(const std::string& event) {
+  return (event.size() > 15 && event.compare(0, 15, "event.download.") == 0) ||
+    event == "view.event_added" || event == "view.event_removed";
+}
+
+SubscriptionManager::SubscriptionManager() {
+  m_task_notify.slot()  = [this] { wake_waiters(); };
+  m_task_timeout.slot() = [this] { receive_timeout(); };
+}
+
+SubscriptionManager::~SubscriptionManager() = default;
+
+void
+SubscriptionManager::cleanup() {
+  torrent::this_thread::scheduler()->erase(&m_task_notify);
+  torrent::this_thread::scheduler()->erase(&m_task_timeout);
+
+  {
+    auto lock = std::lock_guard<std::mutex>(m_waiters_mutex);
+    m_waiters.clear();
+  }
+
+  m_subscriptions.clear();
+}
+
+uint64_t
+SubscriptionManager::subscribe(const torrent::Object::list_type& events) {
+  if (events.empty())
+    throw torrent::input_error("no events to subscribe to");
+
+  if (m_subscriptions.size() >= max_subscriptions)
+    throw torrent::input_error("too many subscriptions");
+
+  subscription_type subscription;
+
+  for (const auto& event : events) {
+    if (!event.is_string() || !subscription_is_valid_event(event.as_string()))
+      throw torrent::input_error("invalid event name");
+
+    subscription.events.push_back(event.as_string());
+  }
+
+  subscription.last_used = clock_type::now();
+
+  if (!m_task_timeout.is_scheduled())
+    torrent::this_thread::scheduler()->wait_for_ceil_seconds(&m_task_timeout, 1s);
+
+  m_subscriptions.emplace(m_next_id, std::move(subscription));
+  return m_next_id++;
+}
+
+// Held requests for the subscription are woken and report the error.
+void
+SubscriptionManager::unsubscribe(uint64_t id) {
+  if (m_subscriptions.erase(id) == 0)
+    throw torrent::input_error("invalid subscription");
+
+  schedule_notify();
+}
+
+torrent::Object
+SubscriptionManager::poll(uint64_t id) {
+  auto itr = m_subscriptions.find(id);
+
+  if (itr == m_subscriptions.end())
+    throw torrent::input_error("invalid subscription");
+
+  auto& subscription = itr->second;
+  auto  result       = torrent::Object::create_map();
+  auto& events       = (result.as_map()["events"] = torrent::Object::create_list()).as_list();
+
+  for (const auto& event : subscription.queue) {
+    auto  entry = torrent::Object::create_map();
+    auto& map   = entry.as_map();
+
+    map["event"] = event.event;
+    map["hash"]  = event.hash;
+
+    if (!event.view.empty())
+      map["view"] = event.view;
+
+    events.push_back(std::move(entry));
+  }
+
+  result.as_map()["dropped"] = (int64_t)subscription.dropped;
+
+  subscription.queue.clear();
+  subscription.dropped   = 0;
+  subscription.last_used = clock_type::now();
+
+  return result;
+}
+
+void
+SubscriptionManager::push(const char* event, core::Download* download, const std::string& view) {
+  if (m_subscriptions.empty())
+    return;
+
+  std::string hash;
+  bool        is_queued = false;
+
+  for (auto& itr : m_subscriptions) {
+    auto& subscription = itr.second;
+
+    if (std::find(subscription.events.begin(), subscription.events.end(), event) == subscription.events.end())
+      continue;
+
+    if (hash.empty())
+      hash = rak::transform_hex_str(download->info()->hash());
+
+    if (subscription.queue.size() >= max_queued_events) {
+      subscription.queue.pop_front();
+      subscription.dropped++;
+    }
+
+    subscription.queue.push_back(event_type{event, hash, view});
+    is_queued = true;
+  }
+
+  if (is_queued)
+    schedule_notify();
+}
+
+// Only 'system.subscription.poll' calls with a timeout are held, any
+// invalid arguments are reported when the request is executed.
+bool
+SubscriptionManager::defer(const RpcBatch& batch, void* owner, slot_wake slot) {
+  if (batch.has_response || batch.request != nullptr || batch.calls.size() != 1)
+    return false;
+
+  const auto& call = batch.calls.front();
+
+  if (call.has_error || call.method != "system.subscription.poll" || !call.params.is_list())
+    return false;
+
+  const auto& params = call.params.as_list();
+
+  if (params.size() != 3 || !params[1].is_value() || !params[2].is_value() || params[2].as_value() <= 0)
+    return false;
+
+  auto itr = m_subscriptions.find(params[1].as_value());
+
+  if (itr == m_subscriptions.end() || !itr->second.queue.empty())
+    return false;
+
+  auto now     = clock_type::now();
+  auto timeout = std::min<clock_type::duration>(std::chrono::milliseconds(params[2].as_value()), max_wait);
+
+  itr->second.last_used = now;
+
+  auto lock = std::lock_guard<std::mutex>(m_waiters_mutex);
+
+  m_waiters.push_back(waiter_type{itr->first, owner, now + timeout, std::move(slot)});
+  return true;
+}
+
+void
+SubscriptionManager::cancel(void* owner) {
+  auto lock = std::lock_guard<std::mutex>(m_waiters_mutex);
+
+  m_waiters.erase(std::remove_if(m_waiters.begin(), m_waiters.end(), [owner](const waiter_type& waiter) { return waiter.owner == owner; }),
+                  m_waiters.end());
+}
+
+// Wake held requests once the current events have been handled, so
+// that events triggered together are returned together.
+void
+SubscriptionManager::schedule_notify() {
+  if (!m_task_notify.is_scheduled())
+    torrent::this_thread::scheduler()->wait_for(&m_task_notify, 0ms);
+}
+
+// The slot is queued as a callback of the owner while holding the
+// lock, so 'cancel' followed by cancelling the owner's callbacks
+// never leaves a request running for a closed connection.
+void
+SubscriptionManager::wake_waiters() {
+  auto now  = clock_type::now();
+  auto lock = std::lock_guard<std::mutex>(m_waiters_mutex);
+
+  for (auto itr = m_waiters.begin(); itr != m_waiters.end();) {
+    auto subscription = m_subscriptions.find(itr->id);
+
+    if (subscription != m_subscriptions.end() && subscription->second.queue.empty() && itr->deadline > now) {
+      ++itr;
+      continue;
+    }
+
+    torrent::main_thread::thread()->callback_interrupt_pollling(itr->owner, std::move(itr->slot));
+    itr = m_waiters.erase(itr);
+  }
+}
+
+void
+SubscriptionManager::receive_timeout() {
+  auto now = clock_type::now();
+
+  for (auto itr = m_subscriptions.begin(); itr != m_subscriptions.end();) {
+    if (now - itr->second.last_used > expire_time)
+      itr = m_subscriptions.erase(itr);
+    else
+      ++itr;
+  }
+
+  wake_waiters();
+
+  if (!m_subscriptions.empty())
+    torrent::this_thread::scheduler()->wait_for_ceil_seconds(&m_task_timeout, 1s);
+}
+
+} // namespace rpc
@@ -0,0 +1,118 @@
+#ifndef RTORRENT_RPC_SUBSCRIPTION_MANAGER_H
+#define RTORRENT_RPC_SUBSCRIPTION_MANAGER_H
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <torrent/object.h>
+#include <torrent/utils/scheduler.h>
+
+namespace core {
+class Download;
+}
+
+namespace rpc {
+
+struct RpcBatch;
+
+// Queues download and view events for RPC clients so they don't need
+// to poll the download list. A client subscribes to a set of event
+// names and receives the queued events in batches:
+//
+// event.download.*:   Events triggered by DownloadList, such as
+//                     'event.download.finished'.
+// view.event_added:   A download became visible in a view.
+// view.event_removed: A download was hidden from a view.
+//
+// Requests that poll a subscription with nothing queued are held by
+// the RPC listener until an event arrives or the timeout passes.
+//
+// Everything except 'cancel' must be called from the main thread.
+class SubscriptionManager {
+public:
+  using clock_type = std::chrono::steady_clock;
+  using slot_wake  = std::function<void()>;
+
+  static constexpr size_t max_subscriptions = 64;
+  static constexpr size_t max_queued_events = 4096;
+
+  static constexpr std::chrono::seconds max_wait{120};
+  static constexpr std::chrono::seconds expire_time{300};
+
+  SubscriptionManager();
+  ~SubscriptionManager();
+
+  void                cleanup();
+
+  bool                empty() const { return m_subscriptions.empty(); }
+
+  // Returns the id of the new subscription.
+  uint64_t            subscribe(const torrent::Object::list_type& events);
+  void                unsubscribe(uint64_t id);
+
+  // Returns and clears the queued events. Events dropped because the
+  // queue was full are counted in 'dropped'.
+  torrent::Object     poll(uint64_t id);
+
+  void                push(const char* event, core::Download* download, const std::string& view = std::string());
+
+  // Holds a request that only polls an idle subscription, calling
+  // 'slot' as a main thread callback of 'owner' once there is
+  // something to return. Returns false if the request should be
+  // executed right away.
+  bool                defer(const RpcBatch& batch, void* owner, slot_wake slot);
+
+  // Drops any request held for 'owner', called from the RPC thread
+  // after the owner has cancelled its main thread callbacks, which
+  // must then be cancelled again.
+  void                cancel(void* owner);
+
+private:
+  SubscriptionManager(const SubscriptionManager&) = delete;
+  SubscriptionManager& operator=(const SubscriptionManager&) = delete;
+
+  struct event_type {
+    std::string             event;
+    std::string             hash;
+    std::string             view;
+  };
+
+  struct subscription_type {
+    std::vector<std::string> events;
+    std::deque<event_type>   queue;
+    uint64_t                 dropped{0};
+    clock_type::time_point   last_used;
+  };
+
+  struct waiter_type {
+    uint64_t                 id;
+    void*                    owner;
+    clock_type::time_point   deadline;
+    slot_wake                slot;
+  };
+
+  void                receive_timeout();
+
+  void                schedule_notify();
+  void                wake_waiters();
+
+  std::map<uint64_t, subscription_type> m_subscriptions;
+  uint64_t                              m_next_id{1};
+
+  std::mutex                            m_waiters_mutex;
+  std::vector<waiter_type>              m_waiters;
+
+  torrent::utils::SchedulerEntry        m_task_notify;
+  torrent::utils::SchedulerEntry        m_task_timeout;
+};
+
+extern SubscriptionManager subscriptions;
+
+} // namespace rpc
+
+#endif
@@ -3,6 +3,7 @@
 #include "xmlrpc.h"
 
 #include "parse_commands.h"
+#include "rpc_batch.h"
 
 #include <cstring>
 #include <torrent/exceptions.h>
@@ -27,6 +28,7 @@ XmlRpc::store_command_name(const char* name) {
 
 #ifndef HAVE_XMLRPC_C
 #ifndef HAVE_XMLRPC_TINYXML2
+#ifndef HAVE_XMLRPC_STREAM
 
 void XmlRpc::initialize() {}
 void XmlRpc::cleanup() {}
@@ -36,11 +38,17 @@ void XmlRpc::set_dialect(int) {}
 
 bool XmlRpc::process(const char*, uint32_t, slot_write) { return false; }
 
+void        XmlRpc::decode(const char*, uint32_t, RpcBatch*) {}
+void        XmlRpc::execute(RpcBatch*) {}
+std::string XmlRpc::encode(RpcBatch*) { return std::string(); }
+bool        XmlRpc::encode_partial(RpcBatch*, std::string*, size_t) { return true; }
+
 int64_t XmlRpc::size_limit() { return 0; }
 void    XmlRpc::set_size_limit(uint64_t size) {}
 
 bool    XmlRpc::is_valid() const { return false; }
 
+#endif
 #endif
 #endif
 
@@ -2,6 +2,7 @@
 #define RTORRENT_RPC_XMLRPC_H
 
 #include <functional>
+#include <string>
 #include <torrent/common.h>
 #include <torrent/hash_string.h>
 #include <torrent/tracker/tracker.h>
@@ -15,6 +16,8 @@ namespace core {
 
 namespace rpc {
 
+struct RpcBatch;
+
 class XmlRpc {
 public:
   typedef std::function<core::Download* (const char*)>                                slot_download;
@@ -45,6 +48,17 @@ public:
 
   bool                process(const char* inBuffer, uint32_t length, slot_write slotWrite);
 
+  // Only 'execute' needs to be called from the main thread. The
+  // xmlrpc-c backend does all the work in 'execute', and requires the
+  // input buffer to remain valid until then.
+  void                decode(const char* inBuffer, uint32_t length, RpcBatch* batch);
+  void                execute(RpcBatch* batch);
+  std::string         encode(RpcBatch* batch);
+
+  // See JsonRpc::encode_partial. Only the tinyxml2 and stream backends
+  // split the response, xmlrpc-c appends it all at once.
+  bool                encode_partial(RpcBatch* batch, std::string* buffer, size_t max_size);
+
   void                insert_command(const char* name, const char* parm, const char* doc);
 
   int                 dialect() { return m_dialect; }
@@ -74,7 +88,7 @@ private:
 
   int                 m_dialect{dialect_i8};
 
-  // Only used by tinyxml2
+  // Only used by tinyxml2 and stream
   bool                m_isValid;
   uint64_t            m_sizeLimit{SCgiTask::max_content_size};
 };
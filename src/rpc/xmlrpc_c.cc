@@ -13,6 +13,7 @@
 #include <torrent/utils/string_manip.h>
 #include <xmlrpc-c/server.h>
 
+#include "rpc_batch.h"
 #include "rpc_manager.h"
 #include "xmlrpc.h"
 #include "parse_commands.h"
@@ -440,6 +441,31 @@ XmlRpc::process(const char* inBuffer, uint32_t length, slot_write slotWrite) {
   return result;
 }
 
+void
+XmlRpc::decode(const char* inBuffer, uint32_t length, RpcBatch* batch) {
+  batch->request        = inBuffer;
+  batch->request_length = length;
+}
+
+void
+XmlRpc::execute(RpcBatch* batch) {
+  process(batch->request, batch->request_length, [batch](const char* buffer, uint32_t length) {
+      batch->set_response(std::string(buffer, length));
+      return true;
+    });
+}
+
+std::string
+XmlRpc::encode(RpcBatch* batch) {
+  return std::move(batch->response);
+}
+
+bool
+XmlRpc::encode_partial(RpcBatch* batch, std::string* buffer, size_t) {
+  buffer->append(batch->response);
+  return true;
+}
+
 void
 XmlRpc::insert_command(const char* name, const char* parm, const char* doc) {
   xmlrpc_env local_env;
@@ -0,0 +1,1113 @@
+#include "config.h"
+
+#ifdef HAVE_XMLRPC_STREAM
+#if defined(HAVE_XMLRPC_C) || defined(HAVE_XMLRPC_TINYXML2)
+#error HAVE_XMLRPC_STREAM cannot be used together with another XMLRPC backend. Please choose only one
+#endif
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <torrent/exceptions.h>
+#include <torrent/object.h>
+
+#include "parse_commands.h"
+#include "rpc/rpc_batch.h"
+#include "rpc/rpc_manager.h"
+#include "utils/base64.h"
+#include "utils/functional.h"
+#include "xmlrpc.h"
+
+namespace rpc {
+
+// Same codes and messages as the tinyxml2 backend, which were taken
+// from xmlrpc-c.
+const int XMLRPC_INTERNAL_ERROR       = -500;
+const int XMLRPC_TYPE_ERROR           = -501;
+const int XMLRPC_PARSE_ERROR          = -503;
+const int XMLRPC_NO_SUCH_METHOD_ERROR = -506;
+const int XMLRPC_LIMIT_EXCEEDED_ERROR = -509;
+
+// Malformed XML, which fails the whole request unlike errors in the
+// values of a call.
+class xml_syntax_error : public std::runtime_error {
+public:
+  using std::runtime_error::runtime_error;
+};
+
+// Pull parser over the request buffer, returning one element or text
+// token at a time. Only the parts of XML used by XML-RPC are
+// understood, declarations, comments and DTDs are skipped.
+class XmlReader {
+public:
+  enum token_type {
+    token_eof,
+    token_open,
+    token_close,
+    token_text
+  };
+
+  // Values, arrays and structs are read recursively, so limit the
+  // nesting as TinyXML-2 does.
+  static constexpr size_t max_depth = 500;
+
+  XmlReader(const char* first, const char* last) : m_first(first), m_position(first), m_last(last) {}
+
+  token_type          next();
+
+  // Name of the last opened or closed element.
+  const std::string&  name() const { return m_name; }
+  const std::string&  text() const { return m_text; }
+
+  // Number of open elements, including an empty element until its
+  // close token has been returned.
+  size_t              depth() const { return m_open.size(); }
+
+private:
+  [[noreturn]] void   throw_error(const char* msg) const;
+
+  bool                starts_with(const char* str, size_t length) const;
+  const char*         find(const char* str, size_t length) const;
+
+  void                skip_whitespace();
+  void                read_name();
+  void                read_text(const char* last, bool is_cdata);
+  void                read_entity(const char* last);
+
+  const char*         m_first;
+  const char*         m_position;
+  const char*         m_last;
+
+  std::vector<std::string> m_open;
+  bool                     m_has_root{false};
+  bool                     m_pending_close{false};
+
+  std::string         m_name;
+  std::string         m_text;
+};
+
+static bool
+xml_is_whitespace(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static bool
+xml_is_name_char(char c) {
+  return std::isalnum(static_cast<unsigned char>(c)) || (c & 0x80) || c == '_' || c == ':' || c == '-' || c == '.';
+}
+
+void
+XmlReader::throw_error(const char* msg) const {
+  auto line = std::count(m_first, m_position, '\n') + 1;
+
+  throw xml_syntax_error("XML parse error at line " + std::to_string(line) + ": " + msg);
+}
+
+bool
+XmlReader::starts_with(const char* str, size_t length) const {
+  return (size_t)(m_last - m_position) >= length && std::memcmp(m_position, str, length) == 0;
+}
+
+const char*
+XmlReader::find(const char* str, size_t length) const {
+  auto itr = std::search(m_position, m_last, str, str + length);
+
+  if (itr == m_last)
+    throw_error("unexpected end of document");
+
+  return itr;
+}
+
+void
+XmlReader::skip_whitespace() {
+  while (m_position != m_last && xml_is_whitespace(*m_position))
+    m_position++;
+}
+
+void
+XmlReader::read_name() {
+  auto first = m_position;
+
+  while (m_position != m_last && xml_is_name_char(*m_position))
+    m_position++;
+
+  if (m_position == first)
+    throw_error("invalid element name");
+
+  m_name.assign(first, m_position);
+}
+
+// Appends the text up to 'last', with entities and line endings
+// handled the same way as tinyxml2.
+void
+XmlReader::read_text(const char* last, bool is_cdata) {
+  while (m_position != last) {
+    auto itr = std::find_if(m_position, last, [is_cdata](char c) { return (c == '&' && !is_cdata) || c == '\r'; });
+
+    m_text.append(m_position, itr);
+    m_position = itr;
+
+    if (m_position == last)
+      break;
+
+    if (*m_position == '\r') {
+      m_text.push_back('\n');
+
+      if (++m_position != last && *m_position == '\n')
+        m_position++;
+
+      continue;
+    }
+
+    read_entity(last);
+  }
+}
+
+// Unknown or malformed entities are kept as-is. Character references
+// to UTF-16 surrogates have no UTF-8 encoding and are errors.
+void
+XmlReader::read_entity(const char* last) {
+  static const struct {
+    const char* name;
+    char        value;
+  } entities[] = { { "amp;", '&' }, { "lt;", '<' }, { "gt;", '>' }, { "quot;", '"' }, { "apos;", '\'' } };
+
+  auto first = m_position + 1;
+
+  for (const auto& entity : entities) {
+    auto length = std::strlen(entity.name);
+
+    if ((size_t)(last - first) >= length && std::memcmp(first, entity.name, length) == 0) {
+      m_text.push_back(entity.value);
+      m_position = first + length;
+      return;
+    }
+  }
+
+  auto limit = first + std::min<size_t>(last - first, 10);
+  auto end   = std::find(first, limit, ';');
+
+  if (end == limit || end - first < 2 || *first != '#') {
+    m_text.push_back(*m_position++);
+    return;
+  }
+
+  bool     is_hex = first[1] == 'x';
+  uint32_t code   = 0;
+
+  for (auto itr = first + (is_hex ? 2 : 1); itr != end; itr++) {
+    int digit = std::isdigit(static_cast<unsigned char>(*itr)) ? *itr - '0' : -1;
+
+    if (is_hex && digit == -1 && std::isxdigit(static_cast<unsigned char>(*itr)))
+      digit = std::tolower(static_cast<unsigned char>(*itr)) - 'a' + 10;
+
+    if (digit == -1 || code > 0x10ffff) {
+      m_text.push_back(*m_position++);
+      return;
+    }
+
+    code = code * (is_hex ? 16 : 10) + digit;
+  }
+
+  if (code == 0 || code > 0x10ffff || end == first + (is_hex ? 2 : 1)) {
+    m_text.push_back(*m_position++);
+    return;
+  }
+
+  if (code >= 0xd800 && code <= 0xdfff)
+    throw_error("invalid character reference");
+
+  if (code < 0x80) {
+    m_text.push_back(code);
+  } else if (code < 0x800) {
+    m_text.push_back(0xc0 | (code >> 6));
+    m_text.push_back(0x80 | (code & 0x3f));
+  } else if (code < 0x10000) {
+    m_text.push_back(0xe0 | (code >> 12));
+    m_text.push_back(0x80 | ((code >> 6) & 0x3f));
+    m_text.push_back(0x80 | (code & 0x3f));
+  } else {
+    m_text.push_back(0xf0 | (code >> 18));
+    m_text.push_back(0x80 | ((code >> 12) & 0x3f));
+    m_text.push_back(0x80 | ((code >> 6) & 0x3f));
+    m_text.push_back(0x80 | (code & 0x3f));
+  }
+
+  m_position = end + 1;
+}
+
+XmlReader::token_type
+XmlReader::next() {
+  if (m_pending_close) {
+    m_pending_close = false;
+    m_open.pop_back();
+    return token_close;
+  }
+
+  m_text.clear();
+
+  while (true) {
+    if (m_position == m_last) {
+      if (!m_open.empty())
+        throw_error(("element '" + m_open.back() + "' not closed").c_str());
+
+      if (!m_has_root)
+        throw_error("empty document");
+
+      return token_eof;
+    }
+
+    if (*m_position != '<') {
+      auto last = std::find(m_position, m_last, '<');
+
+      if (m_open.empty()) {
+        skip_whitespace();
+
+        if (m_position != last)
+          throw_error("text outside of the root element");
+
+        continue;
+      }
+
+      read_text(last, false);
+      return token_text;
+    }
+
+    if (starts_with("<!--", 4)) {
+      m_position = find("-->", 3) + 3;
+      continue;
+    }
+
+    if (starts_with("<![CDATA[", 9)) {
+      if (m_open.empty())
+        throw_error("text outside of the root element");
+
+      m_position += 9;
+      read_text(find("]]>", 3), true);
+      m_position += 3;
+      return token_text;
+    }
+
+    if (starts_with("<?", 2)) {
+      m_position = find("?>", 2) + 2;
+      continue;
+    }
+
+    if (starts_with("<!", 2)) {
+      if (m_has_root)
+        throw_error("unexpected declaration");
+
+      // Skip the DTD, including any internal subset.
+      int brackets = 0;
+
+      for (m_position += 2; m_position != m_last && (*m_position != '>' || brackets != 0); m_position++) {
+        if (*m_position == '[')
+          brackets++;
+        else if (*m_position == ']')
+          brackets--;
+      }
+
+      if (m_position == m_last)
+        throw_error("unexpected end of document");
+
+      m_position++;
+      continue;
+    }
+
+    if (starts_with("</", 2)) {
+      m_position += 2;
+      read_name();
+      skip_whitespace();
+
+      if (m_position == m_last || *m_position != '>')
+        throw_error("invalid closing tag");
+
+      if (m_open.empty() || m_open.back() != m_name)
+        throw_error(("mismatched closing tag '" + m_name + "'").c_str());
+
+      m_position++;
+      m_open.pop_back();
+      return token_close;
+    }
+
+    if (m_open.empty() && m_has_root)
+      throw_error("multiple root elements");
+
+    m_position++;
+    read_name();
+
+    // Attributes are not used by XML-RPC, only check that they are
+    // well-formed.
+    while (true) {
+      skip_whitespace();
+
+      if (m_position == m_last)
+        throw_error("unexpected end of document");
+
+      if (*m_position == '>') {
+        m_position++;
+        break;
+      }
+
+      if (starts_with("/>", 2)) {
+        m_position += 2;
+        m_pending_close = true;
+        break;
+      }
+
+      auto attribute = m_position;
+
+      while (m_position != m_last && xml_is_name_char(*m_position))
+        m_position++;
+
+      if (m_position == attribute)
+        throw_error("invalid attribute");
+
+      skip_whitespace();
+
+      if (m_position == m_last || *m_position != '=')
+        throw_error("invalid attribute");
+
+      m_position++;
+      skip_whitespace();
+
+      if (m_position == m_last || (*m_position != '"' && *m_position != '\''))
+        throw_error("invalid attribute");
+
+      auto quote = std::find(m_position + 1, m_last, *m_position);
+
+      if (quote == m_last)
+        throw_error("unexpected end of document");
+
+      m_position = quote + 1;
+    }
+
+    if (m_open.size() >= max_depth)
+      throw_error("element depth limit exceeded");
+
+    m_open.push_back(m_name);
+    m_has_root = true;
+    return token_open;
+  }
+}
+
+// Reads until the next child element is opened, or returns false once
+// the current element is closed. Child elements must be read or
+// skipped before calling this again.
+static bool
+xml_next_child(XmlReader* reader, std::string* text) {
+  while (true) {
+    switch (reader->next()) {
+    case XmlReader::token_open:
+      return true;
+    case XmlReader::token_close:
+      return false;
+    case XmlReader::token_text:
+      if (text != nullptr)
+        text->append(reader->text());
+      break;
+    default:
+      throw torrent::internal_error("xml_next_child() reached the end of the document.");
+    }
+  }
+}
+
+// Skips the rest of the element at 'depth', call with the depth just
+// after the element was opened.
+static void
+xml_skip_to(XmlReader* reader, size_t depth) {
+  while (reader->depth() >= depth)
+    reader->next();
+}
+
+static void
+xml_skip_element(XmlReader* reader) {
+  xml_skip_to(reader, reader->depth());
+}
+
+static void
+xml_skip_children(XmlReader* reader) {
+  while (xml_next_child(reader, nullptr))
+    xml_skip_element(reader);
+}
+
+// Moves to the first child element with 'name', as FirstChildElement
+// in tinyxml2. Returns false after closing the current element if not
+// found.
+static bool
+xml_find_child(XmlReader* reader, const char* name) {
+  while (xml_next_child(reader, nullptr)) {
+    if (reader->name() == name)
+      return true;
+
+    xml_skip_element(reader);
+  }
+
+  return false;
+}
+
+static void
+xml_require_child(XmlReader* reader, const char* name) {
+  if (!xml_find_child(reader, name))
+    throw rpc_error(XMLRPC_PARSE_ERROR, std::string("could not find expected element ") + name);
+}
+
+// Returns the text of the current element, ignoring child elements.
+static std::string
+xml_read_text(XmlReader* reader) {
+  std::string text;
+
+  while (xml_next_child(reader, &text))
+    xml_skip_element(reader);
+
+  return text;
+}
+
+static int64_t
+xml_text_to_int(const std::string& text) {
+  if (text.empty())
+    throw rpc_error(XMLRPC_TYPE_ERROR, "unable to parse empty integer");
+
+  char* pos;
+  auto  result = std::strtoll(text.c_str(), &pos, 10);
+
+  if (pos == text.c_str() || *pos != '\0')
+    throw rpc_error(XMLRPC_TYPE_ERROR, "unable to parse integer value");
+
+  return result;
+}
+
+static torrent::Object xml_read_value(XmlReader* reader);
+
+static torrent::Object
+xml_read_array(XmlReader* reader) {
+  auto  result   = torrent::Object::create_list();
+  auto& list     = result.as_list();
+  bool  has_data = false;
+
+  while (xml_next_child(reader, nullptr)) {
+    if (has_data || reader->name() != "data") {
+      xml_skip_element(reader);
+      continue;
+    }
+
+    has_data = true;
+
+    while (xml_next_child(reader, nullptr)) {
+      if (reader->name() == "value")
+        list.push_back(xml_read_value(reader));
+      else
+        xml_skip_element(reader);
+    }
+  }
+
+  if (!has_data)
+    throw rpc_error(XMLRPC_PARSE_ERROR, "could not find expected data element in array");
+
+  return result;
+}
+
+static torrent::Object
+xml_read_struct(XmlReader* reader) {
+  auto  result = torrent::Object::create_map();
+  auto& map    = result.as_map();
+
+  while (xml_next_child(reader, nullptr)) {
+    if (reader->name() != "member") {
+      xml_skip_element(reader);
+      continue;
+    }
+
+    std::string     key;
+    torrent::Object value;
+    bool            has_key   = false;
+    bool            has_value = false;
+
+    while (xml_next_child(reader, nullptr)) {
+      if (!has_key && reader->name() == "name") {
+        key     = xml_read_text(reader);
+        has_key = true;
+
+      } else if (!has_value && reader->name() == "value") {
+        value     = xml_read_value(reader);
+        has_value = true;
+
+      } else {
+        xml_skip_element(reader);
+      }
+    }
+
+    if (!has_key)
+      throw rpc_error(XMLRPC_PARSE_ERROR, "could not find expected element name");
+
+    if (!has_value)
+      throw rpc_error(XMLRPC_INTERNAL_ERROR, "received null element to convert");
+
+    map[key] = std::move(value);
+  }
+
+  return result;
+}
+
+static torrent::Object
+xml_read_typed_value(XmlReader* reader) {
+  const std::string& type = reader->name();
+
+  if (type == "string")
+    return torrent::Object(xml_read_text(reader));
+
+  if (type == "i8" || type == "i4" || type == "int")
+    return torrent::Object(xml_text_to_int(xml_read_text(reader)));
+
+  if (type == "boolean") {
+    auto text = xml_read_text(reader);
+
+    if (text == "1")
+      return torrent::Object((int64_t)1);
+    else if (text == "0")
+      return torrent::Object((int64_t)0);
+
+    throw rpc_error(XMLRPC_TYPE_ERROR, "unknown boolean value: " + text);
+  }
+
+  if (type == "array")
+    return xml_read_array(reader);
+
+  if (type == "struct")
+    return xml_read_struct(reader);
+
+  if (type == "base64")
+    return torrent::Object(utils::decode_base64(utils::remove_newlines(xml_read_text(reader))));
+
+  throw rpc_error(XMLRPC_INTERNAL_ERROR, "received unsupported value type: " + type);
+}
+
+// A value without a type element is a string.
+static torrent::Object
+xml_read_value(XmlReader* reader) {
+  std::string text;
+
+  if (!xml_next_child(reader, &text))
+    return torrent::Object(text);
+
+  auto result = xml_read_typed_value(reader);
+
+  xml_skip_children(reader);
+  return result;
+}
+
+static void
+xml_read_params(XmlReader* reader, torrent::Object::list_type* params) {
+  while (xml_next_child(reader, nullptr)) {
+    if (reader->name() != "param") {
+      xml_skip_element(reader);
+      continue;
+    }
+
+    if (!xml_find_child(reader, "value"))
+      throw rpc_error(XMLRPC_INTERNAL_ERROR, "received null element to convert");
+
+    params->push_back(xml_read_value(reader));
+    xml_skip_children(reader);
+  }
+}
+
+// The params of a system.multicall call are an array.
+static void
+xml_read_array_params(XmlReader* reader, torrent::Object::list_type* params) {
+  if (!xml_find_child(reader, "data"))
+    return;
+
+  while (xml_next_child(reader, nullptr)) {
+    if (reader->name() == "value")
+      params->push_back(xml_read_value(reader));
+    else
+      xml_skip_element(reader);
+  }
+
+  xml_skip_children(reader);
+}
+
+// Errors in the values are reported for the call rather than the
+// request, skipping the rest of the params element.
+static void
+xml_read_call_params(XmlReader* reader, RpcCall* call, void (*read_params)(XmlReader*, torrent::Object::list_type*)) {
+  size_t depth = reader->depth();
+
+  try {
+    read_params(reader, &call->params.as_list());
+
+  } catch (rpc_error& e) {
+    call->set_error(e.type(), e.what());
+    call->is_error_after_lookup = true;
+  } catch (torrent::local_error& e) {
+    call->set_error(XMLRPC_INTERNAL_ERROR, e.what());
+    call->is_error_after_lookup = true;
+  }
+
+  xml_skip_to(reader, depth);
+}
+
+// Each call is a struct where the first member is the method name and
+// the second the params, the member names are not checked.
+static RpcCall
+xml_read_multicall_call(XmlReader* reader) {
+  RpcCall call;
+
+  xml_require_child(reader, "struct");
+  xml_require_child(reader, "member");
+  xml_require_child(reader, "value");
+  xml_require_child(reader, "string");
+
+  call.method = xml_read_text(reader);
+
+  // value, member
+  xml_skip_children(reader);
+  xml_skip_children(reader);
+
+  if (xml_find_child(reader, "member")) {
+    if (xml_find_child(reader, "value")) {
+      if (xml_find_child(reader, "array")) {
+        xml_read_call_params(reader, &call, &xml_read_array_params);
+        xml_skip_children(reader);
+      }
+
+      xml_skip_children(reader);
+    }
+
+    xml_skip_children(reader);
+  }
+
+  xml_skip_children(reader);
+  return call;
+}
+
+static void
+xml_read_multicall(XmlReader* reader, RpcBatch* batch) {
+  batch->is_multicall = true;
+
+  xml_require_child(reader, "param");
+  xml_require_child(reader, "value");
+  xml_require_child(reader, "array");
+  xml_require_child(reader, "data");
+
+  while (xml_next_child(reader, nullptr)) {
+    if (reader->name() == "value")
+      batch->calls.push_back(xml_read_multicall_call(reader));
+    else
+      xml_skip_element(reader);
+  }
+
+  // array, value, param, params
+  for (int i = 0; i != 4; i++)
+    xml_skip_children(reader);
+}
+
+static void
+xml_read_request_params(XmlReader* reader, const std::string& method, RpcBatch* batch) {
+  if (method == "system.multicall") {
+    xml_read_multicall(reader, batch);
+    return;
+  }
+
+  RpcCall call;
+  call.method = method;
+
+  xml_read_call_params(reader, &call, &xml_read_params);
+  batch->calls.push_back(std::move(call));
+}
+
+static void
+xml_read_document(XmlReader* reader, RpcBatch* batch) {
+  if (reader->next() != XmlReader::token_open)
+    throw torrent::internal_error("xml_read_document() expected the root element.");
+
+  if (reader->name() != "methodCall") {
+    xml_skip_element(reader);
+    reader->next();
+
+    throw rpc_error(XMLRPC_PARSE_ERROR, "methodCall element not found");
+  }
+
+  std::string method;
+  bool        has_method = false;
+  bool        has_params = false;
+
+  // Params before the method name are read once the name is known,
+  // from a copy of the reader.
+  std::unique_ptr<XmlReader> params_reader;
+
+  while (xml_next_child(reader, nullptr)) {
+    if (!has_method && reader->name() == "methodName") {
+      method     = xml_read_text(reader);
+      has_method = true;
+
+    } else if (!has_params && reader->name() == "params") {
+      has_params = true;
+
+      if (has_method) {
+        xml_read_request_params(reader, method, batch);
+        continue;
+      }
+
+      params_reader = std::make_unique<XmlReader>(*reader);
+      xml_skip_element(reader);
+
+    } else {
+      xml_skip_element(reader);
+    }
+  }
+
+  // Check the rest of the document is well-formed.
+  reader->next();
+
+  if (!has_method)
+    throw rpc_error(XMLRPC_PARSE_ERROR, "methodName element not found");
+
+  if (params_reader) {
+    xml_read_request_params(params_reader.get(), method, batch);
+    return;
+  }
+
+  if (has_params)
+    return;
+
+  if (method == "system.multicall")
+    throw rpc_error(XMLRPC_PARSE_ERROR, "could not find expected element params");
+
+  RpcCall call;
+  call.method = method;
+  batch->calls.push_back(std::move(call));
+}
+
+// Text is escaped and cut at the first null byte the same way as
+// tinyxml2's XMLPrinter, so both backends give identical responses.
+static void
+xml_write_text(std::string* buffer, const std::string& str) {
+  const char* first = str.c_str();
+  const char* itr   = first;
+
+  for (; *itr != '\0'; itr++) {
+    const char* entity;
+
+    switch (*itr) {
+    case '&': entity = "&amp;"; break;
+    case '<': entity = "&lt;"; break;
+    case '>': entity = "&gt;"; break;
+    default:  continue;
+    }
+
+    buffer->append(first, itr);
+    buffer->append(entity);
+    first = itr + 1;
+  }
+
+  buffer->append(first, itr);
+}
+
+static void
+xml_write_object(std::string* buffer, const torrent::Object& obj) {
+  switch (obj.type()) {
+  case torrent::Object::TYPE_STRING:
+    buffer->append("<string>");
+    xml_write_text(buffer, obj.as_string());
+    buffer->append("</string>");
+    break;
+
+  case torrent::Object::TYPE_VALUE:
+    buffer->append("<i8>");
+    buffer->append(std::to_string(obj.as_value()));
+    buffer->append("</i8>");
+    break;
+
+  case torrent::Object::TYPE_LIST:
+    if (obj.as_list().empty()) {
+      buffer->append("<array><data/></array>");
+      break;
+    }
+
+    buffer->append("<array><data>");
+
+    for (const auto& itr : obj.as_list()) {
+      buffer->append("<value>");
+      xml_write_object(buffer, itr);
+      buffer->append("</value>");
+    }
+
+    buffer->append("</data></array>");
+    break;
+
+  case torrent::Object::TYPE_MAP:
+    if (obj.as_map().empty()) {
+      buffer->append("<struct/>");
+      break;
+    }
+
+    buffer->append("<struct>");
+
+    for (const auto& itr : obj.as_map()) {
+      buffer->append("<member><name>");
+      xml_write_text(buffer, itr.first);
+      buffer->append("</name><value>");
+      xml_write_object(buffer, itr.second);
+      buffer->append("</value></member>");
+    }
+
+    buffer->append("</struct>");
+    break;
+
+  case torrent::Object::TYPE_DICT_KEY:
+    buffer->append("<array><data><value>");
+    xml_write_object(buffer, obj.as_dict_key());
+    buffer->append("</value>");
+
+    if (obj.as_dict_obj().is_list()) {
+      for (const auto& itr : obj.as_dict_obj().as_list()) {
+        buffer->append("<value>");
+        xml_write_object(buffer, itr);
+        buffer->append("</value>");
+      }
+    } else {
+      buffer->append("<value>");
+      xml_write_object(buffer, obj.as_dict_obj());
+      buffer->append("</value>");
+    }
+
+    buffer->append("</data></array>");
+    break;
+
+  default:
+    buffer->append("<i8>0</i8>");
+    break;
+  }
+}
+
+static void
+xml_write_fault_struct(std::string* buffer, int fault_code, const std::string& fault_string) {
+  buffer->append("<struct><member><name>faultCode</name><value><i8>");
+  buffer->append(std::to_string(fault_code));
+  buffer->append("</i8></value></member><member><name>faultString</name><value><string>");
+  xml_write_text(buffer, fault_string);
+  buffer->append("</string></value></member></struct>");
+}
+
+static std::string
+xmlrpc_fault_string(int fault_code, const std::string& fault_string) {
+  std::string buffer = "<?xml version=\"1.0\"?><methodResponse><fault><value>";
+
+  xml_write_fault_struct(&buffer, fault_code, fault_string);
+
+  buffer.append("</value></fault></methodResponse>");
+  return buffer;
+}
+
+static void
+execute_command(RpcCall* call) {
+  CommandMap::iterator cmd_itr = commands.find(call->method.c_str());
+
+  if (cmd_itr == commands.end() || !(cmd_itr->second.m_flags & CommandMap::flag_public_rpc))
+    throw rpc_error(XMLRPC_NO_SUCH_METHOD_ERROR, "method '" + call->method + "' not defined");
+
+  call->is_known_method = true;
+
+  if (call->has_error)
+    throw rpc_error(call->error_code, call->error_message);
+
+  torrent::Object::list_type& params = call->params.as_list();
+  rpc::target_type            target = rpc::make_target();
+
+  std::function<void()> deleter = []() {};
+  utils::scope_guard    guard([&deleter]() { deleter(); });
+
+  if (!params.empty()) {
+    RpcManager::object_to_target(params.front(), cmd_itr->second.m_flags, &target, &deleter);
+    params.erase(params.begin());
+  }
+
+  if (params.empty() && (cmd_itr->second.m_flags & (CommandMap::flag_file_target | CommandMap::flag_tracker_target)))
+    throw rpc_error(XMLRPC_TYPE_ERROR, "invalid parameters: too few");
+
+  call->result = rpc::commands.call_command(cmd_itr, call->params, target);
+}
+
+static void
+execute_call(RpcCall* call) {
+  if (call->has_error && !call->is_error_after_lookup)
+    return;
+
+  try {
+    execute_command(call);
+    return;
+
+  } catch (rpc_error& e) {
+    call->set_error(e.type(), e.what());
+  } catch (torrent::local_error& e) {
+    call->set_error(XMLRPC_INTERNAL_ERROR, e.what());
+  }
+
+  call->is_error_after_lookup = false;
+}
+
+void
+XmlRpc::decode(const char* inBuffer, uint32_t length, RpcBatch* batch) {
+  if (length > m_sizeLimit) {
+    batch->set_response(xmlrpc_fault_string(XMLRPC_LIMIT_EXCEEDED_ERROR, "Content size exceeds maximum XML-RPC limit"));
+    return;
+  }
+
+  XmlReader reader(inBuffer, inBuffer + length);
+
+  try {
+    xml_read_document(&reader, batch);
+    return;
+
+  } catch (xml_syntax_error& e) {
+    batch->set_response(xmlrpc_fault_string(XMLRPC_PARSE_ERROR, e.what()));
+  } catch (rpc_error& e) {
+    batch->set_response(xmlrpc_fault_string(e.type(), e.what()));
+  } catch (torrent::local_error& e) {
+    batch->set_response(xmlrpc_fault_string(XMLRPC_INTERNAL_ERROR, e.what()));
+  }
+
+  batch->calls.clear();
+}
+
+void
+XmlRpc::execute(RpcBatch* batch) {
+  if (batch->has_response)
+    return;
+
+  for (auto& call : batch->calls) {
+    auto started = std::chrono::steady_clock::now();
+    execute_call(&call);
+    call.execute_time = std::chrono::steady_clock::now() - started;
+  }
+}
+
+std::string
+XmlRpc::encode(RpcBatch* batch) {
+  std::string response;
+
+  while (!encode_partial(batch, &response, std::string::npos))
+    ;
+
+  return response;
+}
+
+struct XmlRpcEncodeState : public RpcEncodeState {
+  size_t index{0};
+  bool   is_started{false};
+};
+
+// List results and multicalls are written one element at a time.
+bool
+XmlRpc::encode_partial(RpcBatch* batch, std::string* buffer, size_t max_size) {
+  if (batch->has_response) {
+    buffer->append(batch->response);
+    return true;
+  }
+
+  if (!batch->is_multicall) {
+    auto& call = batch->calls.front();
+
+    if (call.has_error) {
+      buffer->append(xmlrpc_fault_string(call.error_code, call.error_message));
+      return true;
+    }
+
+    if (!call.result.is_list()) {
+      buffer->append("<?xml version=\"1.0\"?><methodResponse><params><param><value>");
+      xml_write_object(buffer, call.result);
+      buffer->append("</value></param></params></methodResponse>");
+      return true;
+    }
+  }
+
+  if (!batch->encode_state)
+    batch->encode_state = std::make_unique<XmlRpcEncodeState>();
+
+  auto   state = static_cast<XmlRpcEncodeState*>(batch->encode_state.get());
+  size_t start = buffer->size();
+  size_t size  = batch->is_multicall ? batch->calls.size() : batch->calls.front().result.as_list().size();
+
+  if (!state->is_started) {
+    buffer->append("<?xml version=\"1.0\"?><methodResponse><params><param><value><array>");
+    buffer->append(size == 0 ? "<data/>" : "<data>");
+
+    state->is_started = true;
+  }
+
+  while (state->index != size) {
+    buffer->append("<value>");
+
+    if (batch->is_multicall) {
+      auto& call = batch->calls[state->index];
+
+      if (call.has_error) {
+        xml_write_fault_struct(buffer, call.error_code, call.error_message);
+      } else {
+        buffer->append("<array><data><value>");
+        xml_write_object(buffer, call.result);
+        buffer->append("</value></data></array>");
+      }
+
+      call.result = torrent::Object();
+
+    } else {
+      auto& element = batch->calls.front().result.as_list()[state->index];
+      xml_write_object(buffer, element);
+      element = torrent::Object();
+    }
+
+    buffer->append("</value>");
+    state->index++;
+
+    if (buffer->size() - start >= max_size)
+      return false;
+  }
+
+  if (size != 0)
+    buffer->append("</data>");
+
+  buffer->append("</array></value></param></params></methodResponse>");
+  return true;
+}
+
+bool
+XmlRpc::process(const char* inBuffer, uint32_t length, slot_write slotWrite) {
+  RpcBatch batch;
+
+  decode(inBuffer, length, &batch);
+  execute(&batch);
+
+  std::string response = encode(&batch);
+  return slotWrite(response.c_str(), response.size());
+}
+
+void
+XmlRpc::initialize() { m_isValid = true; }
+void
+XmlRpc::cleanup() {}
+
+void
+XmlRpc::insert_command(const char*, const char*, const char*) {}
+void
+XmlRpc::set_dialect(int) {}
+
+int64_t
+XmlRpc::size_limit() { return static_cast<int64_t>(m_sizeLimit); }
+void
+XmlRpc::set_size_limit(uint64_t size) { m_sizeLimit = size; }
+
+bool
+XmlRpc::is_valid() const { return m_isValid; }
+
+} // namespace rpc
+
+#endif
@@ -17,8 +17,10 @@
 
 #include "parse_commands.h"
 #include "rpc/tinyxml2/tinyxml2.h"
+#include "rpc/rpc_batch.h"
 #include "rpc/rpc_manager.h"
 #include "utils/base64.h"
+#include "utils/functional.h"
 #include "xmlrpc.h"
 
 namespace rpc {
@@ -186,109 +188,129 @@ print_object_xml(const torrent::Object& obj, tinyxml2::XMLPrinter* printer) {
   }
 }
 
-torrent::Object
-execute_command(std::string method_name, const tinyxml2::XMLElement* params_element) {
-  CommandMap::iterator cmd_itr = commands.find(method_name.c_str());
+void
+xml_params_to_list(const tinyxml2::XMLElement* params_element, torrent::Object::list_type* params) {
+  if (params_element == nullptr)
+    return;
+
+  if (std::strncmp(params_element->Name(), "params", sizeof("params")) == 0) {
+    for (auto child = params_element->FirstChildElement("param"); child; child = child->NextSiblingElement("param"))
+      params->push_back(xml_value_to_object(child->FirstChildElement("value")));
+
+  } else if (params_element->FirstChildElement("data") != nullptr) {
+    // If it's not a <params>, it's probably a <array> passed in via system.multicall
+    for (auto child = params_element->FirstChildElement("data")->FirstChildElement("value"); child; child = child->NextSiblingElement("value"))
+      params->push_back(xml_value_to_object(child));
+  }
+}
 
-  if (cmd_itr == commands.end() || !(cmd_itr->second.m_flags & CommandMap::flag_public_rpc)) {
-    throw rpc_error(XMLRPC_NO_SUCH_METHOD_ERROR, "method '" + method_name + "' not defined");
+RpcCall
+xml_decode_call(const char* method_name, const tinyxml2::XMLElement* params_element) {
+  RpcCall call;
+  call.method = method_name != nullptr ? method_name : "";
+
+  try {
+    xml_params_to_list(params_element, &call.params.as_list());
+
+  } catch (rpc_error& e) {
+    call.set_error(e.type(), e.what());
+    call.is_error_after_lookup = true;
+  } catch (torrent::local_error& e) {
+    call.set_error(XMLRPC_INTERNAL_ERROR, e.what());
+    call.is_error_after_lookup = true;
   }
 
-  torrent::Object             params_raw = torrent::Object::create_list();
-  torrent::Object::list_type& params     = params_raw.as_list();
-  rpc::target_type            target     = rpc::make_target();
+  return call;
+}
 
-  if (params_element != nullptr) {
-    if (std::strncmp(params_element->Name(), "params", sizeof("params")) == 0) {
-      // Parse out the target if available
-      const auto* child = params_element->FirstChildElement("param");
+void
+decode_document(const tinyxml2::XMLDocument* doc, RpcBatch* batch) {
+  if (doc->Error())
+    throw rpc_error(XMLRPC_PARSE_ERROR, doc->ErrorStr());
+  if (doc->FirstChildElement("methodCall") == nullptr)
+    throw rpc_error(XMLRPC_PARSE_ERROR, "methodCall element not found");
+  if (doc->FirstChildElement("methodCall")->FirstChildElement("methodName") == nullptr)
+    throw rpc_error(XMLRPC_PARSE_ERROR, "methodName element not found");
+  auto method_name = doc->FirstChildElement("methodCall")->FirstChildElement("methodName")->GetText();
 
-      if (child != nullptr) {
-        std::function<void()> deleter = []() {};
+  // Add a shim here for system.multicall to allow better code reuse, and
+  // because system.multicall is one of the few methods that doesn't take a target
+  if (method_name == nullptr || std::strcmp(method_name, "system.multicall") != 0) {
+    batch->calls.push_back(xml_decode_call(method_name, doc->FirstChildElement("methodCall")->FirstChildElement("params")));
+    return;
+  }
 
-        RpcManager::object_to_target(xml_value_to_object(child->FirstChildElement("value")), cmd_itr->second.m_flags, &target, &deleter);
-        child = child->NextSiblingElement("param");
+  batch->is_multicall = true;
+
+  auto parent_elements = element_access(doc->RootElement(), {"params", "param", "value", "array", "data"});
+  for (auto child = parent_elements->FirstChildElement("value"); child; child = child->NextSiblingElement("value")) {
+    auto sub_method_name = element_access(child, {"struct", "member", "value", "string"})->GetText();
+    // If sub_params ends up a nullptr at the end of this if-chian,
+    // the call gets an empty list
+    auto sub_params = element_access(child, {"struct", "member"});
+    if (sub_params != nullptr)
+      sub_params = sub_params->NextSiblingElement("member");
+    if (sub_params != nullptr)
+      sub_params = sub_params->FirstChildElement("value");
+    if (sub_params != nullptr)
+      sub_params = sub_params->FirstChildElement("array");
+
+    batch->calls.push_back(xml_decode_call(sub_method_name, sub_params));
+  }
+}
 
-        // Parse out any other params
-        while (child != nullptr) {
-          params.push_back(xml_value_to_object(child->FirstChildElement("value")));
-          child = child->NextSiblingElement("param");
-        }
-      }
+void
+execute_command(RpcCall* call) {
+  CommandMap::iterator cmd_itr = commands.find(call->method.c_str());
 
-    } else if (params_element->FirstChildElement("data") != nullptr) {
-      // If it's not a <params>, it's probably a <array> passed in via system.multicall
-      const auto* child = params_element->FirstChildElement("data")->FirstChildElement("value");
+  if (cmd_itr == commands.end() || !(cmd_itr->second.m_flags & CommandMap::flag_public_rpc)) {
+    throw rpc_error(XMLRPC_NO_SUCH_METHOD_ERROR, "method '" + call->method + "' not defined");
+  }
 
-      if (child != nullptr) {
-        std::function<void()> deleter = []() {};
+  call->is_known_method = true;
 
-        RpcManager::object_to_target(xml_value_to_object(child), cmd_itr->second.m_flags, &target, &deleter);
-        child = child->NextSiblingElement("value");
+  if (call->has_error)
+    throw rpc_error(call->error_code, call->error_message);
 
-        while (child != nullptr) {
-          params.push_back(xml_value_to_object(child));
-          child = child->NextSiblingElement("value");
-        }
-      }
-    }
+  torrent::Object::list_type& params = call->params.as_list();
+  rpc::target_type            target = rpc::make_target();
+
+  std::function<void()> deleter = []() {};
+  utils::scope_guard    guard([&deleter]() { deleter(); });
+
+  // Parse out the target if available
+  if (!params.empty()) {
+    RpcManager::object_to_target(params.front(), cmd_itr->second.m_flags, &target, &deleter);
+    params.erase(params.begin());
   }
 
   if (params.empty() && (cmd_itr->second.m_flags & (CommandMap::flag_file_target | CommandMap::flag_tracker_target))) {
     throw rpc_error(XMLRPC_TYPE_ERROR, "invalid parameters: too few");
   }
 
-  return rpc::commands.call_command(cmd_itr, params_raw, target);
+  call->result = rpc::commands.call_command(cmd_itr, call->params, target);
 }
 
 void
-process_document(const tinyxml2::XMLDocument* doc, tinyxml2::XMLPrinter* printer) {
-  if (doc->Error())
-    throw rpc_error(XMLRPC_PARSE_ERROR, doc->ErrorStr());
-  if (doc->FirstChildElement("methodCall") == nullptr)
-    throw rpc_error(XMLRPC_PARSE_ERROR, "methodCall element not found");
-  if (doc->FirstChildElement("methodCall")->FirstChildElement("methodName") == nullptr)
-    throw rpc_error(XMLRPC_PARSE_ERROR, "methodName element not found");
-  auto            method_name = doc->FirstChildElement("methodCall")->FirstChildElement("methodName")->GetText();
-  torrent::Object result;
+execute_call(RpcCall* call) {
+  if (call->has_error && !call->is_error_after_lookup)
+    return;
 
-  // Add a shim here for system.multicall to allow better code reuse, and
-  // because system.multicall is one of the few methods that doesn't take a target
-  if (method_name == std::string("system.multicall")) {
-    result                = torrent::Object::create_list();
-    auto& result_list     = result.as_list();
-    auto  parent_elements = element_access(doc->RootElement(), {"params", "param", "value", "array", "data"});
-    for (auto child = parent_elements->FirstChildElement("value"); child; child = child->NextSiblingElement("value")) {
-      auto sub_method_name = element_access(child, {"struct", "member", "value", "string"})->GetText();
-      // If sub_params ends up a nullptr at the end of this if-chian,
-      // execute_command will turn it into an empty list
-      auto sub_params = element_access(child, {"struct", "member"});
-      if (sub_params != nullptr)
-        sub_params = sub_params->NextSiblingElement("member");
-      if (sub_params != nullptr)
-        sub_params = sub_params->FirstChildElement("value");
-      if (sub_params != nullptr)
-        sub_params = sub_params->FirstChildElement("array");
-      try {
-        auto sub_result = torrent::Object::create_list();
-        sub_result.as_list().push_back(execute_command(sub_method_name, sub_params));
-        result_list.push_back(sub_result);
-      } catch (rpc_error& e) {
-        auto fault                    = torrent::Object::create_map();
-        fault.as_map()["faultString"] = e.what();
-        fault.as_map()["faultCode"]   = e.type();
-        result_list.push_back(fault);
-      } catch (torrent::local_error& e) {
-        auto fault                    = torrent::Object::create_map();
-        fault.as_map()["faultString"] = e.what();
-        fault.as_map()["faultCode"]   = XMLRPC_INTERNAL_ERROR;
-        result_list.push_back(fault);
-      }
-    }
-  } else {
-    result = execute_command(method_name, doc->FirstChildElement("methodCall")->FirstChildElement("params"));
+  try {
+    execute_command(call);
+    return;
+
+  } catch (rpc_error& e) {
+    call->set_error(e.type(), e.what());
+  } catch (torrent::local_error& e) {
+    call->set_error(XMLRPC_INTERNAL_ERROR, e.what());
   }
 
+  call->is_error_after_lookup = false;
+}
+
+void
+print_xmlrpc_response(const torrent::Object& result, tinyxml2::XMLPrinter* printer) {
   printer->PushHeader(false, true);
   printer->OpenElement("methodResponse", true);
   printer->OpenElement("params", true);
@@ -340,31 +362,164 @@ print_xmlrpc_fault(int faultCode, std::string faultString, tinyxml2::XMLPrinter*
   printer->CloseElement(true);
 }
 
-bool
-XmlRpc::process(const char* inBuffer, uint32_t length, slot_write slotWrite) {
+std::string
+xmlrpc_fault_string(int faultCode, std::string faultString) {
+  tinyxml2::XMLPrinter printer(nullptr, true, 0);
+  print_xmlrpc_fault(faultCode, faultString, &printer);
+  return std::string(printer.CStr(), printer.CStrSize() - 1);
+}
+
+void
+XmlRpc::decode(const char* inBuffer, uint32_t length, RpcBatch* batch) {
   if (length > m_sizeLimit) {
-    tinyxml2::XMLPrinter printer(nullptr, true, 0);
-    print_xmlrpc_fault(XMLRPC_LIMIT_EXCEEDED_ERROR, "Content size exceeds maximum XML-RPC limit", &printer);
-    return slotWrite(printer.CStr(), printer.CStrSize() - 1);
+    batch->set_response(xmlrpc_fault_string(XMLRPC_LIMIT_EXCEEDED_ERROR, "Content size exceeds maximum XML-RPC limit"));
+    return;
   }
+
   tinyxml2::XMLDocument doc;
   doc.Parse(inBuffer, length);
+
   try {
-    // This printer can't be reused in the 'catch' because while the
-    // buffer can be cleared, the internal stack of opened elements
-    // remains.
-    tinyxml2::XMLPrinter printer(nullptr, true, 0);
-    process_document(&doc, &printer);
-    return slotWrite(printer.CStr(), printer.CStrSize() - 1);
+    decode_document(&doc, batch);
   } catch (rpc_error& e) {
-    tinyxml2::XMLPrinter printer(nullptr, true, 0);
-    print_xmlrpc_fault(e.type(), e.what(), &printer);
-    return slotWrite(printer.CStr(), printer.CStrSize() - 1);
+    batch->set_response(xmlrpc_fault_string(e.type(), e.what()));
   } catch (torrent::local_error& e) {
-    tinyxml2::XMLPrinter printer(nullptr, true, 0);
-    print_xmlrpc_fault(XMLRPC_INTERNAL_ERROR, e.what(), &printer);
-    return slotWrite(printer.CStr(), printer.CStrSize() - 1);
+    batch->set_response(xmlrpc_fault_string(XMLRPC_INTERNAL_ERROR, e.what()));
+  }
+}
+
+void
+XmlRpc::execute(RpcBatch* batch) {
+  if (batch->has_response)
+    return;
+
+  for (auto& call : batch->calls) {
+    auto started = std::chrono::steady_clock::now();
+    execute_call(&call);
+    call.execute_time = std::chrono::steady_clock::now() - started;
+  }
+}
+
+std::string
+XmlRpc::encode(RpcBatch* batch) {
+  std::string response;
+
+  while (!encode_partial(batch, &response, std::string::npos))
+    ;
+
+  return response;
+}
+
+struct XmlRpcEncodeState : public RpcEncodeState {
+  // Keeps the open elements between parts of the response.
+  tinyxml2::XMLPrinter printer{nullptr, true, 0};
+
+  size_t               index{0};
+  bool                 is_started{false};
+};
+
+static torrent::Object
+xmlrpc_multicall_result(RpcCall* call) {
+  if (call->has_error) {
+    auto fault                    = torrent::Object::create_map();
+    fault.as_map()["faultString"] = call->error_message;
+    fault.as_map()["faultCode"]   = call->error_code;
+    return fault;
   }
+
+  auto sub_result = torrent::Object::create_list();
+  sub_result.as_list().push_back(std::move(call->result));
+  return sub_result;
+}
+
+static void
+xmlrpc_flush_printer(tinyxml2::XMLPrinter* printer, std::string* buffer) {
+  buffer->append(printer->CStr(), printer->CStrSize() - 1);
+  printer->ClearBuffer(false);
+}
+
+// List results and multicalls are written one element at a time, the
+// output is identical to printing the whole result at once.
+bool
+XmlRpc::encode_partial(RpcBatch* batch, std::string* buffer, size_t max_size) {
+  if (batch->has_response) {
+    buffer->append(batch->response);
+    return true;
+  }
+
+  if (!batch->is_multicall) {
+    auto& call = batch->calls.front();
+
+    if (call.has_error) {
+      buffer->append(xmlrpc_fault_string(call.error_code, call.error_message));
+      return true;
+    }
+
+    if (!call.result.is_list()) {
+      tinyxml2::XMLPrinter printer(nullptr, true, 0);
+      print_xmlrpc_response(call.result, &printer);
+      buffer->append(printer.CStr(), printer.CStrSize() - 1);
+      return true;
+    }
+  }
+
+  if (!batch->encode_state)
+    batch->encode_state = std::make_unique<XmlRpcEncodeState>();
+
+  auto  state   = static_cast<XmlRpcEncodeState*>(batch->encode_state.get());
+  auto& printer = state->printer;
+
+  if (!state->is_started) {
+    printer.PushHeader(false, true);
+    printer.OpenElement("methodResponse", true);
+    printer.OpenElement("params", true);
+    printer.OpenElement("param", true);
+    printer.OpenElement("value", true);
+    printer.OpenElement("array", true);
+    printer.OpenElement("data", true);
+
+    state->is_started = true;
+  }
+
+  size_t size = batch->is_multicall ? batch->calls.size() : batch->calls.front().result.as_list().size();
+
+  while (state->index != size) {
+    printer.OpenElement("value", true);
+
+    if (batch->is_multicall) {
+      print_object_xml(xmlrpc_multicall_result(&batch->calls[state->index]), &printer);
+    } else {
+      auto& element = batch->calls.front().result.as_list()[state->index];
+      print_object_xml(element, &printer);
+      element = torrent::Object();
+    }
+
+    printer.CloseElement(true);
+    state->index++;
+
+    if ((size_t)printer.CStrSize() - 1 >= max_size) {
+      xmlrpc_flush_printer(&printer, buffer);
+      return false;
+    }
+  }
+
+  // data, array, value, param, params, methodResponse
+  for (int i = 0; i != 6; i++)
+    printer.CloseElement(true);
+
+  xmlrpc_flush_printer(&printer, buffer);
+  return true;
+}
+
+bool
+XmlRpc::process(const char* inBuffer, uint32_t length, slot_write slotWrite) {
+  RpcBatch batch;
+
+  decode(inBuffer, length, &batch);
+  execute(&batch);
+
+  std::string response = encode(&batch);
+  return slotWrite(response.c_str(), response.size());
 }
 
 void
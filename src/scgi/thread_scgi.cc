@@ -19,6 +19,8 @@ public:
 
 ThreadScgi* ThreadScgi::m_thread_scgi{};
 
+std::vector<torrent::utils::Thread*> ThreadScgi::m_workers;
+
 void
 ThreadScgi::create_thread() {
   auto thread = new ThreadScgi;
@@ -29,6 +31,13 @@ ThreadScgi::create_thread() {
 
 void
 ThreadScgi::destroy_thread() {
+  stop_workers();
+
+  for (auto thread : m_workers)
+    delete thread;
+
+  m_workers.clear();
+
   delete m_thread_scgi;
   m_thread_scgi = nullptr;
 }
@@ -38,10 +47,41 @@ ThreadScgi::thread_scgi() {
   return m_thread_scgi;
 }
 
+// Must be called before any listener is activated, the set of workers
+// does not change while the listeners are handing off connections.
+void
+ThreadScgi::start_workers(unsigned int count) {
+  if (count == 0 || count > 64)
+    throw torrent::input_error("Invalid number of SCGI threads.");
+
+  if (!m_workers.empty())
+    throw torrent::internal_error("ThreadScgi::start_workers() called while workers are running.");
+
+  for (unsigned int i = 1; i < count; i++) {
+    auto thread = new ThreadScgi;
+
+    thread->m_name  = "rtorrent-scgi-" + std::to_string(i);
+    thread->m_state = STATE_INITIALIZED;
+
+    m_workers.push_back(thread);
+    thread->start_thread();
+  }
+}
+
+void
+ThreadScgi::stop_workers() {
+  for (auto thread : m_workers)
+    if (thread->is_active())
+      thread->stop_thread_wait();
+}
+
 void
 ThreadScgi::cleanup_thread() {
   if (m_scgi != nullptr)
     m_scgi.load()->deactivate();
+
+  if (m_http != nullptr)
+    m_http.load()->deactivate();
 }
 
 rpc::SCgi*
@@ -51,18 +91,32 @@ ThreadScgi::scgi() {
 
 bool
 ThreadScgi::set_scgi(rpc::SCgi* scgi) {
+  return set_listener(m_scgi, scgi);
+}
+
+rpc::SCgi*
+ThreadScgi::http() {
+  return m_http;
+}
+
+bool
+ThreadScgi::set_http(rpc::SCgi* http) {
+  return set_listener(m_http, http);
+}
+
+bool
+ThreadScgi::set_listener(std::atomic<rpc::SCgi*>& listener, rpc::SCgi* scgi) {
   rpc::SCgi* expected = nullptr;
 
-  if (!m_scgi.compare_exchange_strong(expected, scgi))
+  if (!listener.compare_exchange_strong(expected, scgi))
     return false;
 
-  change_rpc_log();
-
-  callback(nullptr, [this]() {
-      if (m_scgi == NULL)
+  callback(nullptr, [this, &listener]() {
+      if (listener == NULL)
         throw torrent::internal_error("Tried to start SCGI but object was not present.");
 
-      m_scgi.load()->activate();
+      listener.load()->set_log_fd(m_rpc_log_fd);
+      listener.load()->activate();
     });
 
   return true;
@@ -76,28 +130,29 @@ ThreadScgi::set_rpc_log(const std::string& filename) {
     });
 }
 
+// The log is shared by the SCGI and HTTP listeners.
 void
 ThreadScgi::change_rpc_log() {
-  if (scgi() == NULL)
-    return;
-
-  if (scgi()->log_fd() != -1) {
-    ::close(scgi()->log_fd());
-    scgi()->set_log_fd(-1);
+  if (m_rpc_log_fd != -1) {
+    ::close(m_rpc_log_fd);
+    m_rpc_log_fd = -1;
     lt_log_print(torrent::LOG_NOTICE, "Closed RPC log.", 0);
   }
 
-  if (m_rpc_log_filename.empty())
-    return;
-
-  scgi()->set_log_fd(open(rak::path_expand(m_rpc_log_filename).c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644));
+  if (!m_rpc_log_filename.empty()) {
+    m_rpc_log_fd = open(rak::path_expand(m_rpc_log_filename).c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644);
 
-  if (scgi()->log_fd() == -1) {
-    lt_log_print(torrent::LOG_NOTICE, "Could not open RPC log file '%s'.", m_rpc_log_filename.c_str());
-    return;
+    if (m_rpc_log_fd == -1)
+      lt_log_print(torrent::LOG_NOTICE, "Could not open RPC log file '%s'.", m_rpc_log_filename.c_str());
+    else
+      lt_log_print(torrent::LOG_NOTICE, "Logging RPC events to '%s'.", m_rpc_log_filename.c_str());
   }
 
-  lt_log_print(torrent::LOG_NOTICE, "Logging RPC events to '%s'.", m_rpc_log_filename.c_str());
+  if (scgi() != NULL)
+    scgi()->set_log_fd(m_rpc_log_fd);
+
+  if (http() != NULL)
+    http()->set_log_fd(m_rpc_log_fd);
 }
 
 void
@@ -133,6 +188,13 @@ void cancel_callback_and_wait(void* target)              { scgi::ThreadScgiInter
 
 rpc::SCgi*  scgi()                                       { return scgi::ThreadScgiInternal::thread_scgi()->scgi(); }
 void        set_scgi(rpc::SCgi* scgi)                    { scgi::ThreadScgiInternal::thread_scgi()->set_scgi(scgi); }
+rpc::SCgi*  http()                                       { return scgi::ThreadScgiInternal::thread_scgi()->http(); }
+void        set_http(rpc::SCgi* http)                    { scgi::ThreadScgiInternal::thread_scgi()->set_http(http); }
 void        set_rpc_log(const std::string& filename)     { scgi::ThreadScgiInternal::thread_scgi()->set_rpc_log(filename); }
 
+void        start_workers(unsigned int count)            { scgi::ThreadScgi::start_workers(count); }
+void        stop_workers()                               { scgi::ThreadScgi::stop_workers(); }
+
+const std::vector<torrent::utils::Thread*>& workers()    { return scgi::ThreadScgi::workers(); }
+
 } // namespace scgi_thread
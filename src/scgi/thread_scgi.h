@@ -2,7 +2,9 @@
 #define RTORRENT_SCGI_THREAD_SCGI_H
 
 #include <atomic>
+#include <memory>
 #include <string>
+#include <vector>
 #include <torrent/utils/thread.h>
 
 namespace rpc {
@@ -20,11 +22,23 @@ public:
   static void         destroy_thread();
   static ThreadScgi*  thread_scgi();
 
-  const char*         name() const override  { return "rtorrent-scgi"; }
+  // Additional threads that serve connections accepted by the
+  // listeners on the main SCGI thread, each with its own poll and set
+  // of tasks. The count includes the main SCGI thread.
+  static void         start_workers(unsigned int count);
+  static void         stop_workers();
+
+  static const std::vector<torrent::utils::Thread*>& workers() { return m_workers; }
+
+  const char*         name() const override  { return m_name.c_str(); }
 
   rpc::SCgi*          scgi();
   bool                set_scgi(rpc::SCgi* scgi);
 
+  // Optional HTTP listener, served by the same poll loop as SCGI.
+  rpc::SCgi*          http();
+  bool                set_http(rpc::SCgi* http);
+
   void                set_rpc_log(const std::string& filename);
 
 protected:
@@ -40,12 +54,20 @@ protected:
   std::chrono::microseconds next_timeout() override;
 
 private:
+  bool                set_listener(std::atomic<rpc::SCgi*>& listener, rpc::SCgi* scgi);
+
   void                task_touch_log();
   void                change_rpc_log();
 
   static ThreadScgi*  m_thread_scgi;
 
+  static std::vector<torrent::utils::Thread*> m_workers;
+
+  std::string             m_name{"rtorrent-scgi"};
+
   std::atomic<rpc::SCgi*> m_scgi{nullptr};
+  std::atomic<rpc::SCgi*> m_http{nullptr};
+  int                     m_rpc_log_fd{-1};
   std::string             m_rpc_log_filename;
 };
 
@@ -0,0 +1,288 @@
+#include "config.h"
+
+#include "test/core/test_custom_attributes.h"
+
+#include <cstring>
+
+#include "control.h"
+#include "globals.h"
+#include "command_helpers.h"
+#include "core/custom_attributes.h"
+#include "core/view_expression.h"
+#include "rpc/parse.h"
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TestCustomAttributes);
+
+void initialize_command_dynamic();
+void initialize_command_ui();
+
+typedef core::CustomAttributes CustomAttributes;
+typedef core::CustomIndex      CustomIndex;
+
+torrent::Object
+custom_attributes_test_get([[maybe_unused]] rpc::target_type t, [[maybe_unused]] const std::string& key) {
+  return std::string();
+}
+
+// The index only uses the downloads as keys, so they are never
+// dereferenced.
+static char custom_test_downloads[3];
+
+static core::Download*
+test_download(int i) {
+  return reinterpret_cast<core::Download*>(&custom_test_downloads[i]);
+}
+
+// Same order as DownloadList::set_custom().
+static void
+index_set(CustomIndex* index, core::Download* download, CustomAttributes* custom, const std::string& key, const torrent::Object& value) {
+  auto id = CustomAttributes::key(key);
+
+  index->erase(download, *custom, id);
+  custom->set(id, value);
+  index->insert(download, *custom, id);
+}
+
+static size_t
+index_count(const CustomIndex& index, const std::string& key, const torrent::Object& value) {
+  auto set = index.find(CustomAttributes::key(key), value);
+
+  return set != NULL ? set->size() : size_t(-1);
+}
+
+static bool
+index_contains(const CustomIndex& index, const std::string& key, const torrent::Object& value, core::Download* download) {
+  auto set = index.find(CustomAttributes::key(key), value);
+
+  return set != NULL && set->find(download) != set->end();
+}
+
+static torrent::Object
+make_expression(const char* str) {
+  if (*str != '(')
+    return std::string(str);
+
+  torrent::Object obj = torrent::Object::create_list();
+  rpc::parse_whole_list(str, str + std::strlen(str), &obj, &rpc::parse_is_delim_command);
+
+  if (obj.is_list() && obj.as_list().size() == 1) {
+    torrent::Object tmp = obj.as_list().front();
+    obj = tmp;
+  }
+
+  return obj;
+}
+
+void
+TestCustomAttributes::setUp() {
+  m_test_main_thread = TestMainThread::create();
+  m_test_main_thread->init_thread();
+
+  if (rpc::commands.find("method.insert") == rpc::commands.end()) {
+    setlocale(LC_ALL, "");
+    control = new Control;
+
+    initialize_command_dynamic();
+    initialize_command_ui();
+  }
+
+  if (rpc::commands.find("d.custom") == rpc::commands.end())
+    CMD2_ANY_STRING("d.custom", &custom_attributes_test_get);
+}
+
+void
+TestCustomAttributes::tearDown() {
+  m_test_main_thread.reset();
+}
+
+void
+TestCustomAttributes::test_attributes() {
+  auto key1 = CustomAttributes::key("test_attributes.1");
+  auto key2 = CustomAttributes::key("test_attributes.2");
+
+  CPPUNIT_ASSERT(CustomAttributes::key("test_attributes.1") == key1);
+  CPPUNIT_ASSERT(CustomAttributes::key_name(key2) == "test_attributes.2");
+
+  CustomAttributes::key_type found;
+
+  CPPUNIT_ASSERT(CustomAttributes::find_key("test_attributes.2", &found) && found == key2);
+  CPPUNIT_ASSERT(!CustomAttributes::find_key("test_attributes.unknown", &found));
+
+  CustomAttributes custom;
+
+  CPPUNIT_ASSERT(custom.empty());
+  CPPUNIT_ASSERT(custom.find(key1) == NULL);
+
+  custom.set(key2, std::string("foo"));
+  custom.set(key1, int64_t(5));
+
+  CPPUNIT_ASSERT(custom.find(key1)->is_value() && custom.find(key1)->as_value() == 5);
+  CPPUNIT_ASSERT(custom.find(key2)->is_string() && custom.find(key2)->as_string() == "foo");
+
+  custom.set(key1, std::string("bar"));
+  CPPUNIT_ASSERT(custom.find(key1)->is_string() && custom.find(key1)->as_string() == "bar");
+
+  std::vector<CustomAttributes::key_type> keys;
+  custom.for_each([&keys](CustomAttributes::key_type key, const torrent::Object&) { keys.push_back(key); });
+
+  CPPUNIT_ASSERT(keys.size() == 2 && keys[0] < keys[1]);
+
+  CPPUNIT_ASSERT_THROW(custom.set(key1, torrent::Object::create_list()), torrent::internal_error);
+}
+
+// Integers set with 'd.custom.set' are saved as integers in the
+// session's "rtorrent/custom" map and must load back as integers.
+void
+TestCustomAttributes::test_load() {
+  torrent::Object map = torrent::Object::create_map();
+  map.as_map()["test_load.value"]  = int64_t(42);
+  map.as_map()["test_load.string"] = std::string("42");
+  map.as_map()["test_load.list"]   = torrent::Object::create_list();
+
+  CustomAttributes custom;
+  custom.set(CustomAttributes::key("test_load.old"), int64_t(1));
+  custom.load(map);
+
+  const torrent::Object* value  = custom.find(CustomAttributes::key("test_load.value"));
+  const torrent::Object* string = custom.find(CustomAttributes::key("test_load.string"));
+
+  CPPUNIT_ASSERT(value != NULL && value->is_value() && value->as_value() == 42);
+  CPPUNIT_ASSERT(string != NULL && string->is_string() && string->as_string() == "42");
+  CPPUNIT_ASSERT(custom.find(CustomAttributes::key("test_load.list")) == NULL);
+  CPPUNIT_ASSERT(custom.find(CustomAttributes::key("test_load.old")) == NULL);
+
+  custom.load(torrent::Object());
+  CPPUNIT_ASSERT(custom.empty());
+}
+
+void
+TestCustomAttributes::test_index() {
+  auto key       = CustomAttributes::key("test_index.label");
+  auto other_key = CustomAttributes::key("test_index.other");
+
+  CustomIndex      index;
+  CustomAttributes custom[3];
+
+  custom[0].set(key, std::string("foo"));
+  custom[1].set(key, int64_t(1));
+  custom[2].set(other_key, std::string("foo"));
+
+  CPPUNIT_ASSERT(index.find(key, std::string("foo")) == NULL);
+
+  index.insert_key(key);
+
+  for (int i = 0; i != 3; i++)
+    index.insert(test_download(i), custom[i]);
+
+  CPPUNIT_ASSERT(index.is_indexed(key) && !index.is_indexed(other_key));
+  CPPUNIT_ASSERT(index.find(other_key, std::string("foo")) == NULL);
+
+  // Strings and integers with the same text are different values.
+  CPPUNIT_ASSERT(index_count(index, "test_index.label", std::string("foo")) == 1);
+  CPPUNIT_ASSERT(index_contains(index, "test_index.label", std::string("foo"), test_download(0)));
+  CPPUNIT_ASSERT(index_count(index, "test_index.label", int64_t(1)) == 1);
+  CPPUNIT_ASSERT(index_contains(index, "test_index.label", int64_t(1), test_download(1)));
+  CPPUNIT_ASSERT(index_count(index, "test_index.label", std::string("1")) == 0);
+  CPPUNIT_ASSERT(index_count(index, "test_index.label", std::string("bar")) == 0);
+
+  index.erase(test_download(0), custom[0]);
+  CPPUNIT_ASSERT(index_count(index, "test_index.label", std::string("foo")) == 0);
+  CPPUNIT_ASSERT(index_count(index, "test_index.label", int64_t(1)) == 1);
+}
+
+void
+TestCustomAttributes::test_index_set() {
+  CustomIndex      index;
+  CustomAttributes custom[2];
+
+  index.insert_key(CustomAttributes::key("test_index_set.label"));
+
+  index_set(&index, test_download(0), &custom[0], "test_index_set.label", std::string("foo"));
+  index_set(&index, test_download(1), &custom[1], "test_index_set.label", std::string("foo"));
+  CPPUNIT_ASSERT(index_count(index, "test_index_set.label", std::string("foo")) == 2);
+
+  index_set(&index, test_download(0), &custom[0], "test_index_set.label", std::string("bar"));
+  CPPUNIT_ASSERT(index_count(index, "test_index_set.label", std::string("foo")) == 1);
+  CPPUNIT_ASSERT(index_contains(index, "test_index_set.label", std::string("foo"), test_download(1)));
+  CPPUNIT_ASSERT(index_contains(index, "test_index_set.label", std::string("bar"), test_download(0)));
+
+  index_set(&index, test_download(1), &custom[1], "test_index_set.label", int64_t(7));
+  CPPUNIT_ASSERT(index_count(index, "test_index_set.label", std::string("foo")) == 0);
+  CPPUNIT_ASSERT(index_contains(index, "test_index_set.label", int64_t(7), test_download(1)));
+
+  // Keys that aren't indexed are ignored.
+  index_set(&index, test_download(0), &custom[0], "test_index_set.other", std::string("bar"));
+  CPPUNIT_ASSERT(index.find(CustomAttributes::key("test_index_set.other"), std::string("bar")) == NULL);
+  CPPUNIT_ASSERT(index_count(index, "test_index_set.label", std::string("bar")) == 1);
+}
+
+// As 'custom.index.insert' does for downloads already in the list.
+void
+TestCustomAttributes::test_index_insert_key() {
+  auto key = CustomAttributes::key("test_index_insert_key.label");
+
+  CustomIndex      index;
+  CustomAttributes custom[3];
+
+  custom[0].set(key, std::string("foo"));
+  custom[1].set(key, std::string("foo"));
+
+  for (int i = 0; i != 3; i++)
+    index.insert(test_download(i), custom[i]);
+
+  CPPUNIT_ASSERT(index.find(key, std::string("foo")) == NULL);
+
+  index.insert_key(key);
+
+  for (int i = 0; i != 3; i++)
+    index.insert(test_download(i), custom[i], key);
+
+  CPPUNIT_ASSERT(index.keys().size() == 1 && index.keys().front() == key);
+  CPPUNIT_ASSERT(index_count(index, "test_index_insert_key.label", std::string("foo")) == 2);
+  CPPUNIT_ASSERT(!index_contains(index, "test_index_insert_key.label", std::string("foo"), test_download(2)));
+}
+
+void
+TestCustomAttributes::test_custom_equal() {
+  struct custom_equal_test {
+    const char*     expression;
+    bool            is_custom_equal;
+    torrent::Object value;
+  };
+
+  std::vector<custom_equal_test> tests = {
+    {"equal={d.custom=label,cat=foo}", true, std::string("foo")},
+    {"equal={cat=foo,d.custom=label}", true, std::string("foo")},
+    {"equal={d.custom=label,value=5}", true, int64_t(5)},
+    {"((equal,((d.custom,label)),((cat,foo))))", true, std::string("foo")},
+    {"((equal,d.custom=label,((value,7))))", true, int64_t(7)},
+
+    // An empty string also matches downloads without the attribute.
+    {"equal={d.custom=label,cat=}", false, torrent::Object()},
+    {"((equal,((d.custom,label)),((cat))))", false, torrent::Object()},
+
+    {"equal={d.custom=label,cat=$cat=foo}", false, torrent::Object()},
+    {"equal={d.custom=$cat=label,cat=foo}", false, torrent::Object()},
+    {"equal={d.custom=label,d.custom=other}", false, torrent::Object()},
+    {"equal=d.custom=label", false, torrent::Object()},
+    {"less={d.custom=label,cat=foo}", false, torrent::Object()},
+  };
+
+  for (auto& test : tests) {
+    core::ViewExpression expression(make_expression(test.expression));
+
+    CPPUNIT_ASSERT_MESSAGE(test.expression, expression.is_custom_equal() == test.is_custom_equal);
+
+    if (!test.is_custom_equal)
+      continue;
+
+    CPPUNIT_ASSERT_MESSAGE(test.expression, expression.is_tracked());
+    CPPUNIT_ASSERT_MESSAGE(test.expression, CustomAttributes::key_name(expression.custom_key()) == "label");
+    CPPUNIT_ASSERT_MESSAGE(test.expression, expression.custom_value().type() == test.value.type());
+
+    if (test.value.is_string())
+      CPPUNIT_ASSERT_MESSAGE(test.expression, expression.custom_value().as_string() == test.value.as_string());
+    else
+      CPPUNIT_ASSERT_MESSAGE(test.expression, expression.custom_value().as_value() == test.value.as_value());
+  }
+}
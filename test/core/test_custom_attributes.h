@@ -0,0 +1,29 @@
+#include "test/helpers/test_fixture.h"
+#include "test/helpers/test_main_thread.h"
+
+class TestCustomAttributes : public test_fixture {
+  CPPUNIT_TEST_SUITE(TestCustomAttributes);
+
+  CPPUNIT_TEST(test_attributes);
+  CPPUNIT_TEST(test_load);
+  CPPUNIT_TEST(test_index);
+  CPPUNIT_TEST(test_index_set);
+  CPPUNIT_TEST(test_index_insert_key);
+  CPPUNIT_TEST(test_custom_equal);
+
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  void setUp();
+  void tearDown();
+
+  void test_attributes();
+  void test_load();
+  void test_index();
+  void test_index_set();
+  void test_index_insert_key();
+  void test_custom_equal();
+
+private:
+  std::unique_ptr<TestMainThread> m_test_main_thread;
+};
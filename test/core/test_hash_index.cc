@@ -0,0 +1,166 @@
+#include "config.h"
+
+#include "test/core/test_hash_index.h"
+
+#include <cstring>
+#include <iterator>
+#include <list>
+
+#include "core/hash_index.h"
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TestHashIndex);
+
+// Stands in for DownloadList, with the downloads reduced to their
+// info hashes.
+typedef std::list<torrent::HashString> hash_list;
+typedef core::HashIndex<hash_list::iterator> hash_index;
+
+static torrent::HashString
+make_hash(char c, char last = 0) {
+  torrent::HashString hash;
+  std::memset(hash.data(), c, hash.size());
+  hash.data()[hash.size() - 1] = last;
+
+  return hash;
+}
+
+static hash_list::iterator
+list_insert(hash_list* list, hash_index* index, const torrent::HashString& hash) {
+  auto itr = list->insert(list->end(), hash);
+  index->insert(hash, itr);
+
+  return itr;
+}
+
+static void
+list_erase(hash_list* list, hash_index* index, hash_list::iterator itr) {
+  index->erase(*itr, itr);
+  list->erase(itr);
+}
+
+// Same as DownloadList::erase_ptr(), only erasing an element if the
+// index points to it.
+static bool
+list_erase_ptr(hash_list* list, hash_index* index, const torrent::HashString* element) {
+  auto itr = index->find(*element, list->end());
+
+  if (itr == list->end() || &*itr != element)
+    return false;
+
+  list_erase(list, index, itr);
+  return true;
+}
+
+// Every element is found through the index, and nothing else is
+// indexed.
+static bool
+index_in_sync(hash_list& list, const hash_index& index) {
+  for (auto itr = list.begin(); itr != list.end(); itr++)
+    if (index.find(*itr, list.end()) != itr)
+      return false;
+
+  return index.size() == list.size();
+}
+
+void
+TestHashIndex::test_basic() {
+  hash_list  list;
+  hash_index index;
+
+  CPPUNIT_ASSERT(index.empty());
+  CPPUNIT_ASSERT(index.find(make_hash('a'), list.end()) == list.end());
+
+  auto itr_a = list_insert(&list, &index, make_hash('a'));
+  auto itr_b = list_insert(&list, &index, make_hash('b'));
+  list_insert(&list, &index, make_hash('c'));
+
+  CPPUNIT_ASSERT(index_in_sync(list, index));
+  CPPUNIT_ASSERT(index.find(make_hash('a'), list.end()) == itr_a);
+  CPPUNIT_ASSERT(index.find(make_hash('d'), list.end()) == list.end());
+
+  list_erase(&list, &index, itr_b);
+
+  CPPUNIT_ASSERT(index_in_sync(list, index));
+  CPPUNIT_ASSERT(index.find(make_hash('b'), list.end()) == list.end());
+
+  // Erasing with an iterator the hash doesn't map to is ignored.
+  index.erase(make_hash('a'), std::next(list.begin()));
+  CPPUNIT_ASSERT(index.find(make_hash('a'), list.end()) == itr_a);
+  CPPUNIT_ASSERT(index_in_sync(list, index));
+}
+
+// Hashes sharing the bytes used by the hash function are still
+// different keys.
+void
+TestHashIndex::test_prefix() {
+  hash_list  list;
+  hash_index index;
+
+  auto itr_1 = list_insert(&list, &index, make_hash('a', 1));
+  auto itr_2 = list_insert(&list, &index, make_hash('a', 2));
+
+  CPPUNIT_ASSERT(index_in_sync(list, index));
+  CPPUNIT_ASSERT(index.find(make_hash('a', 1), list.end()) == itr_1);
+  CPPUNIT_ASSERT(index.find(make_hash('a', 2), list.end()) == itr_2);
+  CPPUNIT_ASSERT(index.find(make_hash('a', 3), list.end()) == list.end());
+
+  list_erase(&list, &index, itr_1);
+
+  CPPUNIT_ASSERT(index_in_sync(list, index));
+  CPPUNIT_ASSERT(index.find(make_hash('a', 2), list.end()) == itr_2);
+}
+
+void
+TestHashIndex::test_erase_ptr() {
+  hash_list  list;
+  hash_index index;
+
+  auto itr_a = list_insert(&list, &index, make_hash('a'));
+  auto itr_b = list_insert(&list, &index, make_hash('b'));
+
+  // An element with the same hash that isn't in the list.
+  torrent::HashString other = make_hash('a');
+
+  CPPUNIT_ASSERT(!list_erase_ptr(&list, &index, &other));
+  CPPUNIT_ASSERT(list.size() == 2 && index_in_sync(list, index));
+
+  CPPUNIT_ASSERT(list_erase_ptr(&list, &index, &*itr_a));
+  CPPUNIT_ASSERT(list.size() == 1 && index_in_sync(list, index));
+  CPPUNIT_ASSERT(index.find(make_hash('a'), list.end()) == list.end());
+
+  CPPUNIT_ASSERT(list_erase_ptr(&list, &index, &*itr_b));
+  CPPUNIT_ASSERT(list.empty() && index.empty());
+
+  // Reinserting a hash after it was erased indexes the new element.
+  auto itr_new = list_insert(&list, &index, make_hash('a'));
+
+  CPPUNIT_ASSERT(index.find(make_hash('a'), list.end()) == itr_new);
+  CPPUNIT_ASSERT(index_in_sync(list, index));
+}
+
+// As DownloadList::clear(), removing from the back.
+void
+TestHashIndex::test_clear() {
+  hash_list  list;
+  hash_index index;
+
+  for (char c = 'a'; c != 'k'; c++)
+    list_insert(&list, &index, make_hash(c));
+
+  CPPUNIT_ASSERT(index.size() == 10 && index_in_sync(list, index));
+
+  while (!list.empty()) {
+    list_erase(&list, &index, std::prev(list.end()));
+    CPPUNIT_ASSERT(index_in_sync(list, index));
+  }
+
+  CPPUNIT_ASSERT(index.empty());
+
+  list_insert(&list, &index, make_hash('a'));
+  list_insert(&list, &index, make_hash('b'));
+
+  index.clear();
+
+  CPPUNIT_ASSERT(index.empty());
+  CPPUNIT_ASSERT(index.find(make_hash('a'), list.end()) == list.end());
+}
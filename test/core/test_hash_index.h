@@ -0,0 +1,18 @@
+#include "test/helpers/test_fixture.h"
+
+class TestHashIndex : public test_fixture {
+  CPPUNIT_TEST_SUITE(TestHashIndex);
+
+  CPPUNIT_TEST(test_basic);
+  CPPUNIT_TEST(test_prefix);
+  CPPUNIT_TEST(test_erase_ptr);
+  CPPUNIT_TEST(test_clear);
+
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  void test_basic();
+  void test_prefix();
+  void test_erase_ptr();
+  void test_clear();
+};
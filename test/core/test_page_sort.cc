@@ -0,0 +1,98 @@
+#include "config.h"
+
+#include "test/core/test_page_sort.h"
+
+#include "core/page_sort.h"
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TestPageSort);
+
+typedef std::vector<uint32_t> index_list;
+
+static std::vector<torrent::Object>
+make_value_keys(const std::vector<int64_t>& values) {
+  return std::vector<torrent::Object>(values.begin(), values.end());
+}
+
+void
+TestPageSort::test_window() {
+  auto keys = make_value_keys({4, 2, 3, 0, 1});
+  std::vector<bool> ascending{false};
+
+  CPPUNIT_ASSERT(core::page_sort(keys, ascending, 5, 0, 5) == index_list({3, 4, 1, 2, 0}));
+  CPPUNIT_ASSERT(core::page_sort(keys, ascending, 5, 0, 2) == index_list({3, 4}));
+  CPPUNIT_ASSERT(core::page_sort(keys, ascending, 5, 2, 2) == index_list({1, 2}));
+  CPPUNIT_ASSERT(core::page_sort(keys, ascending, 5, 4, 2) == index_list({0}));
+  CPPUNIT_ASSERT(core::page_sort(keys, ascending, 5, 3, 100) == index_list({2, 0}));
+
+  CPPUNIT_ASSERT(core::page_sort(keys, ascending, 5, 5, 2).empty());
+  CPPUNIT_ASSERT(core::page_sort(keys, ascending, 5, 2, 0).empty());
+  CPPUNIT_ASSERT(core::page_sort(keys, ascending, 5, UINT64_MAX, UINT64_MAX).empty());
+  CPPUNIT_ASSERT(core::page_sort(keys, ascending, 5, 1, UINT64_MAX) == index_list({4, 1, 2, 0}));
+
+  CPPUNIT_ASSERT(core::page_sort({}, ascending, 0, 0, 10).empty());
+
+  // Without sort keys the view order is kept.
+  CPPUNIT_ASSERT(core::page_sort({}, {}, 4, 1, 2) == index_list({1, 2}));
+}
+
+void
+TestPageSort::test_order() {
+  std::vector<torrent::Object> keys = {
+    int64_t(1), std::string("b"),
+    int64_t(2), std::string("a"),
+    int64_t(1), std::string("a"),
+    int64_t(2), std::string("c"),
+  };
+
+  CPPUNIT_ASSERT(core::page_sort(keys, {false, false}, 4, 0, 4) == index_list({2, 0, 1, 3}));
+  CPPUNIT_ASSERT(core::page_sort(keys, {true, false}, 4, 0, 4) == index_list({1, 3, 2, 0}));
+  CPPUNIT_ASSERT(core::page_sort(keys, {false, true}, 4, 0, 4) == index_list({0, 2, 3, 1}));
+  CPPUNIT_ASSERT(core::page_sort(keys, {true, true}, 4, 1, 2) == index_list({1, 0}));
+}
+
+// Downloads with equal keys are in view order, also when descending.
+void
+TestPageSort::test_ties() {
+  auto keys = make_value_keys({1, 0, 1, 0, 1, 0});
+
+  CPPUNIT_ASSERT(core::page_sort(keys, {false}, 6, 0, 6) == index_list({1, 3, 5, 0, 2, 4}));
+  CPPUNIT_ASSERT(core::page_sort(keys, {true}, 6, 0, 6) == index_list({0, 2, 4, 1, 3, 5}));
+  CPPUNIT_ASSERT(core::page_sort(keys, {false}, 6, 2, 2) == index_list({5, 0}));
+  CPPUNIT_ASSERT(core::page_sort(keys, {true}, 6, 4, 2) == index_list({3, 5}));
+}
+
+// Pages taken with separate calls join up to the full sort, without
+// repeating or skipping downloads with equal keys.
+void
+TestPageSort::test_pages() {
+  std::vector<int64_t> values;
+
+  for (int64_t i = 0; i != 50; i++)
+    values.push_back((i * 7) % 5);
+
+  auto keys = make_value_keys(values);
+
+  for (bool descending : {false, true}) {
+    index_list full = core::page_sort(keys, {descending}, values.size(), 0, values.size());
+
+    CPPUNIT_ASSERT(full.size() == values.size());
+
+    for (size_t i = 1; i != full.size(); i++) {
+      int64_t lhs = values[full[i - 1]];
+      int64_t rhs = values[full[i]];
+
+      CPPUNIT_ASSERT(lhs == rhs ? full[i - 1] < full[i] : (descending ? lhs > rhs : lhs < rhs));
+    }
+
+    for (size_t page_size : {1, 3, 7, 50}) {
+      index_list joined;
+
+      for (size_t offset = 0; offset < values.size(); offset += page_size) {
+        index_list page = core::page_sort(keys, {descending}, values.size(), offset, page_size);
+        joined.insert(joined.end(), page.begin(), page.end());
+      }
+
+      CPPUNIT_ASSERT(joined == full);
+    }
+  }
+}
@@ -0,0 +1,18 @@
+#include "test/helpers/test_fixture.h"
+
+class TestPageSort : public test_fixture {
+  CPPUNIT_TEST_SUITE(TestPageSort);
+
+  CPPUNIT_TEST(test_window);
+  CPPUNIT_TEST(test_order);
+  CPPUNIT_TEST(test_ties);
+  CPPUNIT_TEST(test_pages);
+
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  void test_window();
+  void test_order();
+  void test_ties();
+  void test_pages();
+};
@@ -0,0 +1,274 @@
+#include "config.h"
+
+#include "test/core/test_view_expression.h"
+
+#include <cstring>
+#include <vector>
+
+#include "control.h"
+#include "globals.h"
+#include "command_helpers.h"
+#include "core/view_expression.h"
+#include "rpc/parse.h"
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TestViewExpression);
+
+void initialize_command_dynamic();
+void initialize_command_ui();
+
+typedef core::ViewExpression ViewExpression;
+
+// The test commands only use the downloads to index these tables, so
+// they are never dereferenced. The first and last downloads have the
+// same keys.
+static char view_test_downloads[3];
+
+static const int64_t     view_test_values[] = { 2, 1, 2 };
+static const char* const view_test_names[]  = { "b", "a", "b" };
+
+static core::Download*
+test_download(int i) {
+  return reinterpret_cast<core::Download*>(&view_test_downloads[i]);
+}
+
+static int
+view_test_index(core::Download* download) {
+  return reinterpret_cast<char*>(download) - view_test_downloads;
+}
+
+static torrent::Object
+view_test_value(core::Download* download) {
+  return view_test_values[view_test_index(download)];
+}
+
+static torrent::Object
+view_test_name(core::Download* download) {
+  return std::string(view_test_names[view_test_index(download)]);
+}
+
+static torrent::Object
+view_test_fail(core::Download* download) {
+  if (view_test_index(download) == 1)
+    throw torrent::input_error("view_test_fail");
+
+  return view_test_values[view_test_index(download)];
+}
+
+static torrent::Object
+make_expression(const char* str) {
+  if (*str != '(')
+    return std::string(str);
+
+  torrent::Object obj = torrent::Object::create_list();
+  rpc::parse_whole_list(str, str + std::strlen(str), &obj, &rpc::parse_is_delim_command);
+
+  if (obj.is_list() && obj.as_list().size() == 1) {
+    torrent::Object tmp = obj.as_list().front();
+    obj = tmp;
+  }
+
+  return obj;
+}
+
+void
+TestViewExpression::setUp() {
+  m_test_main_thread = TestMainThread::create();
+  m_test_main_thread->init_thread();
+
+  if (rpc::commands.find("method.insert") == rpc::commands.end()) {
+    setlocale(LC_ALL, "");
+    control = new Control;
+
+    initialize_command_dynamic();
+    initialize_command_ui();
+  }
+
+  if (rpc::commands.find("test_view_expression.value") != rpc::commands.end())
+    return;
+
+  // Only used to classify expressions, the compiled fields read the
+  // downloads directly.
+  if (rpc::commands.find("d.name") == rpc::commands.end())
+    CMD2_DL_PURE("d.name", std::bind(&view_test_name, std::placeholders::_1));
+
+  if (rpc::commands.find("d.bytes_done") == rpc::commands.end())
+    CMD2_DL_PURE("d.bytes_done", std::bind(&view_test_value, std::placeholders::_1));
+
+  CMD2_DL_PURE("test_view_expression.value",  std::bind(&view_test_value, std::placeholders::_1));
+  CMD2_DL_PURE("test_view_expression.name",   std::bind(&view_test_name, std::placeholders::_1));
+  CMD2_DL_PURE("test_view_expression.fail",   std::bind(&view_test_fail, std::placeholders::_1));
+  CMD2_DL     ("test_view_expression.impure", std::bind(&view_test_value, std::placeholders::_1));
+}
+
+void
+TestViewExpression::tearDown() {
+  m_test_main_thread.reset();
+}
+
+void
+TestViewExpression::test_classify() {
+  struct classify_test {
+    const char* expression;
+    bool        is_tracked;
+    bool        is_pure;
+  };
+
+  std::vector<classify_test> tests = {
+    {"d.name=", true, true},
+    {"((d.name))", true, true},
+    {"((not,((d.name))))", true, true},
+    {"((less,((d.name))))", true, true},
+    {"((compare,+,d.name=))", true, true},
+
+    // The bytes done change without the download being marked as
+    // changed.
+    {"d.bytes_done=", false, true},
+    {"((and,((d.name)),((d.bytes_done))))", false, true},
+
+    // Other commands aren't tracked, and only pure if flagged so.
+    {"test_view_expression.value=", false, true},
+    {"((or,((d.name)),((test_view_expression.value))))", false, true},
+    {"test_view_expression.impure=", false, false},
+    {"((and,((d.name)),((test_view_expression.impure))))", false, false},
+    {"((compare,+,d.name=,test_view_expression.impure=))", false, false},
+  };
+
+  for (auto& test : tests) {
+    ViewExpression expression(make_expression(test.expression));
+
+    CPPUNIT_ASSERT_MESSAGE(test.expression, expression.is_tracked() == test.is_tracked);
+    CPPUNIT_ASSERT_MESSAGE(test.expression, expression.is_pure() == test.is_pure);
+  }
+
+  ViewExpression empty;
+  CPPUNIT_ASSERT(empty.is_empty() && empty.is_tracked() && empty.is_pure());
+}
+
+void
+TestViewExpression::test_call() {
+  ViewExpression less(make_expression("((less,((test_view_expression.value))))"));
+  ViewExpression both(make_expression("((and,((test_view_expression.value)),((test_view_expression.name))))"));
+  ViewExpression equal(make_expression("((equal,((test_view_expression.name)),((cat,a))))"));
+  ViewExpression value(make_expression("test_view_expression.value="));
+
+  CPPUNIT_ASSERT(less.call(rpc::make_target_pair(test_download(1), test_download(0))).as_value() == 1);
+  CPPUNIT_ASSERT(less.call(rpc::make_target_pair(test_download(0), test_download(1))).as_value() == 0);
+  CPPUNIT_ASSERT(less.call(rpc::make_target_pair(test_download(0), test_download(2))).as_value() == 0);
+
+  CPPUNIT_ASSERT(both.call(rpc::make_target(test_download(0))).as_value() == 1);
+  CPPUNIT_ASSERT(equal.call(rpc::make_target(test_download(1))).as_value() == 1);
+  CPPUNIT_ASSERT(equal.call(rpc::make_target(test_download(2))).as_value() == 0);
+  CPPUNIT_ASSERT(value.call(rpc::make_target(test_download(2))).as_value() == 2);
+}
+
+void
+TestViewExpression::test_sort_key_size() {
+  struct key_size_test {
+    const char* expression;
+    size_t      size;
+  };
+
+  std::vector<key_size_test> tests = {
+    {"((less,((test_view_expression.value))))", 1},
+    {"((greater,((test_view_expression.name))))", 1},
+    {"((compare,+,test_view_expression.value=))", 1},
+    {"((compare,+-,test_view_expression.value=,test_view_expression.name=))", 2},
+
+    // Each side calls a different command, or isn't a comparison.
+    {"((less,((test_view_expression.value)),((test_view_expression.name))))", 0},
+    {"((and,((test_view_expression.value))))", 0},
+    {"test_view_expression.value=", 0},
+  };
+
+  for (auto& test : tests)
+    CPPUNIT_ASSERT_MESSAGE(test.expression, ViewExpression(make_expression(test.expression)).sort_key_size() == test.size);
+
+  CPPUNIT_ASSERT(ViewExpression().sort_key_size() == 0);
+}
+
+// Comparing the keys gives the same result as calling the expression
+// on the target pair, including the tie-break on the downloads' order
+// in 'compare'.
+void
+TestViewExpression::test_sort_keys() {
+  const char* expressions[] = {
+    "((less,((test_view_expression.value))))",
+    "((greater,((test_view_expression.name))))",
+    "((compare,+,test_view_expression.value=))",
+    "((compare,-+,test_view_expression.value=,test_view_expression.name=))",
+    "((compare,ad,test_view_expression.name=,test_view_expression.value=))",
+  };
+
+  for (auto str : expressions) {
+    ViewExpression expression(make_expression(str));
+    size_t         stride = expression.sort_key_size();
+
+    std::vector<ViewExpression::sort_key> keys(3 * stride);
+
+    for (int i = 0; i != 3; i++)
+      expression.sort_keys(rpc::make_target(test_download(i)), &keys[i * stride]);
+
+    for (int i = 0; i != 3; i++) {
+      for (int j = 0; j != 3; j++) {
+        auto target = rpc::make_target_pair(test_download(i), test_download(j));
+
+        CPPUNIT_ASSERT_MESSAGE(str, expression.sort_keys_less(&keys[i * stride], &keys[j * stride], target) ==
+                                    (bool)expression.call(target).as_value());
+      }
+    }
+  }
+
+  ViewExpression expression(make_expression("((compare,+,test_view_expression.value=,test_view_expression.name=))"));
+  ViewExpression::sort_key keys[2][2];
+
+  expression.sort_keys(rpc::make_target(test_download(0)), keys[0]);
+  expression.sort_keys(rpc::make_target(test_download(2)), keys[1]);
+
+  CPPUNIT_ASSERT(expression.sort_keys_less(keys[0], keys[1], rpc::make_target_pair(test_download(0), test_download(2))));
+  CPPUNIT_ASSERT(!expression.sort_keys_less(keys[1], keys[0], rpc::make_target_pair(test_download(2), test_download(0))));
+  CPPUNIT_ASSERT(expression.call(rpc::make_target_pair(test_download(0), test_download(2))).as_value() == 1);
+  CPPUNIT_ASSERT(expression.call(rpc::make_target_pair(test_download(2), test_download(0))).as_value() == 0);
+}
+
+// Errors are kept in the keys and thrown when compared.
+void
+TestViewExpression::test_sort_keys_error() {
+  ViewExpression           expression(make_expression("((compare,+,test_view_expression.fail=))"));
+  ViewExpression::sort_key keys[3];
+
+  for (int i = 0; i != 3; i++)
+    expression.sort_keys(rpc::make_target(test_download(i)), &keys[i]);
+
+  CPPUNIT_ASSERT(keys[1].failed && !keys[0].failed);
+
+  auto target = rpc::make_target_pair(test_download(0), test_download(1));
+
+  CPPUNIT_ASSERT_THROW(expression.sort_keys_less(&keys[0], &keys[1], target), torrent::input_error);
+  CPPUNIT_ASSERT_THROW(expression.call(target), torrent::input_error);
+  CPPUNIT_ASSERT(expression.sort_keys_less(&keys[0], &keys[2], rpc::make_target_pair(test_download(0), test_download(2))));
+}
+
+// Commands the user may modify are looked up on each call.
+void
+TestViewExpression::test_modifiable() {
+  rpc::commands.call_command("method.insert.simple", rpc::create_object_list("test_view_expression.method", "cat=foo"));
+
+  ViewExpression equal(make_expression("((equal,((test_view_expression.method)),((cat,foo))))"));
+  ViewExpression command(make_expression("test_view_expression.method="));
+
+  auto target = rpc::make_target(test_download(0));
+
+  CPPUNIT_ASSERT(!equal.is_pure() && !equal.is_tracked());
+  CPPUNIT_ASSERT(!command.is_pure() && !command.is_tracked());
+
+  CPPUNIT_ASSERT(equal.call(target).as_value() == 1);
+  CPPUNIT_ASSERT(command.call(target).as_string() == "foo");
+
+  rpc::commands.call_command("method.erase", std::string("test_view_expression.method"));
+  rpc::commands.call_command("method.insert.simple", rpc::create_object_list("test_view_expression.method", "cat=bar"));
+
+  CPPUNIT_ASSERT(equal.call(target).as_value() == 0);
+  CPPUNIT_ASSERT(command.call(target).as_string() == "bar");
+
+  rpc::commands.call_command("method.erase", std::string("test_view_expression.method"));
+}
@@ -0,0 +1,29 @@
+#include "test/helpers/test_fixture.h"
+#include "test/helpers/test_main_thread.h"
+
+class TestViewExpression : public test_fixture {
+  CPPUNIT_TEST_SUITE(TestViewExpression);
+
+  CPPUNIT_TEST(test_classify);
+  CPPUNIT_TEST(test_call);
+  CPPUNIT_TEST(test_sort_key_size);
+  CPPUNIT_TEST(test_sort_keys);
+  CPPUNIT_TEST(test_sort_keys_error);
+  CPPUNIT_TEST(test_modifiable);
+
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  void setUp();
+  void tearDown();
+
+  void test_classify();
+  void test_call();
+  void test_sort_key_size();
+  void test_sort_keys();
+  void test_sort_keys_error();
+  void test_modifiable();
+
+private:
+  std::unique_ptr<TestMainThread> m_test_main_thread;
+};
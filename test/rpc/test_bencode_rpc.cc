@@ -0,0 +1,112 @@
+#include "config.h"
+
+#include "test/rpc/test_bencode_rpc.h"
+
+#include <string>
+
+#include "control.h"
+#include "globals.h"
+#include "command_helpers.h"
+#include "rpc/command_map.h"
+#include "rpc/rpc_batch.h"
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TestBencodeRpc);
+
+torrent::Object
+bencode_rpc_cmd_test_reflect([[maybe_unused]] rpc::target_type t, const torrent::Object& obj) { return obj; }
+
+// Name, Request, Expected response
+std::vector<std::tuple<std::string, std::string, std::string>> basic_bencode_rpc_requests = {
+  std::make_tuple("Basic call",
+                  "d2:idi1e6:method15:bencode_reflect6:paramsl0:ee",
+                  "d2:idi1e6:resultlee"),
+
+  std::make_tuple("Basic call without params",
+                  "d2:idi1e6:method15:bencode_reflecte",
+                  "d2:idi1e6:resultlee"),
+
+  std::make_tuple("Basic call with string id",
+                  "d2:id1:x6:method15:bencode_reflect6:paramsl0:i5e3:abcee",
+                  "d2:id1:x6:resultli5e3:abcee"),
+
+  std::make_tuple("Dictionary",
+                  "d2:idi1e6:method15:bencode_reflect6:paramsl0:d1:bi1e1:ai2eeee",
+                  "d2:idi1e6:resultld1:ai2e1:bi1eeee"),
+
+  std::make_tuple("Notification",
+                  "d6:method15:bencode_reflect6:paramsl0:i5eee",
+                  ""),
+
+  std::make_tuple("Batch",
+                  "ld2:idi1e6:method15:bencode_reflect6:paramsl0:i5eeed6:method15:bencode_reflectei5ed2:idi2e6:method9:no_such_mee",
+                  "ld2:idi1e6:resultli5eeed5:errord4:codei-32600e7:message33:invalid request: not a dictionaryee"
+                  "d5:errord4:codei-32601e7:message27:method not found: no_such_me2:idi2eee"),
+
+  std::make_tuple("Invalid - empty batch",
+                  "le",
+                  "d5:errord4:codei-32600e7:message28:invalid request: empty batchee"),
+
+  std::make_tuple("Invalid - missing method",
+                  "d2:idi1e6:method14:no_such_methode",
+                  "d5:errord4:codei-32601e7:message32:method not found: no_such_methode2:idi1ee"),
+
+  std::make_tuple("Invalid - i8 target",
+                  "d2:idi1e6:method15:bencode_reflect6:paramsli41eee",
+                  "d5:errord4:codei-32602e7:message43:invalid parameters: target must be a stringe2:idi1ee"),
+
+  std::make_tuple("Invalid - params not a list",
+                  "d2:idi1e6:method15:bencode_reflect6:paramsi1ee",
+                  "d5:errord4:codei-32600e7:message44:invalid request: params field must be a liste2:idi1ee"),
+
+  std::make_tuple("Invalid - list id",
+                  "d2:idle6:method15:bencode_reflecte",
+                  "d5:errord4:codei-32600e7:message26:request id is invalid typeee"),
+
+  std::make_tuple("Invalid - trailing data",
+                  "d2:idi1e6:method15:bencode_reflectexx",
+                  "d5:errord4:codei-32700e7:message40:parse error: trailing data after requestee"),
+};
+
+void
+TestBencodeRpc::setUp() {
+  m_test_main_thread = TestMainThread::create();
+  m_test_main_thread->init_thread();
+
+  m_bencode_rpc = rpc::BencodeRpc();
+  m_bencode_rpc.initialize();
+  control = new Control;
+
+  if (rpc::commands.find("bencode_reflect") == rpc::commands.end()) {
+    CMD2_ANY("bencode_reflect", &bencode_rpc_cmd_test_reflect);
+  }
+}
+
+void
+TestBencodeRpc::tearDown() {
+  m_test_main_thread.reset();
+}
+
+void
+TestBencodeRpc::test_basics() {
+  for (auto& test : basic_bencode_rpc_requests) {
+    std::string output;
+    m_bencode_rpc.process(std::get<1>(test).c_str(), std::get<1>(test).size(), [&output](std::string&& response) { output = std::move(response); return true; });
+    CPPUNIT_ASSERT_EQUAL_MESSAGE(std::get<0>(test), std::get<2>(test), output);
+  }
+}
+
+void
+TestBencodeRpc::test_encode_partial() {
+  for (auto& test : basic_bencode_rpc_requests) {
+    rpc::RpcBatch batch;
+    std::string   output;
+
+    m_bencode_rpc.decode(std::get<1>(test).c_str(), std::get<1>(test).size(), &batch);
+    m_bencode_rpc.execute(&batch);
+
+    while (!m_bencode_rpc.encode_partial(&batch, &output, 1))
+      ;
+
+    CPPUNIT_ASSERT_EQUAL_MESSAGE(std::get<0>(test), std::get<2>(test), output);
+  }
+}
@@ -0,0 +1,26 @@
+#include "test/helpers/test_fixture.h"
+#include "test/helpers/test_main_thread.h"
+
+#include "rpc/bencode_rpc.h"
+#include "rpc/command_map.h"
+
+class TestBencodeRpc : public test_fixture {
+  CPPUNIT_TEST_SUITE(TestBencodeRpc);
+
+  CPPUNIT_TEST(test_basics);
+  CPPUNIT_TEST(test_encode_partial);
+
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  void setUp();
+  void tearDown();
+
+  void test_basics();
+  void test_encode_partial();
+
+private:
+  std::unique_ptr<TestMainThread> m_test_main_thread;
+
+  rpc::BencodeRpc m_bencode_rpc;
+};
@@ -28,3 +28,69 @@ TestCommandMap::test_basics() {
   CPPUNIT_ASSERT(m_map.call_command("test_b", (int64_t)1).as_value() == 2);
   CPPUNIT_ASSERT(m_map.call_command("any_string", "").as_value() == 3);
 }
+
+void
+TestCommandMap::test_ids() {
+  CMD2_ANY("test_a", &cmd_test_map_a);
+  CMD2_ANY("test_b", std::bind(&cmd_test_map_b, std::placeholders::_1, std::placeholders::_2, (uint64_t)2));
+
+  auto itr_a = m_map.find("test_a");
+  auto itr_b = m_map.find("test_b");
+
+  CPPUNIT_ASSERT(itr_a != m_map.end() && itr_b != m_map.end());
+  CPPUNIT_ASSERT(itr_a->second.m_id != itr_b->second.m_id);
+  CPPUNIT_ASSERT(m_map.find_id(itr_a->second.m_id) == itr_a);
+  CPPUNIT_ASSERT(m_map.find_id(rpc::CommandMap::invalid_id) == m_map.end());
+
+  auto id_a = itr_a->second.m_id;
+  m_map.erase(itr_a);
+
+  CPPUNIT_ASSERT(m_map.find("test_a") == m_map.end());
+  CPPUNIT_ASSERT(m_map.find_id(id_a) == m_map.end());
+
+  // Ids are not reused.
+  CMD2_ANY("test_a", &cmd_test_map_a);
+
+  CPPUNIT_ASSERT(m_map.find("test_a")->second.m_id != id_a);
+  CPPUNIT_ASSERT(m_map.find_id(id_a) == m_map.end());
+
+  m_map.create_redirect("test_c", "test_b", 0);
+
+  CPPUNIT_ASSERT(m_map.find("test_c") != m_map.end());
+  CPPUNIT_ASSERT(m_map.find_id(m_map.find("test_c")->second.m_id) == m_map.find("test_c"));
+  CPPUNIT_ASSERT(m_map.call_command("test_c", (int64_t)1).as_value() == 2);
+}
+
+void
+TestCommandMap::test_handle() {
+  rpc::CommandHandle handle(&m_map, "test_a");
+
+  CPPUNIT_ASSERT_THROW(handle.call((int64_t)1, rpc::make_target()), torrent::input_error);
+
+  CMD2_ANY("test_a", &cmd_test_map_a);
+
+  CPPUNIT_ASSERT(handle.call((int64_t)1, rpc::make_target()).as_value() == 1);
+  CPPUNIT_ASSERT(handle.call((int64_t)2, rpc::make_target()).as_value() == 2);
+
+  // Rebinds after the command is erased and inserted again.
+  m_map.erase(m_map.find("test_a"));
+  CMD2_ANY("test_a", std::bind(&cmd_test_map_b, std::placeholders::_1, std::placeholders::_2, (uint64_t)3));
+
+  CPPUNIT_ASSERT(handle.call((int64_t)1, rpc::make_target()).as_value() == 3);
+}
+
+void
+TestCommandMap::test_pure() {
+  CMD2_ANY("test_a", &cmd_test_map_a);
+  m_map.insert_slot<rpc::command_base_is_type<rpc::command_base_call<rpc::target_type>>::type>("test_pure", &cmd_test_map_a, &rpc::command_base_call<rpc::target_type>,
+                                                                                               rpc::CommandMap::flag_dont_delete | rpc::CommandMap::flag_pure, NULL, NULL);
+
+  CPPUNIT_ASSERT(!m_map.is_pure(m_map.find("test_a")));
+  CPPUNIT_ASSERT(m_map.is_pure(m_map.find("test_pure")));
+  CPPUNIT_ASSERT(!m_map.is_pure(m_map.find("no_such_command")));
+
+  // Redirects call the same slot.
+  m_map.create_redirect("test_pure_redirect", "test_pure", 0);
+
+  CPPUNIT_ASSERT(m_map.is_pure(m_map.find("test_pure_redirect")));
+}
@@ -6,6 +6,9 @@ class TestCommandMap : public test_fixture {
   CPPUNIT_TEST_SUITE(TestCommandMap);
 
   CPPUNIT_TEST(test_basics);
+  CPPUNIT_TEST(test_ids);
+  CPPUNIT_TEST(test_handle);
+  CPPUNIT_TEST(test_pure);
 
   CPPUNIT_TEST_SUITE_END();
 
@@ -15,6 +18,9 @@ public:
   void setUp() { m_commandItr = m_commands; }
 
   void test_basics();
+  void test_ids();
+  void test_handle();
+  void test_pure();
 
 private:
   rpc::CommandMap m_map;
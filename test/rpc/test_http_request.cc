@@ -0,0 +1,154 @@
+#include "config.h"
+
+#include "test/rpc/test_http_request.h"
+
+#include <cstring>
+#include <string>
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TestHttpRequest);
+
+static const size_t http_test_max_size = 1 << 20;
+
+// Returns the error status, or an empty string if the header was
+// accepted.
+static std::string
+parse_header(rpc::HttpRequest* request, const std::string& header) {
+  std::string buffer      = header + "\r\n\r\n";
+  const char* header_end  = buffer.c_str() + header.size();
+  const char* status      = request->parse_header(buffer.c_str(), header_end, http_test_max_size);
+
+  return status != NULL ? status : "";
+}
+
+static std::string
+parse_header(const std::string& header) {
+  rpc::HttpRequest request;
+  return parse_header(&request, header);
+}
+
+// Parses the whole body at once, decoding it if complete.
+static rpc::HttpChunkedBody::Status
+parse_chunked(const std::string& input, std::string* output = NULL, std::string* rest = NULL, size_t max_size = http_test_max_size) {
+  std::string          buffer = input;
+  rpc::HttpChunkedBody body;
+
+  auto status = body.parse(&buffer[0], buffer.c_str() + buffer.size(), max_size);
+
+  if (status == rpc::HttpChunkedBody::COMPLETE) {
+    if (output != NULL)
+      output->assign(buffer.c_str(), body.decode(&buffer[0]));
+
+    if (rest != NULL)
+      rest->assign(buffer.c_str() + body.end());
+  }
+
+  return status;
+}
+
+void
+TestHttpRequest::test_header() {
+  rpc::HttpRequest request;
+
+  CPPUNIT_ASSERT(parse_header(&request, "POST /RPC2 HTTP/1.1\r\nContent-Length: 10\r\nContent-Type: text/xml") == "");
+  CPPUNIT_ASSERT(request.keep_alive && !request.chunked && !request.expect_continue);
+  CPPUNIT_ASSERT(request.content_length == 10);
+  CPPUNIT_ASSERT(request.content_type == "text/xml");
+
+  CPPUNIT_ASSERT(parse_header(&request, "POST /RPC2 HTTP/1.0\r\ncontent-length:  5 ") == "");
+  CPPUNIT_ASSERT(!request.keep_alive && request.content_length == 5 && request.content_type.empty());
+
+  CPPUNIT_ASSERT(parse_header(&request, "POST /RPC2 HTTP/1.1\r\nConnection: close\r\nContent-Length: 5") == "");
+  CPPUNIT_ASSERT(!request.keep_alive);
+
+  CPPUNIT_ASSERT(parse_header(&request, "POST /RPC2 HTTP/1.0\r\nConnection: Keep-Alive\r\nContent-Length: 5") == "");
+  CPPUNIT_ASSERT(request.keep_alive);
+
+  CPPUNIT_ASSERT(parse_header(&request, "POST /RPC2 HTTP/1.1\r\nTransfer-Encoding: chunked\r\nExpect: 100-continue") == "");
+  CPPUNIT_ASSERT(request.chunked && request.expect_continue);
+
+  // Previous values are not kept.
+  CPPUNIT_ASSERT(parse_header(&request, "POST /RPC2 HTTP/1.1\r\nContent-Length: 5") == "");
+  CPPUNIT_ASSERT(!request.chunked && !request.expect_continue);
+}
+
+void
+TestHttpRequest::test_header_errors() {
+  CPPUNIT_ASSERT(parse_header("GET /RPC2 HTTP/1.1\r\nContent-Length: 5") == "405 Method Not Allowed");
+  CPPUNIT_ASSERT(parse_header("POST /RPC2\r\nContent-Length: 5") == "400 Bad Request");
+  CPPUNIT_ASSERT(parse_header("POST /RPC2 HTTP/1.1") == "411 Length Required");
+  CPPUNIT_ASSERT(parse_header("POST /RPC2 HTTP/1.1\r\nContent-Length: 0") == "400 Bad Request");
+  CPPUNIT_ASSERT(parse_header("POST /RPC2 HTTP/1.1\r\nContent-Length: 5x") == "400 Bad Request");
+  CPPUNIT_ASSERT(parse_header("POST /RPC2 HTTP/1.1\r\nContent-Length: -5") == "400 Bad Request");
+  CPPUNIT_ASSERT(parse_header("POST /RPC2 HTTP/1.1\r\nContent-Length: 1048577") == "413 Payload Too Large");
+  CPPUNIT_ASSERT(parse_header("POST /RPC2 HTTP/1.1\r\nContent-Length: 99999999999999999999999") == "413 Payload Too Large");
+  CPPUNIT_ASSERT(parse_header("POST /RPC2 HTTP/1.1\r\nTransfer-Encoding: gzip") == "501 Not Implemented");
+  CPPUNIT_ASSERT(parse_header("POST /RPC2 HTTP/1.1\r\nContent-Length: 5\r\nExpect: 200-ok") == "417 Expectation Failed");
+}
+
+void
+TestHttpRequest::test_chunked() {
+  std::string output;
+  std::string rest;
+
+  CPPUNIT_ASSERT(parse_chunked("5\r\nhello\r\n6;name=value\r\n world\r\n0\r\n\r\n", &output, &rest) == rpc::HttpChunkedBody::COMPLETE);
+  CPPUNIT_ASSERT(output == "hello world");
+  CPPUNIT_ASSERT(rest.empty());
+
+  // Pipelined requests follow the body.
+  CPPUNIT_ASSERT(parse_chunked("A\r\n0123456789\r\n0\r\n\r\nPOST", &output, &rest) == rpc::HttpChunkedBody::COMPLETE);
+  CPPUNIT_ASSERT(output == "0123456789");
+  CPPUNIT_ASSERT(rest == "POST");
+
+  CPPUNIT_ASSERT(parse_chunked("5\r\nhello\r\n") == rpc::HttpChunkedBody::INCOMPLETE);
+  CPPUNIT_ASSERT(parse_chunked("5\r\nhello\r\n0\r\n") == rpc::HttpChunkedBody::INCOMPLETE);
+}
+
+// Each read adds one byte, resuming after the chunks already checked.
+void
+TestHttpRequest::test_chunked_split() {
+  std::string          input = "3\r\nabc\r\n10\r\n0123456789abcdef\r\n1\r\nx\r\n0\r\nTrailer: 1\r\n\r\nnext";
+  std::string          buffer;
+  rpc::HttpChunkedBody body;
+
+  auto status = rpc::HttpChunkedBody::INCOMPLETE;
+
+  for (size_t i = 0; i != input.size() && status == rpc::HttpChunkedBody::INCOMPLETE; i++) {
+    buffer.push_back(input[i]);
+    status = body.parse(&buffer[0], buffer.c_str() + buffer.size(), http_test_max_size);
+  }
+
+  CPPUNIT_ASSERT(status == rpc::HttpChunkedBody::COMPLETE);
+  CPPUNIT_ASSERT(body.length() == 20);
+  CPPUNIT_ASSERT(buffer.size() == input.size() - 4);
+  CPPUNIT_ASSERT(std::string(buffer.c_str(), body.decode(&buffer[0])) == "abc0123456789abcdefx");
+}
+
+void
+TestHttpRequest::test_chunked_trailer() {
+  std::string output;
+  std::string rest;
+
+  CPPUNIT_ASSERT(parse_chunked("2\r\nab\r\n0\r\nX-One: 1\r\nX-Two: 2\r\n\r\nrest", &output, &rest) == rpc::HttpChunkedBody::COMPLETE);
+  CPPUNIT_ASSERT(output == "ab");
+  CPPUNIT_ASSERT(rest == "rest");
+
+  CPPUNIT_ASSERT(parse_chunked("2\r\nab\r\n0\r\nX-One: 1\r\n") == rpc::HttpChunkedBody::INCOMPLETE);
+}
+
+void
+TestHttpRequest::test_chunked_errors() {
+  // The sizes would wrap around if added before being checked.
+  CPPUNIT_ASSERT(parse_chunked("2\r\nab\r\nfffffffffffffffe\r\n\r\n0\r\n\r\n") == rpc::HttpChunkedBody::TOO_LARGE);
+  CPPUNIT_ASSERT(parse_chunked("ffffffffffffffffffff\r\n") == rpc::HttpChunkedBody::TOO_LARGE);
+
+  CPPUNIT_ASSERT(parse_chunked("100001\r\n") == rpc::HttpChunkedBody::TOO_LARGE);
+  CPPUNIT_ASSERT(parse_chunked("8\r\n01234567\r\n1\r\n8\r\n0\r\n\r\n", NULL, NULL, 8) == rpc::HttpChunkedBody::TOO_LARGE);
+  CPPUNIT_ASSERT(parse_chunked("8\r\n01234567\r\n0\r\n\r\n", NULL, NULL, 8) == rpc::HttpChunkedBody::COMPLETE);
+
+  CPPUNIT_ASSERT(parse_chunked("0\r\n\r\n") == rpc::HttpChunkedBody::BAD_REQUEST);
+  CPPUNIT_ASSERT(parse_chunked("x\r\n") == rpc::HttpChunkedBody::BAD_REQUEST);
+  CPPUNIT_ASSERT(parse_chunked("-1\r\n") == rpc::HttpChunkedBody::BAD_REQUEST);
+  CPPUNIT_ASSERT(parse_chunked(" 1\r\n") == rpc::HttpChunkedBody::BAD_REQUEST);
+  CPPUNIT_ASSERT(parse_chunked("1 x\r\n") == rpc::HttpChunkedBody::BAD_REQUEST);
+  CPPUNIT_ASSERT(parse_chunked("2\r\nabc\r\n0\r\n\r\n") == rpc::HttpChunkedBody::BAD_REQUEST);
+}
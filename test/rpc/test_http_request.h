@@ -0,0 +1,24 @@
+#include "test/helpers/test_fixture.h"
+
+#include "rpc/http_request.h"
+
+class TestHttpRequest : public test_fixture {
+  CPPUNIT_TEST_SUITE(TestHttpRequest);
+
+  CPPUNIT_TEST(test_header);
+  CPPUNIT_TEST(test_header_errors);
+  CPPUNIT_TEST(test_chunked);
+  CPPUNIT_TEST(test_chunked_split);
+  CPPUNIT_TEST(test_chunked_trailer);
+  CPPUNIT_TEST(test_chunked_errors);
+
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  void test_header();
+  void test_header_errors();
+  void test_chunked();
+  void test_chunked_split();
+  void test_chunked_trailer();
+  void test_chunked_errors();
+};
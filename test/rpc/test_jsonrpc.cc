@@ -8,6 +8,7 @@
 #include "globals.h"
 #include "command_helpers.h"
 #include "rpc/command_map.h"
+#include "rpc/rpc_batch.h"
 
 CPPUNIT_TEST_SUITE_REGISTRATION(TestJsonrpc);
 
@@ -78,6 +79,14 @@ std::vector<std::tuple<std::string, std::string, std::string>> basic_jsonrpc_req
                   R"({"jsonrpc": "2.0", "method": "jsonrpc_reflect", "params": ["", {"lowerBound": 18}], "id": 1})",
                   R"({"id":1,"jsonrpc":"2.0","result":[{"lowerBound":18}]})"),
 
+  std::make_tuple("Escaped strings and nested params",
+                  R"({"jsonrpc": "2.0", "method": "jsonrpc_reflect", "params": ["", "a\"b\n\u0001", {"b": [1, true], "a": {}}], "id": 1})",
+                  R"({"id":1,"jsonrpc":"2.0","result":["a\"b\n\u0001",{"a":{},"b":[1,1]}]})"),
+
+  std::make_tuple("Unknown members",
+                  R"({"extra": {"x": [1, {"y": 2}]}, "jsonrpc": "2.0", "method": "jsonrpc_reflect", "params": ["", 1], "id": 2})",
+                  R"({"id":2,"jsonrpc":"2.0","result":[1]})"),
+
   std::make_tuple("Notification",
                   R"({"jsonrpc": "2.0", "method": "jsonrpc_reflect", "params": [""]})",
                   ""),
@@ -145,3 +154,19 @@ TestJsonrpc::test_basics() {
     CPPUNIT_ASSERT_EQUAL_MESSAGE(std::get<0>(test), std::get<2>(test), output);
   }
 }
+
+void
+TestJsonrpc::test_encode_partial() {
+  for (auto& test : basic_jsonrpc_requests) {
+    rpc::RpcBatch batch;
+    std::string   output;
+
+    m_jsonrpc.decode(std::get<1>(test).c_str(), std::get<1>(test).size(), &batch);
+    m_jsonrpc.execute(&batch);
+
+    while (!m_jsonrpc.encode_partial(&batch, &output, 1))
+      ;
+
+    CPPUNIT_ASSERT_EQUAL_MESSAGE(std::get<0>(test), std::get<2>(test), output);
+  }
+}
@@ -0,0 +1,80 @@
+#include "config.h"
+
+#include "test/rpc/test_parse_commands.h"
+
+#include "command_helpers.h"
+#include "rpc/parse_commands.h"
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TestParseCommands);
+
+static int64_t parse_commands_test_calls = 0;
+
+torrent::Object
+parse_commands_test_reflect([[maybe_unused]] rpc::target_type t, const torrent::Object& obj) { return obj; }
+
+torrent::Object
+parse_commands_test_count([[maybe_unused]] rpc::target_type t, [[maybe_unused]] const torrent::Object& obj) { return ++parse_commands_test_calls; }
+
+static rpc::CommandPlan
+make_plan(const std::string& cmd) {
+  return rpc::CommandPlan(cmd.c_str(), cmd.c_str() + cmd.size());
+}
+
+void
+TestParseCommands::setUp() {
+  test_fixture::setUp();
+
+  if (rpc::commands.find("plan_reflect") == rpc::commands.end()) {
+    CMD2_ANY("plan_reflect", &parse_commands_test_reflect);
+    CMD2_ANY("plan_count", &parse_commands_test_count);
+  }
+
+  parse_commands_test_calls = 0;
+}
+
+void
+TestParseCommands::test_command_plan() {
+  CPPUNIT_ASSERT(make_plan("plan_reflect=").call(rpc::make_target()).as_string() == "");
+  CPPUNIT_ASSERT(make_plan("plan_reflect=foo").call(rpc::make_target()).as_string() == "foo");
+  CPPUNIT_ASSERT(make_plan("plan_reflect = 1,bar ").call(rpc::make_target()).as_list().size() == 2);
+
+  CPPUNIT_ASSERT(make_plan("").call(rpc::make_target()).is_empty());
+  CPPUNIT_ASSERT(make_plan("  # comment").call(rpc::make_target()).is_empty());
+
+  // Only the first command is used.
+  CPPUNIT_ASSERT(make_plan("plan_reflect=foo;plan_count=").call(rpc::make_target()).as_string() == "foo");
+  CPPUNIT_ASSERT(parse_commands_test_calls == 0);
+
+  auto plan = make_plan("plan_reflect=foo,bar");
+
+  CPPUNIT_ASSERT(plan.id() == rpc::commands.find("plan_reflect")->second.m_id);
+  CPPUNIT_ASSERT(plan.args().as_list().size() == 2 && plan.args().as_list().front().as_string() == "foo");
+  CPPUNIT_ASSERT(!plan.needs_execute());
+  CPPUNIT_ASSERT(make_plan("plan_reflect=$plan_count=").needs_execute());
+}
+
+void
+TestParseCommands::test_command_plan_execute() {
+  auto plan = make_plan("plan_reflect=$plan_count=");
+
+  CPPUNIT_ASSERT(plan.call(rpc::make_target()).as_value() == 1);
+  CPPUNIT_ASSERT(plan.call(rpc::make_target()).as_value() == 2);
+
+  auto list_plan = make_plan("plan_reflect=foo,$plan_count=");
+
+  CPPUNIT_ASSERT(list_plan.call(rpc::make_target()).as_list().back().as_value() == 3);
+  CPPUNIT_ASSERT(list_plan.call(rpc::make_target()).as_list().back().as_value() == 4);
+}
+
+void
+TestParseCommands::test_command_plan_errors() {
+  CPPUNIT_ASSERT_THROW(make_plan("plan_does_not_exist="), torrent::input_error);
+  CPPUNIT_ASSERT_THROW(make_plan("plan_reflect"), torrent::input_error);
+  CPPUNIT_ASSERT_THROW(make_plan("plan_reflect=foo bar"), torrent::input_error);
+
+  std::vector<std::string> commands{"plan_reflect=a", "plan_does_not_exist="};
+  torrent::Object::list_type args(commands.begin(), commands.end());
+
+  CPPUNIT_ASSERT_THROW(rpc::parse_command_plans(args.begin(), args.end()), torrent::input_error);
+  CPPUNIT_ASSERT(rpc::parse_command_plans(args.begin(), args.begin() + 1).size() == 1);
+}
@@ -0,0 +1,20 @@
+#include "test/helpers/test_fixture.h"
+
+#include "rpc/parse_commands.h"
+
+class TestParseCommands : public test_fixture {
+  CPPUNIT_TEST_SUITE(TestParseCommands);
+
+  CPPUNIT_TEST(test_command_plan);
+  CPPUNIT_TEST(test_command_plan_execute);
+  CPPUNIT_TEST(test_command_plan_errors);
+
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  void setUp();
+
+  void test_command_plan();
+  void test_command_plan_execute();
+  void test_command_plan_errors();
+};
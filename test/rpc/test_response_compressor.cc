@@ -0,0 +1,112 @@
+#include "config.h"
+
+#include "test/rpc/test_response_compressor.h"
+
+#include <cstring>
+#include <string>
+
+#include "rpc/response_compressor.h"
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TestResponseCompressor);
+
+static rpc::ResponseCompressor::Encoding
+negotiate(const char* value) {
+  return rpc::ResponseCompressor::negotiate(value, value + std::strlen(value));
+}
+
+static std::string
+make_response() {
+  std::string response = "[";
+
+  for (int i = 0; i < 20000; i++)
+    response += "[\"" + std::to_string(i) + "\",\"ubuntu-24.04-desktop-amd64.iso\",1],";
+
+  response.back() = ']';
+  return response;
+}
+
+void
+TestResponseCompressor::test_negotiate() {
+  CPPUNIT_ASSERT(negotiate("") == rpc::ResponseCompressor::NONE);
+  CPPUNIT_ASSERT(negotiate("identity") == rpc::ResponseCompressor::NONE);
+  CPPUNIT_ASSERT(negotiate("br, deflate") == rpc::ResponseCompressor::NONE);
+  CPPUNIT_ASSERT(negotiate("gzip;q=0") == rpc::ResponseCompressor::NONE);
+  CPPUNIT_ASSERT(negotiate("zstd; q=0, gzip ; q = 0.0") == rpc::ResponseCompressor::NONE);
+
+#ifdef HAVE_ZLIB
+  CPPUNIT_ASSERT(negotiate("gzip") == rpc::ResponseCompressor::GZIP);
+  CPPUNIT_ASSERT(negotiate(" GZIP ") == rpc::ResponseCompressor::GZIP);
+  CPPUNIT_ASSERT(negotiate("deflate, x-gzip;q=0.5") == rpc::ResponseCompressor::GZIP);
+  CPPUNIT_ASSERT(negotiate("zstd;q=0, gzip") == rpc::ResponseCompressor::GZIP);
+#endif
+
+#ifdef HAVE_ZSTD
+  CPPUNIT_ASSERT(negotiate("gzip, deflate, br, zstd") == rpc::ResponseCompressor::ZSTD);
+  CPPUNIT_ASSERT(negotiate("zstd;q=0.1,gzip;q=1.0") == rpc::ResponseCompressor::ZSTD);
+#endif
+}
+
+void
+TestResponseCompressor::test_gzip() {
+#ifdef HAVE_ZLIB
+  auto response = make_response();
+
+  // Compress in parts the way streamed responses are sent.
+  std::string compressed;
+  rpc::ResponseCompressor compressor(rpc::ResponseCompressor::GZIP);
+
+  compressor.compress(response.substr(0, 100000), &compressed, false);
+
+  auto first_size = compressed.size();
+  CPPUNIT_ASSERT(first_size > 0);
+
+  compressor.compress(response.substr(100000), &compressed, true);
+  CPPUNIT_ASSERT(compressed.size() < response.size() / 4);
+
+  z_stream stream{};
+  CPPUNIT_ASSERT(inflateInit2(&stream, 15 + 16) == Z_OK);
+
+  std::string decompressed(response.size() + 1, '\0');
+
+  stream.next_in   = reinterpret_cast<Bytef*>(&compressed[0]);
+  stream.avail_in  = compressed.size();
+  stream.next_out  = reinterpret_cast<Bytef*>(&decompressed[0]);
+  stream.avail_out = decompressed.size();
+
+  CPPUNIT_ASSERT(inflate(&stream, Z_FINISH) == Z_STREAM_END);
+  decompressed.resize(stream.total_out);
+  inflateEnd(&stream);
+
+  CPPUNIT_ASSERT(decompressed == response);
+#endif
+}
+
+void
+TestResponseCompressor::test_zstd() {
+#ifdef HAVE_ZSTD
+  auto response = make_response();
+
+  std::string compressed;
+  rpc::ResponseCompressor compressor(rpc::ResponseCompressor::ZSTD);
+
+  compressor.compress(response.substr(0, 100000), &compressed, false);
+  compressor.compress(response.substr(100000), &compressed, true);
+
+  CPPUNIT_ASSERT(compressed.size() < response.size() / 4);
+
+  std::string decompressed(response.size(), '\0');
+  size_t      size = ZSTD_decompress(&decompressed[0], decompressed.size(), compressed.data(), compressed.size());
+
+  CPPUNIT_ASSERT(!ZSTD_isError(size));
+  CPPUNIT_ASSERT(size == response.size());
+  CPPUNIT_ASSERT(decompressed == response);
+#endif
+}
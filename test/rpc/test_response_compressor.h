@@ -0,0 +1,16 @@
+#include "test/helpers/test_fixture.h"
+
+class TestResponseCompressor : public test_fixture {
+  CPPUNIT_TEST_SUITE(TestResponseCompressor);
+
+  CPPUNIT_TEST(test_negotiate);
+  CPPUNIT_TEST(test_gzip);
+  CPPUNIT_TEST(test_zstd);
+
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  void test_negotiate();
+  void test_gzip();
+  void test_zstd();
+};
@@ -0,0 +1,98 @@
+#include "config.h"
+
+#include "test/rpc/test_rpc_stats.h"
+
+#include "rpc/rpc_batch.h"
+#include "rpc/rpc_stats.h"
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TestRpcStats);
+
+static void
+add_call(rpc::RpcBatch* batch, const char* method, std::chrono::microseconds time, bool is_known = true, bool has_error = false) {
+  rpc::RpcCall call;
+
+  call.method          = method;
+  call.execute_time    = time;
+  call.is_known_method = is_known;
+  call.has_error       = has_error;
+
+  batch->calls.push_back(std::move(call));
+}
+
+void
+TestRpcStats::test_methods() {
+  rpc::RpcStats stats;
+  rpc::RpcBatch batch;
+
+  add_call(&batch, "d.name", std::chrono::microseconds(5));
+  add_call(&batch, "d.name", std::chrono::microseconds(2000), true, true);
+  add_call(&batch, "d.complete", std::chrono::microseconds(50));
+  add_call(&batch, "no_such_method", std::chrono::microseconds(1), false, true);
+
+  stats.record_execute(batch);
+
+  auto result = stats.methods_to_object();
+  CPPUNIT_ASSERT(result.as_list().size() == 2);
+
+  auto& complete = result.as_list().front().as_map();
+  CPPUNIT_ASSERT(complete["method"].as_string() == "d.complete");
+  CPPUNIT_ASSERT(complete["calls"].as_value() == 1);
+  CPPUNIT_ASSERT(complete["errors"].as_value() == 0);
+
+  auto& name = result.as_list().back().as_map();
+  CPPUNIT_ASSERT(name["method"].as_string() == "d.name");
+  CPPUNIT_ASSERT(name["calls"].as_value() == 2);
+  CPPUNIT_ASSERT(name["errors"].as_value() == 1);
+  CPPUNIT_ASSERT(name["execute_total_usec"].as_value() == 2005);
+  CPPUNIT_ASSERT(name["execute_max_usec"].as_value() == 2000);
+
+  auto& histogram = name["execute_histogram"].as_list();
+  CPPUNIT_ASSERT(histogram.size() == rpc::RpcStats::histogram_bounds_usec.size() + 1);
+
+  int64_t expected[] = { 1, 0, 0, 1, 0, 0, 0 };
+
+  for (size_t i = 0; i < histogram.size(); i++)
+    CPPUNIT_ASSERT(histogram[i].as_value() == expected[i]);
+}
+
+void
+TestRpcStats::test_requests() {
+  rpc::RpcStats stats;
+  rpc::RpcBatch batch;
+
+  batch.queue_time   = std::chrono::microseconds(300);
+  batch.execute_time = std::chrono::microseconds(20);
+  batch.encode_time  = std::chrono::microseconds(2000000);
+
+  stats.record_execute(batch);
+  stats.record_execute(batch);
+  stats.record_encode(batch);
+
+  auto result = stats.requests_to_object();
+  auto& map   = result.as_map();
+
+  CPPUNIT_ASSERT(map["requests"].as_value() == 2);
+  CPPUNIT_ASSERT(map["encoded"].as_value() == 1);
+  CPPUNIT_ASSERT(map["queue_total_usec"].as_value() == 600);
+  CPPUNIT_ASSERT(map["queue_max_usec"].as_value() == 300);
+  CPPUNIT_ASSERT(map["execute_total_usec"].as_value() == 40);
+  CPPUNIT_ASSERT(map["encode_total_usec"].as_value() == 2000000);
+  CPPUNIT_ASSERT(map["encode_histogram"].as_list().back().as_value() == 1);
+  CPPUNIT_ASSERT(map["histogram_bounds_usec"].as_list().size() == rpc::RpcStats::histogram_bounds_usec.size());
+}
+
+void
+TestRpcStats::test_reset() {
+  rpc::RpcStats stats;
+  rpc::RpcBatch batch;
+
+  add_call(&batch, "d.name", std::chrono::microseconds(5));
+
+  stats.record_execute(batch);
+  stats.record_encode(batch);
+  stats.reset();
+
+  CPPUNIT_ASSERT(stats.methods_to_object().as_list().empty());
+  CPPUNIT_ASSERT(stats.requests_to_object().as_map()["requests"].as_value() == 0);
+  CPPUNIT_ASSERT(stats.requests_to_object().as_map()["encoded"].as_value() == 0);
+}
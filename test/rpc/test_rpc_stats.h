@@ -0,0 +1,16 @@
+#include "test/helpers/test_fixture.h"
+
+class TestRpcStats : public test_fixture {
+  CPPUNIT_TEST_SUITE(TestRpcStats);
+
+  CPPUNIT_TEST(test_methods);
+  CPPUNIT_TEST(test_requests);
+  CPPUNIT_TEST(test_reset);
+
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  void test_methods();
+  void test_requests();
+  void test_reset();
+};
@@ -0,0 +1,114 @@
+#include "config.h"
+
+#include "test/rpc/test_subscription_manager.h"
+
+#include <torrent/exceptions.h>
+
+#include "rpc/rpc_batch.h"
+#include "rpc/subscription_manager.h"
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TestSubscriptionManager);
+
+static torrent::Object::list_type
+make_events(std::initializer_list<const char*> names) {
+  torrent::Object::list_type events;
+
+  for (auto name : names)
+    events.push_back(std::string(name));
+
+  return events;
+}
+
+static rpc::RpcBatch
+make_poll_batch(int64_t id, int64_t timeout) {
+  rpc::RpcBatch batch;
+  rpc::RpcCall  call;
+
+  call.method = "system.subscription.poll";
+  call.params.as_list().push_back(std::string());
+  call.params.as_list().push_back(id);
+  call.params.as_list().push_back(timeout);
+
+  batch.calls.push_back(std::move(call));
+  return batch;
+}
+
+void
+TestSubscriptionManager::setUp() {
+  m_test_main_thread = TestMainThread::create();
+  m_test_main_thread->init_thread();
+}
+
+void
+TestSubscriptionManager::tearDown() {
+  m_test_main_thread.reset();
+}
+
+void
+TestSubscriptionManager::test_subscribe() {
+  rpc::SubscriptionManager manager;
+
+  CPPUNIT_ASSERT(manager.empty());
+
+  auto first  = manager.subscribe(make_events({"event.download.finished"}));
+  auto second = manager.subscribe(make_events({"view.event_added", "view.event_removed"}));
+
+  CPPUNIT_ASSERT(first != second);
+  CPPUNIT_ASSERT(!manager.empty());
+
+  CPPUNIT_ASSERT_THROW(manager.subscribe(make_events({})), torrent::input_error);
+  CPPUNIT_ASSERT_THROW(manager.subscribe(make_events({"event.download."})), torrent::input_error);
+  CPPUNIT_ASSERT_THROW(manager.subscribe(make_events({"view.event_added", "d.name"})), torrent::input_error);
+
+  manager.unsubscribe(first);
+  CPPUNIT_ASSERT_THROW(manager.unsubscribe(first), torrent::input_error);
+
+  manager.unsubscribe(second);
+  CPPUNIT_ASSERT(manager.empty());
+
+  manager.cleanup();
+}
+
+void
+TestSubscriptionManager::test_poll() {
+  rpc::SubscriptionManager manager;
+
+  auto id     = manager.subscribe(make_events({"event.download.inserted"}));
+  auto result = manager.poll(id);
+
+  CPPUNIT_ASSERT(result.as_map()["events"].as_list().empty());
+  CPPUNIT_ASSERT(result.as_map()["dropped"].as_value() == 0);
+
+  CPPUNIT_ASSERT_THROW(manager.poll(id + 1), torrent::input_error);
+
+  manager.cleanup();
+  CPPUNIT_ASSERT_THROW(manager.poll(id), torrent::input_error);
+}
+
+void
+TestSubscriptionManager::test_defer() {
+  rpc::SubscriptionManager manager;
+
+  auto id    = manager.subscribe(make_events({"event.download.erased"}));
+  int  owner = 0;
+
+  CPPUNIT_ASSERT(!manager.defer(make_poll_batch(id, 0), &owner, []() {}));
+  CPPUNIT_ASSERT(!manager.defer(make_poll_batch(id + 1, 1000), &owner, []() {}));
+
+  auto other = make_poll_batch(id, 1000);
+  other.calls.front().method = "system.subscription.pol";
+  CPPUNIT_ASSERT(!manager.defer(other, &owner, []() {}));
+
+  auto multicall = make_poll_batch(id, 1000);
+  multicall.calls.push_back(multicall.calls.front());
+  CPPUNIT_ASSERT(!manager.defer(multicall, &owner, []() {}));
+
+  auto with_error = make_poll_batch(id, 1000);
+  with_error.calls.front().set_error(-1, "error");
+  CPPUNIT_ASSERT(!manager.defer(with_error, &owner, []() {}));
+
+  CPPUNIT_ASSERT(manager.defer(make_poll_batch(id, 1000), &owner, []() {}));
+
+  manager.cancel(&owner);
+  manager.cleanup();
+}
@@ -0,0 +1,23 @@
+#include "test/helpers/test_fixture.h"
+#include "test/helpers/test_main_thread.h"
+
+class TestSubscriptionManager : public test_fixture {
+  CPPUNIT_TEST_SUITE(TestSubscriptionManager);
+
+  CPPUNIT_TEST(test_subscribe);
+  CPPUNIT_TEST(test_poll);
+  CPPUNIT_TEST(test_defer);
+
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  void setUp();
+  void tearDown();
+
+  void test_subscribe();
+  void test_poll();
+  void test_defer();
+
+private:
+  std::unique_ptr<TestMainThread> m_test_main_thread;
+};
@@ -3,11 +3,14 @@
 #include "test/rpc/test_xmlrpc.h"
 
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "control.h"
 #include "globals.h"
 #include "command_helpers.h"
 #include "rpc/command_map.h"
+#include "rpc/rpc_batch.h"
 
 CPPUNIT_TEST_SUITE_REGISTRATION(TestXmlrpc);
 
@@ -23,7 +26,7 @@ xmlrpc_cmd_test_reflect_string([[maybe_unused]] rpc::target_type t, const std::s
 
 void initialize_command_dynamic();
 
-#if defined(HAVE_XMLRPC_TINYXML2) && !defined(HAVE_XMLRPC_C)
+#if (defined(HAVE_XMLRPC_TINYXML2) || defined(HAVE_XMLRPC_STREAM)) && !defined(HAVE_XMLRPC_C)
 
 std::vector<std::tuple<std::string, std::string, std::string>> basic_requests = {
   std::make_tuple("Basic call",
@@ -74,6 +77,14 @@ std::vector<std::tuple<std::string, std::string, std::string>> basic_requests =
                   "<?xml version=\"1.0\"?><methodCall><methodName>xmlrpc_reflect</methodName><params><param><value><string></string></value></param><param><value><struct><member><name>lowerBound</name><value><i8>18</i8></value></member><member><name>upperBound</name><value><i8>139</i8></value></member></struct></value></param></params></methodCall>",
                   "<?xml version=\"1.0\"?><methodResponse><params><param><value><array><data><value><struct><member><name>lowerBound</name><value><i8>18</i8></value></member><member><name>upperBound</name><value><i8>139</i8></value></member></struct></value></data></array></value></param></params></methodResponse>"),
 
+  std::make_tuple("Escaped string",
+                  "<?xml version=\"1.0\"?><methodCall><methodName>xmlrpc_reflect</methodName><params><param><value><string></string></value></param><param><value><string>a&amp;b&lt;c&gt;</string></value></param></params></methodCall>",
+                  "<?xml version=\"1.0\"?><methodResponse><params><param><value><array><data><value><string>a&amp;b&lt;c&gt;</string></value></data></array></value></param></params></methodResponse>"),
+
+  std::make_tuple("Multicall",
+                  "<?xml version=\"1.0\"?><methodCall><methodName>system.multicall</methodName><params><param><value><array><data><value><struct><member><name>methodName</name><value><string>xmlrpc_reflect</string></value></member><member><name>params</name><value><array><data><value><string></string></value><value><i8>1</i8></value></data></array></value></member></struct></value><value><struct><member><name>methodName</name><value><string>no_such_method</string></value></member><member><name>params</name><value><array><data/></array></value></member></struct></value></data></array></value></param></params></methodCall>",
+                  "<?xml version=\"1.0\"?><methodResponse><params><param><value><array><data><value><array><data><value><array><data><value><i8>1</i8></value></data></array></value></data></array></value><value><struct><member><name>faultCode</name><value><i8>-506</i8></value></member><member><name>faultString</name><value><string>method 'no_such_method' not defined</string></value></member></struct></value></data></array></value></param></params></methodResponse>"),
+
   std::make_tuple("Invalid - missing method",
                   "<?xml version=\"1.0\"?><methodCall><methodName>no_such_method</methodName><params><param><value><i8>41</i8></value></param></params></methodCall>",
                   "<?xml version=\"1.0\"?><methodResponse><fault><value><struct><member><name>faultCode</name><value><i8>-506</i8></value></member><member><name>faultString</name><value><string>method 'no_such_method' not defined</string></value></member></struct></value></fault></methodResponse>"),
@@ -92,7 +103,11 @@ std::vector<std::tuple<std::string, std::string, std::string>> basic_requests =
 
   std::make_tuple("Invalid - broken XML",
                   "thodCall><methodName>test_a</methodName><params><param><value><i8>41</i8></value></param></params></method",
+#ifdef HAVE_XMLRPC_STREAM
+                  "<?xml version=\"1.0\"?><methodResponse><fault><value><struct><member><name>faultCode</name><value><i8>-503</i8></value></member><member><name>faultString</name><value><string>XML parse error at line 1: text outside of the root element</string></value></member></struct></value></fault></methodResponse>"),
+#else
                   "<?xml version=\"1.0\"?><methodResponse><fault><value><struct><member><name>faultCode</name><value><i8>-503</i8></value></member><member><name>faultString</name><value><string>Error=XML_ERROR_PARSING_ELEMENT ErrorID=6 (0x6) Line number=1: XMLElement name=method</string></value></member></struct></value></fault></methodResponse>"),
+#endif
 
   std::make_tuple("Invalid - non-integer i8",
                   "<?xml version=\"1.0\"?><methodCall><methodName>xmlrpc_reflect</methodName><params><param><value><i8>string value</i8></value></param></params></methodCall>",
@@ -165,11 +180,93 @@ TestXmlrpc::test_size_limit() {
   CPPUNIT_ASSERT_EQUAL(expected, output);
 }
 
+void
+TestXmlrpc::test_encode_partial() {
+  for (auto& test : basic_requests) {
+    rpc::RpcBatch batch;
+    std::string   output;
+
+    m_xmlrpc.decode(std::get<1>(test).c_str(), std::get<1>(test).size(), &batch);
+    m_xmlrpc.execute(&batch);
+
+    while (!m_xmlrpc.encode_partial(&batch, &output, 1))
+      ;
+
+    CPPUNIT_ASSERT_EQUAL_MESSAGE(std::get<0>(test), std::get<2>(test), output);
+  }
+}
+
+static std::string
+xmlrpc_nested_request(int depth) {
+  std::string value = "<value><i8>1</i8></value>";
+
+  for (int i = 0; i < depth; i++)
+    value = "<value><array><data>" + value + "</data></array></value>";
+
+  return "<?xml version=\"1.0\"?><methodCall><methodName>xmlrpc_reflect</methodName><params><param>" + value + "</param></params></methodCall>";
+}
+
+void
+TestXmlrpc::test_depth_limit() {
+  std::string input = xmlrpc_nested_request(1000);
+  std::string output;
+  m_xmlrpc.process(input.c_str(), input.size(), [&output](const char* c, uint32_t l){ output.append(c, l); return true;});
+  CPPUNIT_ASSERT(output.find("<fault>") != std::string::npos);
+  CPPUNIT_ASSERT(output.find("<i8>-503</i8>") != std::string::npos);
+
+  input = xmlrpc_nested_request(50);
+  output.clear();
+  m_xmlrpc.process(input.c_str(), input.size(), [&output](const char* c, uint32_t l){ output.append(c, l); return true;});
+  CPPUNIT_ASSERT(output.find("<fault>") == std::string::npos);
+}
+
+static std::string
+xmlrpc_string_request(const std::string& str) {
+  return "<?xml version=\"1.0\"?><methodCall><methodName>xmlrpc_reflect</methodName><params><param><value><string></string></value></param><param><value><string>" + str + "</string></value></param></params></methodCall>";
+}
+
+static std::string
+xmlrpc_string_response(const std::string& str) {
+  return "<?xml version=\"1.0\"?><methodResponse><params><param><value><array><data><value><string>" + str + "</string></value></data></array></value></param></params></methodResponse>";
+}
+
+void
+TestXmlrpc::test_character_references() {
+  std::vector<std::pair<std::string, std::string>> valid = {
+    { "&#x41;&#66;", "AB" },
+    { "&#xe9;", "\xc3\xa9" },
+    { "&#xD7FF;", "\xed\x9f\xbf" },
+    { "&#xE000;", "\xee\x80\x80" },
+    { "&#x1F60A;", "\xf0\x9f\x98\x8a" },
+  };
+
+  for (auto& test : valid) {
+    std::string input = xmlrpc_string_request(test.first);
+    std::string output;
+    m_xmlrpc.process(input.c_str(), input.size(), [&output](const char* c, uint32_t l){ output.append(c, l); return true;});
+    CPPUNIT_ASSERT_EQUAL_MESSAGE(test.first, xmlrpc_string_response(test.second), output);
+  }
+
+#ifdef HAVE_XMLRPC_STREAM
+  // Surrogates can't be encoded as UTF-8.
+  for (std::string reference : { "&#xD800;", "&#xdfff;", "&#55296;", "&#57343;" }) {
+    std::string input = xmlrpc_string_request(reference);
+    std::string output;
+    m_xmlrpc.process(input.c_str(), input.size(), [&output](const char* c, uint32_t l){ output.append(c, l); return true;});
+    CPPUNIT_ASSERT_MESSAGE(reference, output.find("<i8>-503</i8>") != std::string::npos);
+    CPPUNIT_ASSERT_MESSAGE(reference, output.find("invalid character reference") != std::string::npos);
+  }
+#endif
+}
+
 #else
 
 void TestXmlrpc::test_invalid_utf8() {}
 void TestXmlrpc::test_basics() {}
 void TestXmlrpc::test_size_limit() {}
+void TestXmlrpc::test_encode_partial() {}
+void TestXmlrpc::test_depth_limit() {}
+void TestXmlrpc::test_character_references() {}
 void TestXmlrpc::setUp() {}
 void TestXmlrpc::tearDown() {}
 
@@ -10,6 +10,9 @@ class TestXmlrpc : public test_fixture {
   CPPUNIT_TEST(test_basics);
   CPPUNIT_TEST(test_invalid_utf8);
   CPPUNIT_TEST(test_size_limit);
+  CPPUNIT_TEST(test_encode_partial);
+  CPPUNIT_TEST(test_depth_limit);
+  CPPUNIT_TEST(test_character_references);
 
   CPPUNIT_TEST_SUITE_END();
 
@@ -22,6 +25,9 @@ public:
   void test_basics();
   void test_invalid_utf8();
   void test_size_limit();
+  void test_encode_partial();
+  void test_depth_limit();
+  void test_character_references();
 
 private:
   std::unique_ptr<TestMainThread> m_test_main_thread;